@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "ast_dumper.hh"
 #include "../utils/errors.hh"
 
@@ -14,212 +16,283 @@ char const * const get_type_name(ast::Type t) {
   }
 }
 
+// Indentation is copied from this run of spaces.
+const char spaces[] = "                                                                "
+                      "                                                                ";
+
 } // namespace
 
 
 namespace ast {
 
+void ASTDumper::nl() {
+  out << '\n';
+  for (size_t n = 2 * indent_level; n > 0;) {
+    const size_t chunk = std::min(n, sizeof(spaces) - 1);
+    out.write(spaces, chunk);
+    n -= chunk;
+  }
+}
+
 void ASTDumper::visit(const IntegerLiteral &literal) {
-  *ostream << literal.value;
+  out << literal.value;
 }
 
 void ASTDumper::visit(const StringLiteral &literal) {
-  *ostream << '"';
-  for (auto &c : static_cast<std::string>(literal.value)) {
+  out << '"';
+  for (auto &c : literal.value.get()) {
     switch (c) {
     case '"':
-      *ostream << "\\\"";
+      out << "\\\"";
       break;
     case '\\':
-      *ostream << "\\\\";
+      out << "\\\\";
       break;
     case '\a':
-      *ostream << "\\a";
+      out << "\\a";
       break;
     case '\b':
-      *ostream << "\\b";
+      out << "\\b";
       break;
     case '\t':
-      *ostream << "\\t";
+      out << "\\t";
       break;
     case '\n':
-      *ostream << "\\n";
+      out << "\\n";
       break;
     case '\v':
-      *ostream << "\\v";
+      out << "\\v";
       break;
     case '\f':
-      *ostream << "\\f";
+      out << "\\f";
       break;
     case '\r':
-      *ostream << "\\r";
+      out << "\\r";
       break;
     default:
-      *ostream << c;
+      out << c;
     }
   }
-  *ostream << '"';
+  out << '"';
+}
+
+void ASTDumper::dump(const Node &node) {
+  stack.push_back(Frame{&node, 0});
+  while (!stack.empty()) {
+    const Frame frame = stack.back();
+    stack.pop_back();
+    step = frame.step;
+    dispatch(*frame.node);
+  }
 }
 
 void ASTDumper::visit(const BinaryOperator &binop) {
-  *ostream << '(';
-  binop.get_left().accept(*this);
-  *ostream << operator_name[binop.op];
-  binop.get_right().accept(*this);
-  *ostream << ')';
+  switch (step) {
+  case 0:
+    out << '(';
+    return descend(binop, 1, binop.get_left());
+  case 1:
+    out << operator_name[binop.op];
+    return descend(binop, 2, binop.get_right());
+  default:
+    out << ')';
+  }
 }
 
 void ASTDumper::visit(const Sequence &seqExpr) {
-  *ostream << "(";
-  inc();
-  const auto exprs = seqExpr.get_exprs();
-  for (auto expr = exprs.cbegin(); expr != exprs.cend(); expr++) {
-    if (expr != exprs.cbegin())
-      *ostream << ';';
+  const auto &exprs = seqExpr.get_exprs();
+  if (step == 0) {
+    out << "(";
+    inc();
+  }
+  if (step < exprs.size()) {
+    if (step > 0)
+      out << ';';
     nl();
-    (*expr)->accept(*this);
+    return descend(seqExpr, step + 1, *exprs[step]);
   }
   dnl();
-  *ostream << ")";
+  out << ")";
 }
 
+// Steps go through the declarations, then through the expressions of the
+// sequence.
 void ASTDumper::visit(const Let &let) {
-  *ostream << "let";
-  inc();
-  for (auto decl : let.get_decls()) {
+  const auto &decls = let.get_decls();
+  const auto &exprs = let.get_sequence().get_exprs();
+  if (step == 0) {
+    out << "let";
+    inc();
+  }
+  if (step < decls.size()) {
     nl();
-    decl->accept(*this);
+    return descend(let, step + 1, *decls[step]);
   }
-  dnl();
-  *ostream << "in";
-  inc();
-  const auto exprs = let.get_sequence().get_exprs();
-  for (auto expr = exprs.cbegin(); expr != exprs.cend(); expr++) {
-    if (expr != exprs.cbegin())
-      *ostream << ';';
+  const size_t i = step - decls.size();
+  if (i == 0) {
+    dnl();
+    out << "in";
+    inc();
+  }
+  if (i < exprs.size()) {
+    if (i > 0)
+      out << ';';
     nl();
-    (*expr)->accept(*this);
+    return descend(let, step + 1, *exprs[i]);
   }
   dnl();
-  *ostream << "end";
+  out << "end";
 }
 
+// Transformations may bind an identifier to a declaration they renamed.
 void ASTDumper::visit(const Identifier &id) {
-  *ostream << id.name;
+  out << (id.get_decl() ? id.get_decl()->name : id.name);
   if (verbose)
     if (auto decl = id.get_decl()) {
-      *ostream << "/*" << "decl:" << decl.get().loc;
+      out << "/*" << "decl:" << decl.get().loc;
 
       if (int depth_diff = id.get_depth() - decl->get_depth())
-        *ostream << " depth_diff:" << depth_diff;
-      *ostream << "*/";
+        out << " depth_diff:" << depth_diff;
+      out << "*/";
     }
 }
 
 void ASTDumper::visit(const IfThenElse &ite) {
-  *ostream << "if ";
-  inl();
-  ite.get_condition().accept(*this);
-  dnl();
-  *ostream << " then ";
-  inl();
-  ite.get_then_part().accept(*this);
-  dnl();
-  *ostream << " else ";
-  inl();
-  ite.get_else_part().accept(*this);
-  dec();
+  switch (step) {
+  case 0:
+    out << "if ";
+    inl();
+    return descend(ite, 1, ite.get_condition());
+  case 1:
+    dnl();
+    out << " then ";
+    inl();
+    return descend(ite, 2, ite.get_then_part());
+  case 2:
+    dnl();
+    out << " else ";
+    inl();
+    return descend(ite, 3, ite.get_else_part());
+  default:
+    dec();
+  }
 }
 
 void ASTDumper::visit(const VarDecl &decl) {
+  if (step > 0)
+    return;
   if (decl.get_expr())
-    *ostream << "var ";
-  *ostream << decl.name;
+    out << "var ";
+  out << decl.name;
   if (verbose && decl.get_escapes())
-    *ostream << "/*e*/";
+    out << "/*e*/";
   if (decl.type_name)
-    *ostream << ": " << *decl.type_name;
+    out << ": " << *decl.type_name;
   else {
     auto t = decl.get_type();
     if (t != t_undef && t != t_void)
-      *ostream << ": " << get_type_name(t);
+      out << ": " << get_type_name(t);
   }
   if (auto expr = decl.get_expr()) {
-    *ostream << " := ";
-    expr->accept(*this);
+    out << " := ";
+    descend(decl, 1, *expr);
   }
 }
 
+// Steps go through the parameters, then through the body.
 void ASTDumper::visit(const FunDecl &decl) {
-  *ostream << "function " << decl.name;
-  if (verbose && decl.name != decl.get_external_name())
-    *ostream << "/*" << decl.get_external_name() << "*/";
-  *ostream << '(';
-  auto params = decl.get_params();
-  for (auto param = params.cbegin(); param != params.cend(); param++) {
-    if (param != params.cbegin())
-      *ostream << ", ";
-    (*param)->accept(*this);
-  }
-  *ostream << ")";
-  if (decl.type_name)
-    *ostream << ": " << decl.type_name.get();
-  *ostream << " = ";
-  inl();
-  decl.get_expr()->accept(*this);
+  const auto &params = decl.get_params();
+  if (step == 0) {
+    out << "function " << decl.name;
+    if (verbose && decl.get_external_name() != Symbol() &&
+        decl.name != decl.get_external_name())
+      out << "/*" << decl.get_external_name() << "*/";
+    out << '(';
+  }
+  if (step < params.size()) {
+    if (step > 0)
+      out << ", ";
+    return descend(decl, step + 1, *params[step]);
+  }
+  if (step == params.size()) {
+    out << ")";
+    if (decl.type_name)
+      out << ": " << decl.type_name.get();
+    out << " = ";
+    inl();
+    return descend(decl, step + 1, *decl.get_expr());
+  }
   dec();
 }
 
 void ASTDumper::visit(const FunCall &call) {
-  *ostream << call.func_name;
-  if (verbose)
-    if (auto decl = call.get_decl())
-      *ostream << "/*" << "decl:" << decl.get().loc << "*/";
+  const auto &args = call.get_args();
+  if (step == 0) {
+    out << call.func_name;
+    if (verbose)
+      if (auto decl = call.get_decl())
+        out << "/*" << "decl:" << decl.get().loc << "*/";
 
-  *ostream << "(";
-
-  auto args = call.get_args();
-  for (auto arg = args.cbegin(); arg != args.cend(); arg++) {
-    if (arg != args.cbegin())
-      *ostream << ", ";
-    (*arg)->accept(*this);
+    out << "(";
+  }
+  if (step < args.size()) {
+    if (step > 0)
+      out << ", ";
+    return descend(call, step + 1, *args[step]);
   }
-  *ostream << ')';
+  out << ')';
 }
 
 void ASTDumper::visit(const WhileLoop &loop) {
-  *ostream << "while ";
-  loop.get_condition().accept(*this);
-  *ostream << " do";
-  inl();
-  loop.get_body().accept(*this);
-  dec();
+  switch (step) {
+  case 0:
+    out << "while ";
+    return descend(loop, 1, loop.get_condition());
+  case 1:
+    out << " do";
+    inl();
+    return descend(loop, 2, loop.get_body());
+  default:
+    dec();
+  }
 }
 
 void ASTDumper::visit(const ForLoop &loop) {
-  *ostream << "for " << loop.get_variable().name;
-  if (verbose && loop.get_variable().get_escapes())
-    *ostream << "/*e*/";
-  *ostream << " := ";
-  loop.get_variable().get_expr()->accept(*this);
-  *ostream << " to ";
-  loop.get_high().accept(*this);
-  *ostream << " do";
-  inl();
-  loop.get_body().accept(*this);
-  dec();
+  switch (step) {
+  case 0:
+    out << "for " << loop.get_variable().name;
+    if (verbose && loop.get_variable().get_escapes())
+      out << "/*e*/";
+    out << " := ";
+    return descend(loop, 1, *loop.get_variable().get_expr());
+  case 1:
+    out << " to ";
+    return descend(loop, 2, loop.get_high());
+  case 2:
+    out << " do";
+    inl();
+    return descend(loop, 3, loop.get_body());
+  default:
+    dec();
+  }
 }
 
 void ASTDumper::visit(const Break &brk) {
-  *ostream << "break";
+  out << "break";
   if (verbose && brk.get_loop())
-    *ostream << "/*loop:" << brk.get_loop().get().loc << "*/";
+    out << "/*loop:" << brk.get_loop().get().loc << "*/";
 }
 
 void ASTDumper::visit(const Assign &assign) {
-  assign.get_lhs().accept(*this);
-  *ostream << " := ";
-  assign.get_rhs().accept(*this);
+  switch (step) {
+  case 0:
+    return descend(assign, 1, assign.get_lhs());
+  case 1:
+    out << " := ";
+    return descend(assign, 2, assign.get_rhs());
+  default:
+    break;
+  }
 }
 
-} // namespace ast
\ No newline at end of file
+} // namespace ast
@@ -2,15 +2,36 @@
 #define AST_DUMPER_HH
 
 #include <ostream>
+#include <vector>
 
 #include "nodes.hh"
+#include "static_visitor.hh"
+#include "../utils/output_buffer.hh"
 
 namespace ast {
 
-class ASTDumper : public ConstASTVisitor {
-  std::ostream *ostream;
+// Nodes are dumped using an explicit stack of frames, so that deep trees
+// do not exhaust the native stack. A visit prints the part of its node
+// designated by step, and asks for a child to be dumped before resuming
+// at the next step with descend().
+class ASTDumper : public StaticVisitor<ASTDumper> {
+  // Output is buffered, and only reaches the stream when the buffer is full
+  // or flush() is called.
+  utils::OutputBuffer out;
   bool verbose;
   unsigned indent_level = 0;
+
+  struct Frame {
+    const Node *node;
+    size_t step;
+  };
+  std::vector<Frame> stack;
+  size_t step = 0;
+  void descend(const Node &node, size_t next, const Node &child) {
+    stack.push_back(Frame{&node, next});
+    stack.push_back(Frame{&child, 0});
+  }
+
   void inc() { indent_level++; }
   void inl() {
     inc();
@@ -24,26 +45,24 @@ class ASTDumper : public ConstASTVisitor {
 
 public:
   ASTDumper(std::ostream *_ostream, bool _verbose)
-      : ostream(_ostream), verbose(_verbose) {}
-  void nl() {
-    *ostream << std::endl;
-    for (unsigned i = 0; i < indent_level; i++)
-      *ostream << "  ";
-  };
-  virtual void visit(const IntegerLiteral &);
-  virtual void visit(const StringLiteral &);
-  virtual void visit(const BinaryOperator &);
-  virtual void visit(const Sequence &);
-  virtual void visit(const Let &);
-  virtual void visit(const Identifier &);
-  virtual void visit(const IfThenElse &);
-  virtual void visit(const VarDecl &);
-  virtual void visit(const FunDecl &);
-  virtual void visit(const FunCall &);
-  virtual void visit(const WhileLoop &);
-  virtual void visit(const ForLoop &);
-  virtual void visit(const Break &);
-  virtual void visit(const Assign &);
+      : out(*_ostream), verbose(_verbose) {}
+  void dump(const Node &node);
+  void nl();
+  void flush() { out.flush(); }
+  void visit(const IntegerLiteral &);
+  void visit(const StringLiteral &);
+  void visit(const BinaryOperator &);
+  void visit(const Sequence &);
+  void visit(const Let &);
+  void visit(const Identifier &);
+  void visit(const IfThenElse &);
+  void visit(const VarDecl &);
+  void visit(const FunDecl &);
+  void visit(const FunCall &);
+  void visit(const WhileLoop &);
+  void visit(const ForLoop &);
+  void visit(const Break &);
+  void visit(const Assign &);
 };
 
 } // namespace ast
@@ -0,0 +1,574 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "ast_file.hh"
+#include "../utils/errors.hh"
+
+namespace ast {
+
+using namespace file;
+using flat::NodeRef;
+using flat::Span;
+
+namespace {
+
+const char file_magic[8] = {'D', 'T', 'I', 'G', 'A', 'S', 'T', '\n'};
+
+static_assert(sizeof(Symbol) == sizeof(uint32_t) &&
+                  std::is_trivially_copyable<Symbol>::value,
+              "symbols are stored as their identifier");
+
+// The size of the elements of each section.
+const uint32_t element_sizes[s_count] = {
+    sizeof(flat::IntegerLiteral), sizeof(flat::StringLiteral),
+    sizeof(flat::BinaryOperator), sizeof(flat::Sequence),
+    sizeof(flat::Let),            sizeof(flat::Identifier),
+    sizeof(flat::IfThenElse),     sizeof(flat::VarDecl),
+    sizeof(flat::FunDecl),        sizeof(flat::FunCall),
+    sizeof(flat::WhileLoop),      sizeof(flat::ForLoop),
+    sizeof(flat::Break),          sizeof(flat::Assign),
+    sizeof(NodeRef),              sizeof(SymbolEntry),
+    sizeof(char),                 sizeof(uint32_t)};
+
+// A Symbol holding a symbol table index rather than an identifier.
+Symbol stored_symbol(uint32_t index) { return Symbol::from_id(index); }
+
+[[noreturn]] void invalid(const std::string &what) {
+  utils::error("invalid AST file: " + what);
+}
+
+class Writer {
+  const FlatAST &ast;
+  std::vector<char> out;
+  Header header;
+
+  // Symbol identifiers to symbol table indices.
+  std::unordered_map<uint32_t, uint32_t> symbol_indices;
+  std::vector<SymbolEntry> symbol_entries;
+  std::vector<char> chars;
+
+  // The source file locations are relative to.
+  const utils::SourceMap *source = nullptr;
+
+  Symbol symbol(const Symbol &s) {
+    if (!s.get_id())
+      return Symbol();
+    auto inserted = symbol_indices.insert(
+        std::make_pair(s.get_id(), uint32_t(symbol_entries.size() + 1)));
+    if (inserted.second) {
+      const boost::string_view text = s.get();
+      symbol_entries.push_back(
+          SymbolEntry{uint32_t(chars.size()), uint32_t(text.size())});
+      chars.insert(chars.end(), text.begin(), text.end());
+    }
+    return stored_symbol(inserted.first->second);
+  }
+
+  // Locations from another source file than the first one met are lost.
+  SourceLoc loc(const SourceLoc &l) {
+    if (!l.get_begin())
+      return SourceLoc();
+    if (!source)
+      source = utils::SourceMap::find(l.get_begin());
+    if (!source || l.get_begin() < source->get_base() ||
+        l.get_begin() - source->get_base() > source->get_size())
+      return SourceLoc();
+    return SourceLoc(l.get_begin() - source->get_base() + 1, l.get_length());
+  }
+
+  void fix(flat::IntegerLiteral &) {}
+  void fix(flat::StringLiteral &r) { r.value = symbol(r.value); }
+  void fix(flat::BinaryOperator &) {}
+  void fix(flat::Sequence &) {}
+  void fix(flat::Let &) {}
+  void fix(flat::Identifier &r) { r.name = symbol(r.name); }
+  void fix(flat::IfThenElse &) {}
+  void fix(flat::VarDecl &r) {
+    r.name = symbol(r.name);
+    r.type_name = symbol(r.type_name);
+  }
+  void fix(flat::FunDecl &r) {
+    r.name = symbol(r.name);
+    r.type_name = symbol(r.type_name);
+    r.external_name = symbol(r.external_name);
+  }
+  void fix(flat::FunCall &r) { r.func_name = symbol(r.func_name); }
+  void fix(flat::WhileLoop &) {}
+  void fix(flat::ForLoop &) {}
+  void fix(flat::Break &) {}
+  void fix(flat::Assign &) {}
+
+  template <typename T> void add_section(unsigned s, const std::vector<T> &v) {
+    out.resize((out.size() + 7) & ~size_t(7));
+    header.sections[s] =
+        SectionEntry{out.size(), v.size(), uint32_t(sizeof(T)), 0};
+    const char *p = reinterpret_cast<const char *>(v.data());
+    out.insert(out.end(), p, p + v.size() * sizeof(T));
+  }
+
+  template <typename R> void add_records(Kind kind, std::vector<R> records) {
+    for (auto &r : records) {
+      r.loc = loc(r.loc);
+      fix(r);
+    }
+    add_section(kind, records);
+  }
+
+public:
+  explicit Writer(const FlatAST &_ast) : ast(_ast) {
+    memset(&header, 0, sizeof(header));
+  }
+
+  const std::vector<char> &run() {
+    out.resize(sizeof(Header));
+    add_records(k_integer_literal, ast.integer_literals);
+    add_records(k_string_literal, ast.string_literals);
+    add_records(k_binary_operator, ast.binary_operators);
+    add_records(k_sequence, ast.sequences);
+    add_records(k_let, ast.lets);
+    add_records(k_identifier, ast.identifiers);
+    add_records(k_if_then_else, ast.if_then_elses);
+    add_records(k_var_decl, ast.var_decls);
+    add_records(k_fun_decl, ast.fun_decls);
+    add_records(k_fun_call, ast.fun_calls);
+    add_records(k_while_loop, ast.while_loops);
+    add_records(k_for_loop, ast.for_loops);
+    add_records(k_break, ast.breaks);
+    add_records(k_assign, ast.assigns);
+    add_section(s_pool, ast.pool);
+
+    if (source) {
+      header.source_name = symbol(source->get_name()).get_id();
+      header.source_size = source->get_size();
+      header.source_named = source->is_named();
+      add_section(s_line_starts, source->get_line_starts());
+    } else
+      add_section(s_line_starts, std::vector<uint32_t>());
+    add_section(s_symbols, symbol_entries);
+    add_section(s_chars, chars);
+
+    memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.version = version;
+    header.root = ast.root.raw();
+    memcpy(out.data(), &header, sizeof(header));
+    return out;
+  }
+};
+
+// Builds the tree held in an AST file. Nodes are built children first,
+// using an explicit stack. Every reference is checked, each record may
+// only be used once in the tree, and the tree must be unbound.
+class TreeBuilder {
+  const ASTFile &file;
+  // The nodes built and not yet taken by their parent, and the records
+  // already pushed on the stack.
+  std::vector<Node *> nodes[kind_count];
+  std::vector<bool> seen[kind_count];
+
+  struct Entry {
+    NodeRef ref;
+    bool children_done;
+  };
+  std::vector<Entry> stack;
+  std::vector<NodeRef> children;
+
+  static bool valid(NodeRef ref, const std::vector<Node *> *table) {
+    return ref && ref.kind() < kind_count &&
+           ref.index() < table[ref.kind()].size();
+  }
+
+  Node *&node(NodeRef ref) {
+    if (!valid(ref, nodes))
+      invalid("bad node reference");
+    return nodes[ref.kind()][ref.index()];
+  }
+
+  template <typename R> const R &record(NodeRef ref) const {
+    return file.records<R>(ref.kind())[ref.index()];
+  }
+
+  // The fields common to all records, for a record of any kind.
+  const flat::Header &common(NodeRef ref) const {
+    return *reinterpret_cast<const flat::Header *>(
+        file.section<char>(ref.kind()) +
+        size_t(ref.index()) * element_sizes[ref.kind()]);
+  }
+
+  const NodeRef *span(Span s) {
+    if (s.begin > file.count(s_pool) || s.count > file.count(s_pool) - s.begin)
+      invalid("bad span");
+    return file.pool() + s.begin;
+  }
+
+  // Collect the references to the children of the record ref.
+  void collect_children(NodeRef ref) {
+    children.clear();
+    auto add_span = [&](Span s) {
+      const NodeRef *p = span(s);
+      children.insert(children.end(), p, p + s.count);
+    };
+    switch (ref.kind()) {
+    case k_binary_operator:
+      children.push_back(record<flat::BinaryOperator>(ref).left);
+      children.push_back(record<flat::BinaryOperator>(ref).right);
+      break;
+    case k_sequence:
+      add_span(record<flat::Sequence>(ref).exprs);
+      break;
+    case k_let:
+      add_span(record<flat::Let>(ref).decls);
+      children.push_back(record<flat::Let>(ref).sequence);
+      break;
+    case k_if_then_else:
+      children.push_back(record<flat::IfThenElse>(ref).condition);
+      children.push_back(record<flat::IfThenElse>(ref).then_part);
+      children.push_back(record<flat::IfThenElse>(ref).else_part);
+      break;
+    case k_var_decl:
+      if (record<flat::VarDecl>(ref).expr)
+        children.push_back(record<flat::VarDecl>(ref).expr);
+      break;
+    case k_fun_decl:
+      add_span(record<flat::FunDecl>(ref).params);
+      if (record<flat::FunDecl>(ref).expr)
+        children.push_back(record<flat::FunDecl>(ref).expr);
+      break;
+    case k_fun_call:
+      add_span(record<flat::FunCall>(ref).args);
+      break;
+    case k_while_loop:
+      children.push_back(record<flat::WhileLoop>(ref).condition);
+      children.push_back(record<flat::WhileLoop>(ref).body);
+      break;
+    case k_for_loop:
+      children.push_back(record<flat::ForLoop>(ref).variable);
+      children.push_back(record<flat::ForLoop>(ref).high);
+      children.push_back(record<flat::ForLoop>(ref).body);
+      break;
+    case k_assign:
+      children.push_back(record<flat::Assign>(ref).lhs);
+      children.push_back(record<flat::Assign>(ref).rhs);
+      break;
+    default:
+      break;
+    }
+  }
+
+  // The node built for ref, which must be of class T. Each node can only
+  // be taken once by its parent.
+  template <typename T> T *take(NodeRef ref) {
+    Node *&n = node(ref);
+    T *result = dynamic_cast<T *>(n);
+    if (!result)
+      invalid("bad child");
+    n = nullptr;
+    return result;
+  }
+
+  template <typename T> T *take_optional(NodeRef ref) {
+    return ref ? take<T>(ref) : nullptr;
+  }
+
+  template <typename T> std::vector<T *> take_all(Span s) {
+    const NodeRef *p = span(s);
+    std::vector<T *> result;
+    result.reserve(s.count);
+    for (uint32_t i = 0; i < s.count; i++)
+      result.push_back(take<T>(p[i]));
+    return result;
+  }
+
+  optional<Symbol> type_name(const Symbol &stored) {
+    const Symbol s = file.symbol(stored);
+    return s.get_id() ? optional<Symbol>(s) : boost::none;
+  }
+
+  Node *build(NodeRef ref) {
+    const SourceLoc loc = file.loc(common(ref).loc);
+    switch (ref.kind()) {
+    case k_integer_literal:
+      return new IntegerLiteral(loc, record<flat::IntegerLiteral>(ref).value);
+    case k_string_literal:
+      return new StringLiteral(
+          loc, file.symbol(record<flat::StringLiteral>(ref).value));
+    case k_binary_operator: {
+      auto &r = record<flat::BinaryOperator>(ref);
+      if (r.op > o_ge)
+        invalid("bad operator");
+      Expr *left = take<Expr>(r.left);
+      return new BinaryOperator(loc, left, take<Expr>(r.right),
+                                Operator(r.op));
+    }
+    case k_sequence:
+      return new Sequence(loc, take_all<Expr>(record<flat::Sequence>(ref).exprs));
+    case k_let: {
+      auto &r = record<flat::Let>(ref);
+      std::vector<Decl *> decls = take_all<Decl>(r.decls);
+      return new Let(loc, decls, take<Sequence>(r.sequence));
+    }
+    case k_identifier:
+      return new Identifier(loc,
+                            file.symbol(record<flat::Identifier>(ref).name));
+    case k_if_then_else: {
+      auto &r = record<flat::IfThenElse>(ref);
+      Expr *condition = take<Expr>(r.condition);
+      Expr *then_part = take<Expr>(r.then_part);
+      return new IfThenElse(loc, condition, then_part,
+                            take<Expr>(r.else_part));
+    }
+    case k_var_decl: {
+      auto &r = record<flat::VarDecl>(ref);
+      return new VarDecl(loc, file.symbol(r.name), type_name(r.type_name),
+                         take_optional<Expr>(r.expr), r.read_only);
+    }
+    case k_fun_decl: {
+      auto &r = record<flat::FunDecl>(ref);
+      std::vector<VarDecl *> params = take_all<VarDecl>(r.params);
+      return new FunDecl(loc, file.symbol(r.name), type_name(r.type_name),
+                         params, take_optional<Expr>(r.expr), r.is_external);
+    }
+    case k_fun_call: {
+      auto &r = record<flat::FunCall>(ref);
+      return new FunCall(loc, take_all<Expr>(r.args),
+                         file.symbol(r.func_name));
+    }
+    case k_while_loop: {
+      auto &r = record<flat::WhileLoop>(ref);
+      Expr *condition = take<Expr>(r.condition);
+      return new WhileLoop(loc, condition, take<Expr>(r.body));
+    }
+    case k_for_loop: {
+      auto &r = record<flat::ForLoop>(ref);
+      VarDecl *variable = take<VarDecl>(r.variable);
+      Expr *high = take<Expr>(r.high);
+      return new ForLoop(loc, variable, high, take<Expr>(r.body));
+    }
+    case k_break:
+      return new Break(loc);
+    default: {
+      auto &r = record<flat::Assign>(ref);
+      Identifier *lhs = take<Identifier>(r.lhs);
+      return new Assign(loc, lhs, take<Expr>(r.rhs));
+    }
+    }
+  }
+
+  // The driver binds and type checks the trees it loads, which must be left
+  // as the parser builds them: a record carrying binding information could
+  // not be bound again.
+  void check_unbound(NodeRef ref) const {
+    bool bound = common(ref).type != t_undef;
+    switch (ref.kind()) {
+    case k_identifier: {
+      auto &r = record<flat::Identifier>(ref);
+      bound |= r.decl || r.depth != -1;
+      break;
+    }
+    case k_var_decl: {
+      auto &r = record<flat::VarDecl>(ref);
+      bound |= r.escapes || r.depth != -1 || r.slot != -1;
+      break;
+    }
+    case k_fun_decl: {
+      auto &r = record<flat::FunDecl>(ref);
+      bound |= r.external_name.get_id() || r.depth != -1 || r.parent ||
+               r.escaping_decls.count || r.frame_size != -1;
+      break;
+    }
+    case k_fun_call: {
+      auto &r = record<flat::FunCall>(ref);
+      bound |= r.decl || r.depth != -1;
+      break;
+    }
+    case k_break:
+      bound |= bool(record<flat::Break>(ref).loop);
+      break;
+    default:
+      break;
+    }
+    if (bound)
+      invalid("bad binding");
+  }
+
+public:
+  explicit TreeBuilder(const ASTFile &_file) : file(_file) {
+    for (unsigned k = 0; k < kind_count; k++) {
+      nodes[k].resize(file.count(k));
+      seen[k].resize(file.count(k));
+    }
+  }
+
+  void push(NodeRef ref) {
+    node(ref);
+    if (seen[ref.kind()][ref.index()])
+      invalid("node used twice");
+    seen[ref.kind()][ref.index()] = true;
+    check_unbound(ref);
+    stack.push_back(Entry{ref, false});
+  }
+
+  // On error, nodes built so far are not released (they normally live in
+  // an arena).
+  Expr *run() {
+    const NodeRef root = file.root();
+    push(root);
+    while (!stack.empty()) {
+      const Entry entry = stack.back();
+      stack.pop_back();
+      if (entry.children_done) {
+        Node *n = build(entry.ref);
+        node(entry.ref) = n;
+        continue;
+      }
+      stack.push_back(Entry{entry.ref, true});
+      collect_children(entry.ref);
+      for (auto child = children.rbegin(); child != children.rend(); child++)
+        push(*child);
+    }
+    Expr *tree = take<Expr>(root);
+    return tree;
+  }
+};
+
+} // namespace
+
+void write_ast_file(const std::string &path, const FlatAST &ast) {
+  Writer writer(ast);
+  const std::vector<char> &contents = writer.run();
+  std::ofstream out(path, std::ios::binary);
+  out.write(contents.data(), contents.size());
+  out.close();
+  if (!out)
+    utils::error("cannot write " + path);
+}
+
+ASTFile::ASTFile(const std::string &path) {
+  load(path);
+  check_sections();
+  load_symbols();
+  load_source_map();
+}
+
+ASTFile::~ASTFile() {
+  if (mapped)
+    munmap(data, size);
+}
+
+void ASTFile::load(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    utils::error("cannot open " + path + ": " + strerror(errno));
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      data = static_cast<char *>(p);
+      size = st.st_size;
+      mapped = true;
+      close(fd);
+      return;
+    }
+  }
+  // Read the file in 8-byte aligned storage instead.
+  std::vector<char> contents;
+  char buffer[64 * 1024];
+  for (;;) {
+    const ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0) {
+      const int saved_errno = errno;
+      close(fd);
+      utils::error("cannot read " + path + ": " + strerror(saved_errno));
+    }
+    if (n == 0)
+      break;
+    contents.insert(contents.end(), buffer, buffer + n);
+  }
+  close(fd);
+  storage.resize((contents.size() + 7) / 8);
+  memcpy(storage.data(), contents.data(), contents.size());
+  data = reinterpret_cast<char *>(storage.data());
+  size = contents.size();
+}
+
+void ASTFile::check_sections() {
+  header = reinterpret_cast<const Header *>(data);
+  if (size < sizeof(Header) ||
+      memcmp(header->magic, file_magic, sizeof(file_magic)))
+    invalid("not an AST file");
+  if (header->version != version)
+    invalid("unsupported version");
+  for (unsigned s = 0; s < s_count; s++) {
+    const SectionEntry &entry = header->sections[s];
+    if (entry.element_size != element_sizes[s])
+      invalid("written by an incompatible compiler");
+    if (entry.offset % 8 || entry.offset > size || entry.count > UINT32_MAX ||
+        entry.count * entry.element_size > size - entry.offset)
+      invalid("bad section");
+  }
+}
+
+void ASTFile::load_symbols() {
+  const SymbolEntry *entries = section<SymbolEntry>(s_symbols);
+  const char *chars = section<char>(s_chars);
+  const uint32_t chars_count = count(s_chars);
+  symbols.reserve(count(s_symbols) + 1);
+  symbols.push_back(Symbol());
+  for (uint32_t i = 0; i < count(s_symbols); i++) {
+    const SymbolEntry &e = entries[i];
+    if (e.offset > chars_count || e.length > chars_count - e.offset)
+      invalid("bad symbol");
+    symbols.push_back(Symbol(boost::string_view(chars + e.offset, e.length)));
+  }
+}
+
+void ASTFile::load_source_map() {
+  const uint32_t *line_starts = section<uint32_t>(s_line_starts);
+  const uint32_t lines = count(s_line_starts);
+  if (!lines)
+    return;
+  if (line_starts[0] != 0)
+    invalid("bad line table");
+  for (uint32_t i = 1; i < lines; i++)
+    if (line_starts[i] <= line_starts[i - 1] ||
+        line_starts[i] > header->source_size)
+      invalid("bad line table");
+  const utils::SourceMap &map = utils::SourceMap::add(
+      symbol(stored_symbol(header->source_name)).get().to_string(),
+      header->source_size,
+      std::vector<uint32_t>(line_starts, line_starts + lines),
+      header->source_named);
+  source_base = map.get_base();
+}
+
+flat::NodeRef ASTFile::root() const {
+  NodeRef root;
+  memcpy(static_cast<void *>(&root), &header->root, sizeof(root));
+  return root;
+}
+
+Symbol ASTFile::symbol(const Symbol &stored) const {
+  if (stored.get_id() >= symbols.size())
+    invalid("bad symbol");
+  return symbols[stored.get_id()];
+}
+
+SourceLoc ASTFile::loc(const SourceLoc &stored) const {
+  if (!stored.get_begin() || !source_base ||
+      stored.get_begin() - 1 > header->source_size ||
+      stored.get_length() > header->source_size - (stored.get_begin() - 1))
+    return SourceLoc();
+  return SourceLoc(source_base + stored.get_begin() - 1, stored.get_length());
+}
+
+Expr *ASTFile::to_tree() const { return TreeBuilder(*this).run(); }
+
+} // namespace ast
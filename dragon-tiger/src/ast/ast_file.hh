@@ -0,0 +1,127 @@
+#ifndef AST_FILE_HH
+#define AST_FILE_HH
+
+#include <string>
+#include <vector>
+
+#include "flat_ast.hh"
+#include "nodes.hh"
+
+namespace ast {
+
+// Binary AST files hold the records of a FlatAST as they are laid out in
+// memory, so that a file can be mapped and used in place. A file is made of
+// a header followed by sections, each starting at a multiple of 8 bytes:
+// one per node kind (in the order of Kind), the pool of child references,
+// the symbol table with the characters of the symbols, and the line
+// structure of the source file.
+//
+// Records only differ from those of a FlatAST in two ways: their Symbol
+// fields hold indices in the symbol table of the file (0 standing for the
+// null symbol), and their locations are relative to the source file
+// described in the file (plus one, 0 standing for no location). Loading a
+// file interns its symbols and registers its source map; nothing else has
+// to be fixed up.
+//
+// Integers are written in the byte order of the machine, and the size of
+// each record is checked when loading: files are meant to be exchanged
+// between runs of the same compiler, not between machines.
+
+namespace file {
+
+const uint32_t version = 2;
+const unsigned kind_count = k_assign + 1;
+
+enum Section : uint32_t {
+  s_pool = kind_count,
+  s_symbols,
+  s_chars,
+  s_line_starts,
+  s_count
+};
+
+struct SectionEntry {
+  uint64_t offset;
+  uint64_t count;
+  uint32_t element_size;
+  uint32_t reserved;
+};
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t root;
+  // The source file: its name (a symbol index), its size and whether
+  // locations carried its name.
+  uint32_t source_name;
+  uint32_t source_size;
+  uint32_t source_named;
+  uint32_t reserved;
+  SectionEntry sections[s_count];
+};
+
+// The characters of a symbol, in the characters section.
+struct SymbolEntry {
+  uint32_t offset;
+  uint32_t length;
+};
+
+} // namespace file
+
+// Write ast to path in the binary AST format.
+void write_ast_file(const std::string &path, const FlatAST &ast);
+
+// A binary AST file, mapped in memory and checked.
+class ASTFile {
+  char *data = nullptr;
+  size_t size = 0;
+  bool mapped = false;
+  std::vector<uint64_t> storage;
+  const file::Header *header;
+
+  // The symbols of the file, by index.
+  std::vector<Symbol> symbols;
+  // The base of the source map registered for the file, or 0.
+  uint32_t source_base = 0;
+
+  void load(const std::string &path);
+  void check_sections();
+  void load_symbols();
+  void load_source_map();
+
+public:
+  explicit ASTFile(const std::string &path);
+  ~ASTFile();
+
+  ASTFile &operator=(const ASTFile &) = delete;
+  ASTFile(const ASTFile &) = delete;
+
+  // The contents of a section.
+  template <typename T> const T *section(unsigned s) const {
+    return reinterpret_cast<const T *>(data + header->sections[s].offset);
+  }
+  uint32_t count(unsigned s) const { return header->sections[s].count; }
+
+  // The records of the given kind, as stored in the file.
+  template <typename R> const R *records(Kind kind) const {
+    return section<R>(kind);
+  }
+  const flat::NodeRef *pool() const {
+    return section<flat::NodeRef>(file::s_pool);
+  }
+  flat::NodeRef root() const;
+
+  // Convert the symbols and locations found in records. A symbol index
+  // out of the symbol table is a format error.
+  Symbol symbol(const Symbol &stored) const;
+  SourceLoc loc(const SourceLoc &stored) const;
+
+  // Build the tree held in the file, in the current arena if there is one.
+  // The tree must be unbound, as the parser builds it: records carrying
+  // types or binding information are format errors.
+  Expr *to_tree() const;
+};
+
+} // namespace ast
+
+#endif // AST_FILE_HH
@@ -0,0 +1,295 @@
+#include <unordered_map>
+
+#include "flat_ast.hh"
+#include "traversal.hh"
+
+namespace ast {
+
+using flat::Header;
+using flat::NodeRef;
+using flat::Span;
+
+namespace {
+
+template <typename T> size_t bytes(const std::vector<T> &v) {
+  return v.size() * sizeof(T);
+}
+
+// Builds a FlatAST from a tree, walking it with an explicit stack. The
+// record of a node is created before its children are walked, and its
+// links to its children are filled after, at which point their spans are
+// appended to the pool. Links to nodes which may not be converted yet
+// (declarations, loops, parents) are resolved once the whole tree is done.
+class Flattener : public StaticVisitor<Flattener> {
+  FlatAST &ast;
+  // Whether visits create records or fill their links to children.
+  bool children_done = false;
+  std::unordered_map<const Node *, NodeRef> refs;
+
+  // A link field of the owner record (which one depends on its kind).
+  struct Fixup {
+    NodeRef owner;
+    const Node *target;
+  };
+  std::vector<Fixup> fixups;
+  // A pool entry designating target.
+  std::vector<std::pair<uint32_t, const Node *>> pool_fixups;
+
+  template <typename R>
+  R &add(std::vector<R> &records, Kind kind, const Node &node) {
+    assert(records.size() < (1u << NodeRef::index_bits));
+    refs[&node] = NodeRef(kind, records.size());
+    records.emplace_back();
+    R &r = records.back();
+    r.loc = node.loc;
+    r.type = node.get_type();
+    return r;
+  }
+
+  template <typename R>
+  R &record(std::vector<R> &records, const Node &node) {
+    return records[refs.at(&node).index()];
+  }
+
+  NodeRef ref(const Node &node) { return refs.at(&node); }
+
+  template <typename T> NodeRef ref(const optional<const T &> &node) {
+    return node ? ref(*node) : NodeRef();
+  }
+
+  template <typename T> Span span(const NodeVector<T *> &nodes) {
+    Span span = {uint32_t(ast.pool.size()), uint32_t(nodes.size())};
+    for (auto node : nodes)
+      ast.pool.push_back(ref(*node));
+    return span;
+  }
+
+  template <typename T>
+  void link(const Node &owner, const optional<T &> &target) {
+    if (target)
+      fixups.push_back(Fixup{ref(owner), &*target});
+  }
+
+  NodeRef &link_field(NodeRef owner) {
+    const uint32_t i = owner.index();
+    switch (owner.kind()) {
+    case k_identifier:
+      return ast.identifiers[i].decl;
+    case k_fun_call:
+      return ast.fun_calls[i].decl;
+    case k_break:
+      return ast.breaks[i].loop;
+    default:
+      assert(owner.kind() == k_fun_decl);
+      return ast.fun_decls[i].parent;
+    }
+  }
+
+public:
+  explicit Flattener(FlatAST &_ast) : ast(_ast) {}
+
+  void run(const Node &root) {
+    walk(root,
+         [this](const Node &node) {
+           children_done = false;
+           dispatch(node);
+         },
+         [this](const Node &node) {
+           children_done = true;
+           dispatch(node);
+         });
+    ast.root = ref(root);
+    for (auto &fixup : fixups)
+      link_field(fixup.owner) = refs.at(fixup.target);
+    for (auto &fixup : pool_fixups)
+      ast.pool[fixup.first] = refs.at(fixup.second);
+  }
+
+  void visit(const IntegerLiteral &node) {
+    if (!children_done)
+      add(ast.integer_literals, k_integer_literal, node).value = node.value;
+  }
+
+  void visit(const StringLiteral &node) {
+    if (!children_done)
+      add(ast.string_literals, k_string_literal, node).value = node.value;
+  }
+
+  void visit(const BinaryOperator &node) {
+    if (!children_done) {
+      add(ast.binary_operators, k_binary_operator, node).op = node.op;
+      return;
+    }
+    flat::BinaryOperator &r = record(ast.binary_operators, node);
+    r.left = ref(node.get_left());
+    r.right = ref(node.get_right());
+  }
+
+  void visit(const Sequence &node) {
+    if (!children_done) {
+      add(ast.sequences, k_sequence, node);
+      return;
+    }
+    const Span exprs = span(node.get_exprs());
+    record(ast.sequences, node).exprs = exprs;
+  }
+
+  void visit(const Let &node) {
+    if (!children_done) {
+      add(ast.lets, k_let, node);
+      return;
+    }
+    const Span decls = span(node.get_decls());
+    flat::Let &r = record(ast.lets, node);
+    r.decls = decls;
+    r.sequence = ref(node.get_sequence());
+  }
+
+  void visit(const Identifier &node) {
+    if (children_done)
+      return;
+    flat::Identifier &r = add(ast.identifiers, k_identifier, node);
+    r.name = node.name;
+    r.depth = node.get_depth();
+    link(node, node.get_decl());
+  }
+
+  void visit(const IfThenElse &node) {
+    if (!children_done) {
+      add(ast.if_then_elses, k_if_then_else, node);
+      return;
+    }
+    flat::IfThenElse &r = record(ast.if_then_elses, node);
+    r.condition = ref(node.get_condition());
+    r.then_part = ref(node.get_then_part());
+    r.else_part = ref(node.get_else_part());
+  }
+
+  void visit(const VarDecl &node) {
+    if (children_done) {
+      record(ast.var_decls, node).expr = ref(node.get_expr());
+      return;
+    }
+    flat::VarDecl &r = add(ast.var_decls, k_var_decl, node);
+    r.read_only = node.read_only;
+    r.escapes = node.get_escapes();
+    r.name = node.name;
+    r.type_name = node.type_name ? *node.type_name : Symbol();
+    r.depth = node.get_depth();
+    r.slot = node.get_slot();
+  }
+
+  void visit(const FunDecl &node) {
+    if (!children_done) {
+      flat::FunDecl &r = add(ast.fun_decls, k_fun_decl, node);
+      r.is_external = node.is_external;
+      r.name = node.name;
+      r.type_name = node.type_name ? *node.type_name : Symbol();
+      r.external_name = node.get_external_name();
+      r.depth = node.get_depth();
+      r.frame_size = node.get_frame_size();
+      link(node, node.get_parent());
+      return;
+    }
+    const Span params = span(node.get_params());
+    auto &escaping = node.get_escaping_decls();
+    const Span escaping_decls = {uint32_t(ast.pool.size()),
+                                 uint32_t(escaping.size())};
+    for (auto decl : escaping) {
+      pool_fixups.push_back(std::make_pair(uint32_t(ast.pool.size()), decl));
+      ast.pool.emplace_back();
+    }
+    flat::FunDecl &r = record(ast.fun_decls, node);
+    r.params = params;
+    r.expr = ref(node.get_expr());
+    r.escaping_decls = escaping_decls;
+  }
+
+  void visit(const FunCall &node) {
+    if (!children_done) {
+      flat::FunCall &r = add(ast.fun_calls, k_fun_call, node);
+      r.func_name = node.func_name;
+      r.depth = node.get_depth();
+      link(node, node.get_decl());
+      return;
+    }
+    const Span args = span(node.get_args());
+    record(ast.fun_calls, node).args = args;
+  }
+
+  void visit(const WhileLoop &node) {
+    if (!children_done) {
+      add(ast.while_loops, k_while_loop, node);
+      return;
+    }
+    flat::WhileLoop &r = record(ast.while_loops, node);
+    r.condition = ref(node.get_condition());
+    r.body = ref(node.get_body());
+  }
+
+  void visit(const ForLoop &node) {
+    if (!children_done) {
+      add(ast.for_loops, k_for_loop, node);
+      return;
+    }
+    flat::ForLoop &r = record(ast.for_loops, node);
+    r.variable = ref(node.get_variable());
+    r.high = ref(node.get_high());
+    r.body = ref(node.get_body());
+  }
+
+  void visit(const Break &node) {
+    if (children_done)
+      return;
+    add(ast.breaks, k_break, node);
+    link(node, node.get_loop());
+  }
+
+  void visit(const Assign &node) {
+    if (!children_done) {
+      add(ast.assigns, k_assign, node);
+      return;
+    }
+    flat::Assign &r = record(ast.assigns, node);
+    r.lhs = ref(node.get_lhs());
+    r.rhs = ref(node.get_rhs());
+  }
+};
+
+// Returns the header of the record designated by a reference.
+struct HeaderOf {
+  template <typename R> const Header &visit(const R &record, NodeRef) {
+    return record;
+  }
+};
+
+} // namespace
+
+const Header &FlatAST::header(NodeRef ref) const {
+  HeaderOf visitor;
+  return dispatch(*this, ref, visitor);
+}
+
+size_t FlatAST::node_count() const {
+  return integer_literals.size() + string_literals.size() +
+         binary_operators.size() + sequences.size() + lets.size() +
+         identifiers.size() + if_then_elses.size() + var_decls.size() +
+         fun_decls.size() + fun_calls.size() + while_loops.size() +
+         for_loops.size() + breaks.size() + assigns.size();
+}
+
+size_t FlatAST::memory_usage() const {
+  return bytes(integer_literals) + bytes(string_literals) +
+         bytes(binary_operators) + bytes(sequences) + bytes(lets) +
+         bytes(identifiers) + bytes(if_then_elses) + bytes(var_decls) +
+         bytes(fun_decls) + bytes(fun_calls) + bytes(while_loops) +
+         bytes(for_loops) + bytes(breaks) + bytes(assigns) + bytes(pool);
+}
+
+FlatAST flatten(const Node &root) {
+  FlatAST ast;
+  Flattener(ast).run(root);
+  return ast;
+}
+
+} // namespace ast
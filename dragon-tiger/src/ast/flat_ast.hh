@@ -0,0 +1,223 @@
+#ifndef FLAT_AST_HH
+#define FLAT_AST_HH
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "nodes.hh"
+
+namespace ast {
+
+// An alternative, data-oriented representation of an AST. Nodes of each
+// kind are stored in their own array and designated by a 32-bit reference
+// made of a kind tag and an index in that array. Lists of children are
+// spans of one pool of references shared by the whole tree. All records
+// are plain data, so that a FlatAST can be walked linearly, processed in
+// batches and copied around as raw memory.
+
+namespace flat {
+
+// A kind tag (see nodes.hh) in the 4 upper bits, an index in the lower ones.
+class NodeRef {
+  uint32_t bits;
+
+public:
+  static const unsigned index_bits = 28;
+
+  NodeRef() : bits(UINT32_MAX) {}
+  NodeRef(Kind kind, uint32_t index)
+      : bits(uint32_t(kind) << index_bits | index) {}
+  Kind kind() const { return Kind(bits >> index_bits); }
+  uint32_t index() const { return bits & ((1u << index_bits) - 1); }
+  uint32_t raw() const { return bits; }
+  explicit operator bool() const { return bits != UINT32_MAX; }
+  bool operator==(NodeRef other) const { return bits == other.bits; }
+  bool operator!=(NodeRef other) const { return bits != other.bits; }
+};
+
+// A list of children: count consecutive references in the pool.
+struct Span {
+  uint32_t begin;
+  uint32_t count;
+};
+
+// Fields common to all nodes.
+struct Header {
+  SourceLoc loc;
+  uint8_t type;
+};
+
+struct IntegerLiteral : Header {
+  int32_t value;
+};
+
+struct StringLiteral : Header {
+  Symbol value;
+};
+
+struct BinaryOperator : Header {
+  uint8_t op;
+  NodeRef left;
+  NodeRef right;
+};
+
+struct Sequence : Header {
+  Span exprs;
+};
+
+struct Let : Header {
+  Span decls;
+  NodeRef sequence;
+};
+
+struct Identifier : Header {
+  Symbol name;
+  NodeRef decl;
+  int32_t depth;
+};
+
+struct IfThenElse : Header {
+  NodeRef condition;
+  NodeRef then_part;
+  NodeRef else_part;
+};
+
+// A null type_name symbol means that there is no type annotation.
+struct VarDecl : Header {
+  uint8_t read_only;
+  uint8_t escapes;
+  Symbol name;
+  Symbol type_name;
+  int32_t depth;
+  int32_t slot;
+  NodeRef expr;
+};
+
+struct FunDecl : Header {
+  uint8_t is_external;
+  Symbol name;
+  Symbol type_name;
+  Symbol external_name;
+  int32_t depth;
+  Span params;
+  NodeRef expr;
+  NodeRef parent;
+  Span escaping_decls;
+  int32_t frame_size;
+};
+
+struct FunCall : Header {
+  Symbol func_name;
+  Span args;
+  NodeRef decl;
+  int32_t depth;
+};
+
+struct WhileLoop : Header {
+  NodeRef condition;
+  NodeRef body;
+};
+
+struct ForLoop : Header {
+  NodeRef variable;
+  NodeRef high;
+  NodeRef body;
+};
+
+struct Break : Header {
+  NodeRef loop;
+};
+
+struct Assign : Header {
+  NodeRef lhs;
+  NodeRef rhs;
+};
+
+} // namespace flat
+
+class FlatAST {
+public:
+  std::vector<flat::IntegerLiteral> integer_literals;
+  std::vector<flat::StringLiteral> string_literals;
+  std::vector<flat::BinaryOperator> binary_operators;
+  std::vector<flat::Sequence> sequences;
+  std::vector<flat::Let> lets;
+  std::vector<flat::Identifier> identifiers;
+  std::vector<flat::IfThenElse> if_then_elses;
+  std::vector<flat::VarDecl> var_decls;
+  std::vector<flat::FunDecl> fun_decls;
+  std::vector<flat::FunCall> fun_calls;
+  std::vector<flat::WhileLoop> while_loops;
+  std::vector<flat::ForLoop> for_loops;
+  std::vector<flat::Break> breaks;
+  std::vector<flat::Assign> assigns;
+
+  // Storage for all the lists of children.
+  std::vector<flat::NodeRef> pool;
+
+  flat::NodeRef root;
+
+  // Iterate over the references of a span.
+  const flat::NodeRef *begin(flat::Span span) const {
+    return pool.data() + span.begin;
+  }
+  const flat::NodeRef *end(flat::Span span) const {
+    return pool.data() + span.begin + span.count;
+  }
+
+  // The common fields of any node.
+  const flat::Header &header(flat::NodeRef ref) const;
+
+  size_t node_count() const;
+  // Bytes used by the records and the pool.
+  size_t memory_usage() const;
+};
+
+// Build the flat representation of the tree rooted at root. Binding
+// information (declarations, depths, loops, parents, escapes) is kept.
+FlatAST flatten(const Node &root);
+
+// Call visitor.visit(record, ref) for the record designated by ref, and
+// return its result. Dispatching is done on the kind tag, without any
+// virtual call.
+template <typename Visitor>
+auto dispatch(const FlatAST &ast, flat::NodeRef ref, Visitor &visitor)
+    -> decltype(visitor.visit(ast.integer_literals[0], ref)) {
+  const uint32_t i = ref.index();
+  switch (ref.kind()) {
+  case k_integer_literal:
+    return visitor.visit(ast.integer_literals[i], ref);
+  case k_string_literal:
+    return visitor.visit(ast.string_literals[i], ref);
+  case k_binary_operator:
+    return visitor.visit(ast.binary_operators[i], ref);
+  case k_sequence:
+    return visitor.visit(ast.sequences[i], ref);
+  case k_let:
+    return visitor.visit(ast.lets[i], ref);
+  case k_identifier:
+    return visitor.visit(ast.identifiers[i], ref);
+  case k_if_then_else:
+    return visitor.visit(ast.if_then_elses[i], ref);
+  case k_var_decl:
+    return visitor.visit(ast.var_decls[i], ref);
+  case k_fun_decl:
+    return visitor.visit(ast.fun_decls[i], ref);
+  case k_fun_call:
+    return visitor.visit(ast.fun_calls[i], ref);
+  case k_while_loop:
+    return visitor.visit(ast.while_loops[i], ref);
+  case k_for_loop:
+    return visitor.visit(ast.for_loops[i], ref);
+  case k_break:
+    return visitor.visit(ast.breaks[i], ref);
+  default:
+    assert(ref.kind() == k_assign);
+    return visitor.visit(ast.assigns[i], ref);
+  }
+}
+
+} // namespace ast
+
+#endif // FLAT_AST_HH
@@ -0,0 +1,33 @@
+#include "nodes.hh"
+
+namespace ast {
+
+namespace {
+
+// The nodes waiting to be deleted by the running thread.
+struct DisposeList {
+  std::vector<Node *> pending;
+  bool active = false;
+};
+
+thread_local DisposeList dispose_list;
+
+} // namespace
+
+void Node::dispose(Node *node) {
+  if (!node)
+    return;
+  DisposeList &list = dispose_list;
+  list.pending.push_back(node);
+  if (list.active)
+    return;
+  list.active = true;
+  while (!list.pending.empty()) {
+    Node *next = list.pending.back();
+    list.pending.pop_back();
+    delete next;
+  }
+  list.active = false;
+}
+
+} // namespace ast
@@ -12,6 +12,8 @@
 #include <boost/optional.hpp>
 
 #include "../parser/location.hh"
+#include "../utils/arena.hh"
+#include "../utils/source_map.hh"
 #include "../utils/symbols.hh"
 
 namespace ast {
@@ -21,9 +23,32 @@ inline namespace types {
 using boost::optional;
 using utils::Symbol;
 
+using utils::SourceLoc;
 using yy::location;
 
+// Lists of children are allocated alongside the nodes owning them.
+template <typename T>
+using NodeVector = std::vector<T, utils::ArenaAllocator<T>>;
+
 typedef enum { t_undef = 0, t_int, t_string, t_void } Type;
+// The concrete class of a node, used for static dispatch (see
+// static_visitor.hh).
+typedef enum {
+  k_integer_literal = 0,
+  k_string_literal,
+  k_binary_operator,
+  k_sequence,
+  k_let,
+  k_identifier,
+  k_if_then_else,
+  k_var_decl,
+  k_fun_decl,
+  k_fun_call,
+  k_while_loop,
+  k_for_loop,
+  k_break,
+  k_assign
+} Kind;
 typedef enum {
   o_plus = 0,
   o_minus,
@@ -103,10 +128,11 @@ class Node {
 
 public:
   // Public fields
-  const location loc;
+  const SourceLoc loc;
+  const Kind kind;
 
   // Constructor
-  Node(const location &_loc) : loc(_loc) {}
+  Node(const Kind &_kind, const SourceLoc &_loc) : loc(_loc), kind(_kind) {}
 
   // Destructor
   virtual ~Node() {}
@@ -115,6 +141,33 @@ public:
   Node &operator=(const Node &) = delete;
   Node(const Node &) = delete;
 
+  // Nodes are allocated from the current arena if there is one (see
+  // utils::Arena), and from the heap otherwise. Each node is preceded by a
+  // header recording which, so that deleting a node releases its memory if
+  // it came from the heap, and only runs its destructor if it came from an
+  // arena, whatever arena is current when it is deleted.
+  static void *operator new(size_t size) {
+    static_assert(alignof(Node) >= sizeof(bool), "no room for the header");
+    utils::Arena *arena = utils::Arena::current();
+    char *block = static_cast<char *>(
+        arena ? arena->allocate(alignof(Node) + size, alignof(Node))
+              : utils::heap_allocate(alignof(Node) + size));
+    *reinterpret_cast<bool *>(block) = !arena;
+    return block + alignof(Node);
+  }
+  static void operator delete(void *p) {
+    char *block = static_cast<char *>(p) - alignof(Node);
+    if (*reinterpret_cast<bool *>(block))
+      utils::heap_release(block);
+  }
+
+  // Delete node, if any. Destructors dispose of children instead of
+  // deleting them: the nodes are queued, and the outermost call deletes
+  // them one by one, so that deleting a tree does not recurse as deep as
+  // the tree is. Setters of children replace them without disposing of the
+  // previous ones.
+  static void dispose(Node *node);
+
   // Setter and getters for field `type'
   void set_type(Type _type) {
     assert(type == t_undef && _type != t_undef);
@@ -132,7 +185,7 @@ public:
 class Expr : public Node {
 public:
   // Constructor
-  Expr(const location &_loc) : Node(_loc) {}
+  Expr(const Kind &_kind, const SourceLoc &_loc) : Node(_kind, _loc) {}
 };
 
 class Decl : public Node {
@@ -143,9 +196,9 @@ public:
   int depth = -1;
 
   // Constructor
-  Decl(const location &_loc, const Symbol &_name,
+  Decl(const Kind &_kind, const SourceLoc &_loc, const Symbol &_name,
        const optional<Symbol> &_type_name)
-      : Node(_loc), name(_name), type_name(_type_name) {}
+      : Node(_kind, _loc), name(_name), type_name(_type_name) {}
 
   // Setter and getters for field `depth'
   void set_depth(int _depth) {
@@ -162,8 +215,8 @@ public:
   const int32_t value;
 
   // Constructor
-  IntegerLiteral(const location &_loc, const int32_t &_value)
-      : Expr(_loc), value(_value) {}
+  IntegerLiteral(const SourceLoc &_loc, const int32_t &_value)
+      : Expr(k_integer_literal, _loc), value(_value) {}
 
   // Acceptor method for visitors
   virtual void accept(ASTVisitor &visitor) { visitor.visit(*this); }
@@ -179,8 +232,8 @@ public:
   const Symbol value;
 
   // Constructor
-  StringLiteral(const location &_loc, const Symbol &_value)
-      : Expr(_loc), value(_value) {}
+  StringLiteral(const SourceLoc &_loc, const Symbol &_value)
+      : Expr(k_string_literal, _loc), value(_value) {}
 
   // Acceptor method for visitors
   virtual void accept(ASTVisitor &visitor) { visitor.visit(*this); }
@@ -201,21 +254,23 @@ public:
   const Operator op;
 
   // Constructor
-  BinaryOperator(const location &_loc, Expr *_left, Expr *_right,
+  BinaryOperator(const SourceLoc &_loc, Expr *_left, Expr *_right,
                  const Operator &_op)
-      : Expr(_loc), left(_left), right(_right), op(_op) {}
+      : Expr(k_binary_operator, _loc), left(_left), right(_right), op(_op) {}
 
   // Destructor
   virtual ~BinaryOperator() {
-    delete right;
-    delete left;
+    dispose(right);
+    dispose(left);
   }
 
-  // Getters for field `left'
+  // Setter and getters for field `left'
+  void set_left(Expr *_left) { left = _left; }
   Expr &get_left() { return *left; }
   const Expr &get_left() const { return *left; }
 
-  // Getters for field `right'
+  // Setter and getters for field `right'
+  void set_right(Expr *_right) { right = _right; }
   Expr &get_right() { return *right; }
   const Expr &get_right() const { return *right; }
 
@@ -230,22 +285,22 @@ public:
 class Sequence : public Expr {
 
   // Private fields
-  std::vector<Expr *> exprs;
+  NodeVector<Expr *> exprs;
 
 public:
   // Constructor
-  Sequence(const location &_loc, const std::vector<Expr *> &_exprs)
-      : Expr(_loc), exprs(_exprs) {}
+  Sequence(const SourceLoc &_loc, const std::vector<Expr *> &_exprs)
+      : Expr(k_sequence, _loc), exprs(_exprs.begin(), _exprs.end()) {}
 
   // Destructor
   virtual ~Sequence() {
     for (auto expr : exprs)
-      delete expr;
+      dispose(expr);
   }
 
   // Getters for field `exprs'
-  std::vector<Expr *> &get_exprs() { return exprs; }
-  const std::vector<Expr *> &get_exprs() const { return exprs; }
+  NodeVector<Expr *> &get_exprs() { return exprs; }
+  const NodeVector<Expr *> &get_exprs() const { return exprs; }
 
   // Acceptor method for visitors
   virtual void accept(ASTVisitor &visitor) { visitor.visit(*this); }
@@ -258,25 +313,26 @@ public:
 class Let : public Expr {
 
   // Private fields
-  std::vector<Decl *> decls;
+  NodeVector<Decl *> decls;
   Sequence *sequence;
 
 public:
   // Constructor
-  Let(const location &_loc, const std::vector<Decl *> &_decls,
+  Let(const SourceLoc &_loc, const std::vector<Decl *> &_decls,
       Sequence *_sequence)
-      : Expr(_loc), decls(_decls), sequence(_sequence) {}
+      : Expr(k_let, _loc), decls(_decls.begin(), _decls.end()),
+        sequence(_sequence) {}
 
   // Destructor
   virtual ~Let() {
-    delete sequence;
+    dispose(sequence);
     for (auto decl : decls)
-      delete decl;
+      dispose(decl);
   }
 
   // Getters for field `decls'
-  std::vector<Decl *> &get_decls() { return decls; }
-  const std::vector<Decl *> &get_decls() const { return decls; }
+  NodeVector<Decl *> &get_decls() { return decls; }
+  const NodeVector<Decl *> &get_decls() const { return decls; }
 
   // Getters for field `sequence'
   Sequence &get_sequence() { return *sequence; }
@@ -301,14 +357,19 @@ public:
   const Symbol name;
 
   // Constructor
-  Identifier(const location &_loc, const Symbol &_name)
-      : Expr(_loc), name(_name) {}
+  Identifier(const SourceLoc &_loc, const Symbol &_name)
+      : Expr(k_identifier, _loc), name(_name) {}
 
   // Setter and getters for field `decl'
   void set_decl(VarDecl *_decl) {
     assert(!decl && _decl);
     decl = _decl;
   }
+  // Transformations of bound programs may bind the identifier again.
+  void rebind(VarDecl *_decl) {
+    assert(decl && _decl);
+    decl = _decl;
+  }
   optional<VarDecl &> get_decl() {
     if (!decl)
       return boost::none;
@@ -345,27 +406,30 @@ class IfThenElse : public Expr {
 
 public:
   // Constructor
-  IfThenElse(const location &_loc, Expr *_condition, Expr *_then_part,
+  IfThenElse(const SourceLoc &_loc, Expr *_condition, Expr *_then_part,
              Expr *_else_part)
-      : Expr(_loc), condition(_condition), then_part(_then_part),
-        else_part(_else_part) {}
+      : Expr(k_if_then_else, _loc), condition(_condition),
+        then_part(_then_part), else_part(_else_part) {}
 
   // Destructor
   virtual ~IfThenElse() {
-    delete else_part;
-    delete then_part;
-    delete condition;
+    dispose(else_part);
+    dispose(then_part);
+    dispose(condition);
   }
 
-  // Getters for field `condition'
+  // Setter and getters for field `condition'
+  void set_condition(Expr *_condition) { condition = _condition; }
   Expr &get_condition() { return *condition; }
   const Expr &get_condition() const { return *condition; }
 
-  // Getters for field `then_part'
+  // Setter and getters for field `then_part'
+  void set_then_part(Expr *_then_part) { then_part = _then_part; }
   Expr &get_then_part() { return *then_part; }
   const Expr &get_then_part() const { return *then_part; }
 
-  // Getters for field `else_part'
+  // Setter and getters for field `else_part'
+  void set_else_part(Expr *_else_part) { else_part = _else_part; }
   Expr &get_else_part() { return *else_part; }
   const Expr &get_else_part() const { return *else_part; }
 
@@ -382,21 +446,24 @@ class VarDecl : public Decl {
   // Private fields
   Expr *expr;
   bool escapes = false;
+  int slot = -1;
 
 public:
   // Public fields
   const bool read_only;
 
   // Constructor
-  VarDecl(const location &_loc, const Symbol &_name,
+  VarDecl(const SourceLoc &_loc, const Symbol &_name,
           const optional<Symbol> &_type_name, Expr *_expr,
           const bool &_read_only = false)
-      : Decl(_loc, _name, _type_name), expr(_expr), read_only(_read_only) {}
+      : Decl(k_var_decl, _loc, _name, _type_name), expr(_expr),
+        read_only(_read_only) {}
 
   // Destructor
-  virtual ~VarDecl() { delete expr; }
+  virtual ~VarDecl() { dispose(expr); }
 
-  // Getters for field `expr'
+  // Setter and getters for field `expr'
+  void set_expr(Expr *_expr) { expr = _expr; }
   optional<Expr &> get_expr() {
     if (!expr)
       return boost::none;
@@ -413,6 +480,14 @@ public:
   bool &get_escapes() { return escapes; }
   const bool &get_escapes() const { return escapes; }
 
+  // Setter and getters for field `slot'
+  void set_slot(int _slot) {
+    assert(slot == -1 && _slot != -1);
+    slot = _slot;
+  }
+  int &get_slot() { return slot; }
+  const int &get_slot() const { return slot; }
+
   // Acceptor method for visitors
   virtual void accept(ASTVisitor &visitor) { visitor.visit(*this); }
   virtual void accept(ConstASTVisitor &visitor) const { visitor.visit(*this); }
@@ -424,36 +499,39 @@ public:
 class FunDecl : public Decl {
 
   // Private fields
-  std::vector<VarDecl *> params;
+  NodeVector<VarDecl *> params;
   Expr *expr;
   Symbol external_name = Symbol();
   FunDecl *parent = nullptr;
-  std::vector<VarDecl *> escaping_decls = std::vector<VarDecl *>();
+  NodeVector<VarDecl *> escaping_decls = NodeVector<VarDecl *>();
+  int frame_size = -1;
 
 public:
   // Public fields
   const bool is_external;
 
   // Constructor
-  FunDecl(const location &_loc, const Symbol &_name,
+  FunDecl(const SourceLoc &_loc, const Symbol &_name,
           const optional<Symbol> &_type_name,
           const std::vector<VarDecl *> &_params, Expr *_expr,
           const bool &_is_external = false)
-      : Decl(_loc, _name, _type_name), params(_params), expr(_expr),
+      : Decl(k_fun_decl, _loc, _name, _type_name),
+        params(_params.begin(), _params.end()), expr(_expr),
         is_external(_is_external) {}
 
   // Destructor
   virtual ~FunDecl() {
-    delete expr;
+    dispose(expr);
     for (auto param : params)
-      delete param;
+      dispose(param);
   }
 
   // Getters for field `params'
-  std::vector<VarDecl *> &get_params() { return params; }
-  const std::vector<VarDecl *> &get_params() const { return params; }
+  NodeVector<VarDecl *> &get_params() { return params; }
+  const NodeVector<VarDecl *> &get_params() const { return params; }
 
-  // Getters for field `expr'
+  // Setter and getters for field `expr'
+  void set_expr(Expr *_expr) { expr = _expr; }
   optional<Expr &> get_expr() {
     if (!expr)
       return boost::none;
@@ -478,6 +556,11 @@ public:
     assert(!parent && _parent);
     parent = _parent;
   }
+  // Transformations of bound programs may move the function.
+  void reparent(FunDecl *_parent) {
+    assert(parent && _parent);
+    parent = _parent;
+  }
   optional<FunDecl &> get_parent() {
     if (!parent)
       return boost::none;
@@ -490,11 +573,19 @@ public:
   }
 
   // Getters for field `escaping_decls'
-  std::vector<VarDecl *> &get_escaping_decls() { return escaping_decls; }
-  const std::vector<VarDecl *> &get_escaping_decls() const {
+  NodeVector<VarDecl *> &get_escaping_decls() { return escaping_decls; }
+  const NodeVector<VarDecl *> &get_escaping_decls() const {
     return escaping_decls;
   }
 
+  // Setter and getters for field `frame_size'
+  void set_frame_size(int _frame_size) {
+    assert(frame_size == -1 && _frame_size != -1);
+    frame_size = _frame_size;
+  }
+  int &get_frame_size() { return frame_size; }
+  const int &get_frame_size() const { return frame_size; }
+
   // Acceptor method for visitors
   virtual void accept(ASTVisitor &visitor) { visitor.visit(*this); }
   virtual void accept(ConstASTVisitor &visitor) const { visitor.visit(*this); }
@@ -506,7 +597,7 @@ public:
 class FunCall : public Expr {
 
   // Private fields
-  std::vector<Expr *> args;
+  NodeVector<Expr *> args;
   FunDecl *decl = nullptr;
   int depth = -1;
 
@@ -515,19 +606,20 @@ public:
   const Symbol func_name;
 
   // Constructor
-  FunCall(const location &_loc, const std::vector<Expr *> &_args,
+  FunCall(const SourceLoc &_loc, const std::vector<Expr *> &_args,
           const Symbol &_func_name)
-      : Expr(_loc), args(_args), func_name(_func_name) {}
+      : Expr(k_fun_call, _loc), args(_args.begin(), _args.end()),
+        func_name(_func_name) {}
 
   // Destructor
   virtual ~FunCall() {
     for (auto arg : args)
-      delete arg;
+      dispose(arg);
   }
 
   // Getters for field `args'
-  std::vector<Expr *> &get_args() { return args; }
-  const std::vector<Expr *> &get_args() const { return args; }
+  NodeVector<Expr *> &get_args() { return args; }
+  const NodeVector<Expr *> &get_args() const { return args; }
 
   // Setter and getters for field `decl'
   void set_decl(FunDecl *_decl) {
@@ -564,7 +656,7 @@ public:
 class Loop : public Expr {
 public:
   // Constructor
-  Loop(const location &_loc) : Expr(_loc) {}
+  Loop(const Kind &_kind, const SourceLoc &_loc) : Expr(_kind, _loc) {}
 };
 
 class WhileLoop : public Loop {
@@ -575,20 +667,22 @@ class WhileLoop : public Loop {
 
 public:
   // Constructor
-  WhileLoop(const location &_loc, Expr *_condition, Expr *_body)
-      : Loop(_loc), condition(_condition), body(_body) {}
+  WhileLoop(const SourceLoc &_loc, Expr *_condition, Expr *_body)
+      : Loop(k_while_loop, _loc), condition(_condition), body(_body) {}
 
   // Destructor
   virtual ~WhileLoop() {
-    delete body;
-    delete condition;
+    dispose(body);
+    dispose(condition);
   }
 
-  // Getters for field `condition'
+  // Setter and getters for field `condition'
+  void set_condition(Expr *_condition) { condition = _condition; }
   Expr &get_condition() { return *condition; }
   const Expr &get_condition() const { return *condition; }
 
-  // Getters for field `body'
+  // Setter and getters for field `body'
+  void set_body(Expr *_body) { body = _body; }
   Expr &get_body() { return *body; }
   const Expr &get_body() const { return *body; }
 
@@ -609,25 +703,27 @@ class ForLoop : public Loop {
 
 public:
   // Constructor
-  ForLoop(const location &_loc, VarDecl *_variable, Expr *_high, Expr *_body)
-      : Loop(_loc), variable(_variable), high(_high), body(_body) {}
+  ForLoop(const SourceLoc &_loc, VarDecl *_variable, Expr *_high, Expr *_body)
+      : Loop(k_for_loop, _loc), variable(_variable), high(_high), body(_body) {}
 
   // Destructor
   virtual ~ForLoop() {
-    delete body;
-    delete high;
-    delete variable;
+    dispose(body);
+    dispose(high);
+    dispose(variable);
   }
 
   // Getters for field `variable'
   VarDecl &get_variable() { return *variable; }
   const VarDecl &get_variable() const { return *variable; }
 
-  // Getters for field `high'
+  // Setter and getters for field `high'
+  void set_high(Expr *_high) { high = _high; }
   Expr &get_high() { return *high; }
   const Expr &get_high() const { return *high; }
 
-  // Getters for field `body'
+  // Setter and getters for field `body'
+  void set_body(Expr *_body) { body = _body; }
   Expr &get_body() { return *body; }
   const Expr &get_body() const { return *body; }
 
@@ -646,7 +742,7 @@ class Break : public Expr {
 
 public:
   // Constructor
-  Break(const location &_loc) : Expr(_loc) {}
+  Break(const SourceLoc &_loc) : Expr(k_break, _loc) {}
 
   // Setter and getters for field `loop'
   void set_loop(Loop *_loop) {
@@ -680,20 +776,21 @@ class Assign : public Expr {
 
 public:
   // Constructor
-  Assign(const location &_loc, Identifier *_lhs, Expr *_rhs)
-      : Expr(_loc), lhs(_lhs), rhs(_rhs) {}
+  Assign(const SourceLoc &_loc, Identifier *_lhs, Expr *_rhs)
+      : Expr(k_assign, _loc), lhs(_lhs), rhs(_rhs) {}
 
   // Destructor
   virtual ~Assign() {
-    delete rhs;
-    delete lhs;
+    dispose(rhs);
+    dispose(lhs);
   }
 
   // Getters for field `lhs'
   Identifier &get_lhs() { return *lhs; }
   const Identifier &get_lhs() const { return *lhs; }
 
-  // Getters for field `rhs'
+  // Setter and getters for field `rhs'
+  void set_rhs(Expr *_rhs) { rhs = _rhs; }
   Expr &get_rhs() { return *rhs; }
   const Expr &get_rhs() const { return *rhs; }
 
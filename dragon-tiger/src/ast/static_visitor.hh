@@ -0,0 +1,54 @@
+#ifndef STATIC_VISITOR_HH
+#define STATIC_VISITOR_HH
+
+#include "nodes.hh"
+
+namespace ast {
+
+// A visitor dispatching on the kind of nodes instead of going through
+// accept() and a virtual visit(). Derived classes inherit from
+// StaticVisitor<Derived, R> and define visit() for every concrete class of
+// node, taking a const or non-const reference depending on the nodes they
+// are dispatched on, and returning R. dispatch(node) then calls the right
+// one; those calls are direct and can be inlined.
+template <typename Derived, typename R = void> class StaticVisitor {
+  // T, with the same constness as N.
+  template <typename N, typename T> struct like { typedef T type; };
+  template <typename N, typename T> struct like<const N, T> {
+    typedef const T type;
+  };
+
+  template <typename N> R dispatch_node(N &node) {
+    Derived &derived = static_cast<Derived &>(*this);
+#define DISPATCH(KIND, CLASS)                                                  \
+  case KIND:                                                                   \
+    return derived.visit(static_cast<typename like<N, CLASS>::type &>(node))
+    switch (node.kind) {
+      DISPATCH(k_integer_literal, IntegerLiteral);
+      DISPATCH(k_string_literal, StringLiteral);
+      DISPATCH(k_binary_operator, BinaryOperator);
+      DISPATCH(k_sequence, Sequence);
+      DISPATCH(k_let, Let);
+      DISPATCH(k_identifier, Identifier);
+      DISPATCH(k_if_then_else, IfThenElse);
+      DISPATCH(k_var_decl, VarDecl);
+      DISPATCH(k_fun_decl, FunDecl);
+      DISPATCH(k_fun_call, FunCall);
+      DISPATCH(k_while_loop, WhileLoop);
+      DISPATCH(k_for_loop, ForLoop);
+      DISPATCH(k_break, Break);
+    default:
+      assert(node.kind == k_assign);
+      return derived.visit(static_cast<typename like<N, Assign>::type &>(node));
+    }
+#undef DISPATCH
+  }
+
+public:
+  R dispatch(Node &node) { return dispatch_node(node); }
+  R dispatch(const Node &node) { return dispatch_node(node); }
+};
+
+} // namespace ast
+
+#endif // STATIC_VISITOR_HH
@@ -0,0 +1,131 @@
+#ifndef TRAVERSAL_HH
+#define TRAVERSAL_HH
+
+#include <vector>
+
+#include "nodes.hh"
+#include "static_visitor.hh"
+
+namespace ast {
+
+namespace detail {
+
+template <typename F>
+class ChildrenVisitor : public StaticVisitor<ChildrenVisitor<F>> {
+  F &f;
+
+public:
+  explicit ChildrenVisitor(F &_f) : f(_f) {}
+
+  void visit(const IntegerLiteral &) {}
+  void visit(const StringLiteral &) {}
+  void visit(const BinaryOperator &node) {
+    f(node.get_left());
+    f(node.get_right());
+  }
+  void visit(const Sequence &node) {
+    for (auto expr : node.get_exprs())
+      f(*expr);
+  }
+  void visit(const Let &node) {
+    for (auto decl : node.get_decls())
+      f(*decl);
+    f(node.get_sequence());
+  }
+  void visit(const Identifier &) {}
+  void visit(const IfThenElse &node) {
+    f(node.get_condition());
+    f(node.get_then_part());
+    f(node.get_else_part());
+  }
+  void visit(const VarDecl &node) {
+    if (auto expr = node.get_expr())
+      f(*expr);
+  }
+  void visit(const FunDecl &node) {
+    for (auto param : node.get_params())
+      f(*param);
+    if (auto expr = node.get_expr())
+      f(*expr);
+  }
+  void visit(const FunCall &node) {
+    for (auto arg : node.get_args())
+      f(*arg);
+  }
+  void visit(const WhileLoop &node) {
+    f(node.get_condition());
+    f(node.get_body());
+  }
+  void visit(const ForLoop &node) {
+    f(node.get_variable());
+    f(node.get_high());
+    f(node.get_body());
+  }
+  void visit(const Break &) {}
+  void visit(const Assign &node) {
+    f(node.get_lhs());
+    f(node.get_rhs());
+  }
+};
+
+} // namespace detail
+
+// Call f(child) on each child of node, in source order.
+template <typename F> void for_each_child(const Node &node, F f) {
+  detail::ChildrenVisitor<F>(f).dispatch(node);
+}
+
+// Walk the tree rooted at root depth first, calling pre(node) before the
+// children of node are walked and post(node) after. The walk uses an
+// explicit stack rather than recursion, so that its native stack usage
+// does not depend on the depth of the tree.
+template <typename Pre, typename Post>
+void walk(const Node &root, Pre pre, Post post) {
+  struct Entry {
+    const Node *node;
+    bool children_done;
+  };
+  std::vector<Entry> stack(1, Entry{&root, false});
+  std::vector<const Node *> children;
+  while (!stack.empty()) {
+    const Entry entry = stack.back();
+    stack.pop_back();
+    if (entry.children_done) {
+      post(*entry.node);
+      continue;
+    }
+    pre(*entry.node);
+    stack.push_back(Entry{entry.node, true});
+    children.clear();
+    for_each_child(*entry.node,
+                   [&](const Node &child) { children.push_back(&child); });
+    for (auto child = children.rbegin(); child != children.rend(); child++)
+      stack.push_back(Entry{*child, false});
+  }
+}
+
+// The same walk, giving pre and post non-const nodes. They may annotate
+// nodes, but not change the structure of the tree.
+template <typename Pre, typename Post>
+void walk(Node &root, Pre pre, Post post) {
+  walk(static_cast<const Node &>(root),
+       [&](const Node &node) { pre(const_cast<Node &>(node)); },
+       [&](const Node &node) { post(const_cast<Node &>(node)); });
+}
+
+// The number of nodes of the tree rooted at root.
+inline size_t count_nodes(const Node &root) {
+  size_t n = 0;
+  walk(root, [&](const Node &) { n++; }, [](const Node &) {});
+  return n;
+}
+
+// Whether e is the integer literal value.
+inline bool is_literal(const Expr &e, int32_t value) {
+  return e.kind == k_integer_literal &&
+         static_cast<const IntegerLiteral &>(e).value == value;
+}
+
+} // namespace ast
+
+#endif // TRAVERSAL_HH
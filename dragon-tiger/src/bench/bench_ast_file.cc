@@ -0,0 +1,83 @@
+// Compare loading a binary AST file (--load-ast) with parsing the source
+// it was saved from. Loading is measured in two steps: mapping the file
+// and interning its symbols, which is enough to use its records in
+// place, then building the tree from them.
+//
+// usage: bench_ast_file [file.tig [rounds]]
+// Without a file, a synthetic program is used.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+#include "../ast/ast_file.hh"
+#include "../parser/parser_driver.hh"
+#include "synthetic.hh"
+#include "timing.hh"
+
+int main(int argc, char **argv) {
+  const std::string file = argc > 1 ? argv[1] : "";
+  const unsigned rounds = argc > 2 ? atoi(argv[2]) : 5;
+
+  std::string source;
+  if (file.empty())
+    source = synthetic_program(20000);
+  else {
+    std::ifstream in(file);
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    source = contents.str();
+  }
+  const std::string name = file.empty() ? "synthetic" : file;
+  const std::string ast_file =
+      "/tmp/bench_ast_file." + std::to_string(getpid());
+
+  double parse_time = 1e9, map_time = 1e9, tree_time = 1e9;
+  size_t nodes = 0;
+  for (unsigned r = 0; r < rounds; r++) {
+    {
+      utils::Arena arena;
+      utils::Arena::Scope arena_scope(&arena);
+      const double start = now();
+      ParserDriver driver(false, false);
+      if (!driver.parse(name, source.data(), source.size())) {
+        std::cerr << "parser failed" << std::endl;
+        return EXIT_FAILURE;
+      }
+      parse_time = std::min(parse_time, now() - start);
+      if (r == 0) {
+        const ast::FlatAST flat = ast::flatten(*driver.result_ast);
+        nodes = flat.node_count();
+        ast::write_ast_file(ast_file, flat);
+      }
+    }
+    {
+      utils::Arena arena;
+      utils::Arena::Scope arena_scope(&arena);
+      double start = now();
+      ast::ASTFile loaded(ast_file);
+      map_time = std::min(map_time, now() - start);
+      start = now();
+      loaded.to_tree();
+      tree_time = std::min(tree_time, now() - start);
+    }
+  }
+
+  std::ifstream saved(ast_file, std::ios::binary | std::ios::ate);
+  std::cout << "source: " << source.size() << " bytes, " << nodes
+            << " nodes, AST file: " << saved.tellg() << " bytes" << std::endl;
+  std::cout << "parse: " << parse_time * 1e3 << " ms" << std::endl;
+  std::cout << "load (map and symbols): " << map_time * 1e3 << " ms"
+            << std::endl;
+  std::cout << "load (tree): " << tree_time * 1e3 << " ms" << std::endl;
+  std::cout << "speedup: " << parse_time / (map_time + tree_time)
+            << " (to tree), " << parse_time / map_time << " (in place)"
+            << std::endl;
+  remove(ast_file.c_str());
+  return 0;
+}
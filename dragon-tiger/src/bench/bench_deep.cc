@@ -0,0 +1,128 @@
+// Parse, walk, dump, bind and delete machine-generated programs nested to a
+// given depth, and report the time and memory each step takes. None of
+// these steps recurses on the native stack, so depths of millions must
+// work. Only shapes whose dump does not get indented at each level are
+// dumped, as the size of the others grows with the square of the depth.
+//
+// usage: bench_deep [depth [shape...]]
+// where shapes are plus, minus, parens, if and let (all by default).
+
+#include <cstdlib>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+#include "../ast/ast_dumper.hh"
+#include "../ast/traversal.hh"
+#include "../binder/binder.hh"
+#include "../parser/parser_driver.hh"
+#include "timing.hh"
+
+namespace {
+
+// Peak resident set size of the process, in MB.
+double peak_rss() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;
+}
+
+// Counts the characters written and discards them.
+class CountingBuffer : public std::streambuf {
+public:
+  size_t count = 0;
+
+protected:
+  virtual int overflow(int c) {
+    count++;
+    return c;
+  }
+  virtual std::streamsize xsputn(const char *, std::streamsize n) {
+    count += n;
+    return n;
+  }
+};
+
+std::string repeat(const std::string &s, size_t n) {
+  std::string result;
+  result.reserve(s.size() * n);
+  for (size_t i = 0; i < n; i++)
+    result += s;
+  return result;
+}
+
+// A program of the given shape whose AST is about depth nodes deep.
+std::string generate(const std::string &shape, size_t depth) {
+  if (shape == "plus") // Left-nested binary operators.
+    return "1" + repeat("+1", depth);
+  if (shape == "minus") // Right-nested unary minus.
+    return repeat("-", depth) + "1";
+  if (shape == "parens")
+    return repeat("(", depth) + "1" + repeat(")", depth);
+  if (shape == "if")
+    return repeat("if 1 then ", depth) + "1" + repeat(" else 0", depth);
+  if (shape == "let") // Each variable hides the previous one.
+    return repeat("let var x := 1 in ", depth) + "x" + repeat(" end", depth);
+  std::cerr << "unknown shape " << shape << std::endl;
+  exit(EXIT_FAILURE);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t depth = argc > 1 ? atol(argv[1]) : 1000000;
+  std::vector<std::string> shapes;
+  for (int i = 2; i < argc; i++)
+    shapes.push_back(argv[i]);
+  if (shapes.empty())
+    shapes = {"plus", "minus", "parens", "if", "let"};
+
+  std::cout << "shape   parse (s)  walk (s)  dump (s)  bind (s)  delete (s)  "
+               "peak RSS (MB)"
+            << std::endl;
+  for (auto &shape : shapes) {
+    const std::string text = generate(shape, depth);
+
+    // Nodes are allocated on the heap so that deleting them is measured.
+    double start = now();
+    ParserDriver driver(false, false);
+    if (!driver.parse(shape, text.data(), text.size())) {
+      std::cerr << shape << ": parser failed" << std::endl;
+      return EXIT_FAILURE;
+    }
+    const double parse_time = now() - start;
+
+    start = now();
+    size_t nodes = 0;
+    ast::walk(*driver.result_ast, [&](const ast::Node &) { nodes++; },
+              [](const ast::Node &) {});
+    const double walk_time = now() - start;
+
+    std::string dump_time = "-";
+    if (shape == "plus" || shape == "minus") {
+      start = now();
+      CountingBuffer buffer;
+      std::ostream out(&buffer);
+      ast::ASTDumper dumper(&out, false);
+      dumper.dump(*driver.result_ast);
+      dump_time = std::to_string(now() - start);
+    }
+
+    // The main function returned by the binder owns the program.
+    start = now();
+    ast::binder::Binder binder;
+    ast::FunDecl *main = binder.analyze_program(*driver.result_ast);
+    const double bind_time = now() - start;
+
+    start = now();
+    delete main;
+    const double delete_time = now() - start;
+
+    std::cout << shape << "  " << parse_time << "  " << walk_time << "  "
+              << dump_time << "  " << bind_time << "  " << delete_time << "  " << peak_rss()
+              << " (" << nodes << " nodes)" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,265 @@
+// Measure the throughput of --dump-ast: ASTDumper, which writes through its
+// own buffer, is compared with a dumper written the way ASTDumper used to
+// be (std::endl at the end of each line, copies of child vectors, one
+// stream operation per item). Both must produce the same text.
+//
+// usage: bench_dump [file.tig [rounds [output]]]
+// Without a file, a synthetic program is used. Output goes to /dev/null
+// by default.
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "../ast/ast_dumper.hh"
+#include "../parser/parser_driver.hh"
+#include "synthetic.hh"
+#include "timing.hh"
+
+using namespace ast;
+
+namespace {
+
+class StreamDumper : public ConstASTVisitor {
+  std::ostream *ostream;
+  unsigned indent_level = 0;
+  void inc() { indent_level++; }
+  void inl() {
+    inc();
+    nl();
+  }
+  void dec() { indent_level--; }
+  void dnl() {
+    dec();
+    nl();
+  }
+
+  void exprs(const NodeVector<Expr *> list) {
+    for (auto expr = list.cbegin(); expr != list.cend(); expr++) {
+      if (expr != list.cbegin())
+        *ostream << ';';
+      nl();
+      (*expr)->accept(*this);
+    }
+  }
+
+public:
+  explicit StreamDumper(std::ostream *_ostream) : ostream(_ostream) {}
+  void nl() {
+    *ostream << std::endl;
+    for (unsigned i = 0; i < indent_level; i++)
+      *ostream << "  ";
+  }
+  virtual void visit(const IntegerLiteral &literal) {
+    *ostream << literal.value;
+  }
+  virtual void visit(const StringLiteral &literal) {
+    *ostream << '"';
+    for (auto &c : literal.value.get()) {
+      switch (c) {
+      case '"':
+        *ostream << "\\\"";
+        break;
+      case '\\':
+        *ostream << "\\\\";
+        break;
+      case '\a':
+        *ostream << "\\a";
+        break;
+      case '\b':
+        *ostream << "\\b";
+        break;
+      case '\t':
+        *ostream << "\\t";
+        break;
+      case '\n':
+        *ostream << "\\n";
+        break;
+      case '\v':
+        *ostream << "\\v";
+        break;
+      case '\f':
+        *ostream << "\\f";
+        break;
+      case '\r':
+        *ostream << "\\r";
+        break;
+      default:
+        *ostream << c;
+      }
+    }
+    *ostream << '"';
+  }
+  virtual void visit(const BinaryOperator &binop) {
+    *ostream << '(';
+    binop.get_left().accept(*this);
+    *ostream << operator_name[binop.op];
+    binop.get_right().accept(*this);
+    *ostream << ')';
+  }
+  virtual void visit(const Sequence &seqExpr) {
+    *ostream << "(";
+    inc();
+    exprs(seqExpr.get_exprs());
+    dnl();
+    *ostream << ")";
+  }
+  virtual void visit(const Let &let) {
+    *ostream << "let";
+    inc();
+    for (auto decl : let.get_decls()) {
+      nl();
+      decl->accept(*this);
+    }
+    dnl();
+    *ostream << "in";
+    inc();
+    exprs(let.get_sequence().get_exprs());
+    dnl();
+    *ostream << "end";
+  }
+  virtual void visit(const Identifier &id) { *ostream << id.name; }
+  virtual void visit(const IfThenElse &ite) {
+    *ostream << "if ";
+    inl();
+    ite.get_condition().accept(*this);
+    dnl();
+    *ostream << " then ";
+    inl();
+    ite.get_then_part().accept(*this);
+    dnl();
+    *ostream << " else ";
+    inl();
+    ite.get_else_part().accept(*this);
+    dec();
+  }
+  virtual void visit(const VarDecl &decl) {
+    if (decl.get_expr())
+      *ostream << "var ";
+    *ostream << decl.name;
+    if (decl.type_name)
+      *ostream << ": " << *decl.type_name;
+    if (auto expr = decl.get_expr()) {
+      *ostream << " := ";
+      expr->accept(*this);
+    }
+  }
+  virtual void visit(const FunDecl &decl) {
+    *ostream << "function " << decl.name << '(';
+    auto params = decl.get_params();
+    for (auto param = params.cbegin(); param != params.cend(); param++) {
+      if (param != params.cbegin())
+        *ostream << ", ";
+      (*param)->accept(*this);
+    }
+    *ostream << ")";
+    if (decl.type_name)
+      *ostream << ": " << decl.type_name.get();
+    *ostream << " = ";
+    inl();
+    decl.get_expr()->accept(*this);
+    dec();
+  }
+  virtual void visit(const FunCall &call) {
+    *ostream << call.func_name << "(";
+    auto args = call.get_args();
+    for (auto arg = args.cbegin(); arg != args.cend(); arg++) {
+      if (arg != args.cbegin())
+        *ostream << ", ";
+      (*arg)->accept(*this);
+    }
+    *ostream << ')';
+  }
+  virtual void visit(const WhileLoop &loop) {
+    *ostream << "while ";
+    loop.get_condition().accept(*this);
+    *ostream << " do";
+    inl();
+    loop.get_body().accept(*this);
+    dec();
+  }
+  virtual void visit(const ForLoop &loop) {
+    *ostream << "for " << loop.get_variable().name << " := ";
+    loop.get_variable().get_expr()->accept(*this);
+    *ostream << " to ";
+    loop.get_high().accept(*this);
+    *ostream << " do";
+    inl();
+    loop.get_body().accept(*this);
+    dec();
+  }
+  virtual void visit(const Break &) { *ostream << "break"; }
+  virtual void visit(const Assign &assign) {
+    assign.get_lhs().accept(*this);
+    *ostream << " := ";
+    assign.get_rhs().accept(*this);
+  }
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const std::string file = argc > 1 ? argv[1] : "";
+  const unsigned rounds = argc > 2 ? atoi(argv[2]) : 5;
+  const std::string output = argc > 3 ? argv[3] : "/dev/null";
+
+  ParserDriver driver(false, false);
+  bool parsed;
+  if (file.empty()) {
+    const std::string program = synthetic_program(20000);
+    parsed = driver.parse("synthetic", program.data(), program.size());
+  } else
+    parsed = driver.parse(file);
+  if (!parsed) {
+    std::cerr << "parser failed" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const Expr &root = *driver.result_ast;
+
+  // Check that both dumpers agree.
+  std::ostringstream expected, actual;
+  {
+    StreamDumper dumper(&expected);
+    root.accept(dumper);
+    dumper.nl();
+  }
+  {
+    ASTDumper dumper(&actual, false);
+    dumper.dump(root);
+    dumper.nl();
+    dumper.flush();
+  }
+  if (expected.str() != actual.str()) {
+    std::cerr << "outputs differ" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const double megabytes = actual.str().size() / 1e6;
+
+  std::ofstream out(output);
+  double stream_time = 1e9, buffered_time = 1e9;
+  for (unsigned r = 0; r < rounds; r++) {
+    double start = now();
+    StreamDumper stream_dumper(&out);
+    root.accept(stream_dumper);
+    stream_dumper.nl();
+    stream_time = std::min(stream_time, now() - start);
+
+    start = now();
+    ASTDumper dumper(&out, false);
+    dumper.dump(root);
+    dumper.nl();
+    dumper.flush();
+    out.flush();
+    buffered_time = std::min(buffered_time, now() - start);
+  }
+
+  std::cout << "output: " << megabytes << " MB" << std::endl;
+  std::cout << "stream dumper: " << megabytes / stream_time << " MB/s"
+            << std::endl;
+  std::cout << "buffered dumper: " << megabytes / buffered_time << " MB/s"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,153 @@
+// Check the C backend against the evaluator: each program is translated to
+// C, built with the C compiler at -O2 and run, and its output and exit
+// status must be those of the evaluator. The time of each run is reported.
+//
+// usage: bench_emit_c [file.tig...]
+//
+// Without files, the programs of bench_eval are used. The C compiler is
+// $CC, or cc.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../binder/binder.hh"
+#include "../cgen/c_emitter.hh"
+#include "../eval/evaluator.hh"
+#include "../optimizer/tail_calls.hh"
+#include "../parser/parser_driver.hh"
+#include "../type_checker/type_checker.hh"
+#include "../utils/errors.hh"
+#include "programs.hh"
+#include "timing.hh"
+
+namespace {
+
+// What a run of a program writes to its standard output, and its status.
+struct Outcome {
+  std::string output;
+  int status;
+  double time;
+};
+
+Outcome evaluate(const ast::FunDecl &main) {
+  std::ostringstream out, diagnostics;
+  utils::DiagnosticScope diagnostic_scope(diagnostics);
+  Outcome outcome{"", 0, 0};
+  const double start = now();
+  try {
+    ast::eval::Evaluator evaluator(out);
+    const int32_t result = evaluator.run(main);
+    if (evaluator.has_exited())
+      outcome.status = result & 0xff;
+    else
+      out << result << std::endl;
+  } catch (utils::FatalError &) {
+    outcome.status = EXIT_FAILURE;
+  }
+  outcome.time = now() - start;
+  outcome.output = out.str();
+  return outcome;
+}
+
+// Build the C program in directory, then run it.
+bool build_and_run(const std::string &directory, const std::string &c,
+                   Outcome &outcome) {
+  const std::string source = directory + "/program.c";
+  const std::string binary = directory + "/program";
+  std::ofstream(source) << c;
+  const char *cc = getenv("CC");
+  const std::string command = std::string(cc ? cc : "cc") + " -O2 -o " +
+                              binary + " " + source;
+  if (system(command.c_str())) {
+    std::cerr << "cannot build " << source << std::endl;
+    return false;
+  }
+
+  const double start = now();
+  FILE *pipe = popen(binary.c_str(), "r");
+  if (!pipe)
+    return false;
+  outcome.output.clear();
+  char buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof buffer, pipe)) > 0)
+    outcome.output.append(buffer, n);
+  const int status = pclose(pipe);
+  outcome.time = now() - start;
+  outcome.status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  return true;
+}
+
+// Compare the C translation of the program with the evaluator.
+bool check(const std::string &name, const std::string &text,
+           const std::string &directory) {
+  utils::Arena arena;
+  utils::Arena::Scope arena_scope(&arena);
+  ParserDriver driver(false, false);
+  if (!driver.parse(name, text.data(), text.size())) {
+    std::cerr << name << ": parser failed" << std::endl;
+    return false;
+  }
+  ast::binder::Binder binder;
+  ast::FunDecl *main = binder.analyze_program(*driver.result_ast);
+  if (!ast::type_checker::check_types(*main).empty()) {
+    std::cerr << name << ": type checking failed" << std::endl;
+    return false;
+  }
+  ast::optimizer::eliminate_tail_calls(*main);
+
+  const Outcome reference = evaluate(*main);
+  std::ostringstream c;
+  cgen::emit_c(*main, c);
+  Outcome compiled;
+  if (!build_and_run(directory, c.str(), compiled))
+    return false;
+
+  if (compiled.output != reference.output ||
+      compiled.status != reference.status) {
+    std::cout << name << ": differs from the evaluator (status "
+              << compiled.status << ", expected " << reference.status << ")"
+              << std::endl;
+    return false;
+  }
+  std::cout << name << ": ok, evaluator " << reference.time * 1e3
+            << " ms, C " << compiled.time * 1e3 << " ms" << std::endl;
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  char directory[] = "/tmp/bench_emit_c.XXXXXX";
+  if (!mkdtemp(directory)) {
+    std::cerr << "cannot create a temporary directory" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  unsigned failures = 0;
+  if (argc > 1)
+    for (int i = 1; i < argc; i++) {
+      std::ifstream file(argv[i]);
+      const std::string text((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+      failures += !check(argv[i], text, directory);
+    }
+  else
+    for (auto &program : programs)
+      failures += !check(program.name, program.text, directory);
+
+  const std::string d = directory;
+  unlink((d + "/program.c").c_str());
+  unlink((d + "/program").c_str());
+  rmdir(directory);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+// Compare the engines running Tiger programs: the evaluator, which walks
+// the tree, the bytecode machine and, on x86-64, the JIT. Most programs are
+// recursive, and spend their time in calls and in accesses to parameters.
+//
+// usage: bench_eval [rounds]
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "../binder/binder.hh"
+#include "../bytecode/compiler.hh"
+#include "../bytecode/vm.hh"
+#include "../eval/evaluator.hh"
+#include "../jit/jit.hh"
+#include "../optimizer/tail_calls.hh"
+#include "../parser/parser_driver.hh"
+#include "../type_checker/type_checker.hh"
+#include "programs.hh"
+#include "timing.hh"
+
+namespace {
+
+// Best time of the given number of runs of engine, which must return
+// expected.
+template <typename Engine>
+double best_time(const Program &program, unsigned rounds, Engine engine) {
+  double best = 1e9;
+  for (unsigned r = 0; r < rounds; r++) {
+    std::ostringstream out;
+    const double start = now();
+    const int32_t result = engine(out);
+    best = std::min(best, now() - start);
+    if (result != program.expected) {
+      std::cerr << program.name << ": got " << result << ", expected "
+                << program.expected << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const unsigned rounds = argc > 1 ? atoi(argv[1]) : 5;
+
+  for (auto &program : programs) {
+    utils::Arena arena;
+    utils::Arena::Scope arena_scope(&arena);
+    const std::string text = program.text;
+    ParserDriver driver(false, false);
+    if (!driver.parse(program.name, text.data(), text.size())) {
+      std::cerr << program.name << ": parser failed" << std::endl;
+      return EXIT_FAILURE;
+    }
+    ast::binder::Binder binder;
+    ast::FunDecl *main = binder.analyze_program(*driver.result_ast);
+    if (!ast::type_checker::check_types(*main).empty()) {
+      std::cerr << program.name << ": type checking failed" << std::endl;
+      return EXIT_FAILURE;
+    }
+    ast::optimizer::eliminate_tail_calls(*main);
+
+    const double eval_time =
+        best_time(program, rounds, [&](std::ostream &out) {
+          ast::eval::Evaluator evaluator(out);
+          return evaluator.run(*main);
+        });
+    const bytecode::Program code = bytecode::compile(*main);
+    const double vm_time =
+        best_time(program, rounds, [&](std::ostream &out) {
+          bytecode::VM machine(code, out);
+          return machine.run();
+        });
+    std::cout << program.name << ": evaluator " << eval_time * 1e3
+              << " ms, bytecode " << vm_time * 1e3 << " ms (x"
+              << eval_time / vm_time << ")";
+    if (jit::JIT::supported()) {
+      std::ostringstream out;
+      jit::JIT compiled(*main, out);
+      const double jit_time = best_time(
+          program, rounds, [&](std::ostream &) { return compiled.run(); });
+      std::cout << ", jit " << jit_time * 1e3 << " ms (x"
+                << eval_time / jit_time << ")";
+    }
+    std::cout << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,68 @@
+// Measure symbol interning throughput when N threads intern the same set
+// of strings concurrently, as parsers running in batch mode do.
+//
+// usage: bench_symbols [words [rounds [max-threads]]]
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../utils/symbols.hh"
+#include "timing.hh"
+
+using utils::Symbol;
+
+int main(int argc, char **argv) {
+  const size_t words = argc > 1 ? atol(argv[1]) : 100000;
+  const unsigned rounds = argc > 2 ? atoi(argv[2]) : 10;
+  const unsigned max_threads = argc > 3 ? atoi(argv[3]) : 8;
+
+  std::vector<std::string> names;
+  for (size_t i = 0; i < words; i++)
+    names.push_back("identifier_" + std::to_string(i * 2654435761u % words));
+
+  std::cout << "threads  interns/s (total)  interns/s (per thread)" << std::endl;
+  for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+    std::vector<std::thread> pool;
+    std::vector<size_t> sinks(threads);
+    const double start = now();
+    for (unsigned t = 0; t < threads; t++)
+      pool.emplace_back([&, t]() {
+        // Each thread walks the names from a different starting point.
+        for (unsigned r = 0; r < rounds; r++)
+          for (size_t i = 0; i < words; i++)
+            sinks[t] += Symbol(names[(i + t * words / threads) % words]).hash();
+      });
+    for (auto &thread : pool)
+      thread.join();
+    const double elapsed = now() - start;
+    const double total = double(words) * rounds * threads / elapsed;
+    std::cout << threads << "        " << total << "        "
+              << total / threads << std::endl;
+  }
+
+  const utils::SymbolStats stats = utils::symbol_stats();
+  std::cout << "table: " << stats.symbols << " symbols, " << stats.string_bytes
+            << " bytes of characters, " << stats.total_bytes << " bytes used"
+            << std::endl;
+
+  // Hashing an interned symbol no longer looks at its characters.
+  std::vector<Symbol> symbols(names.begin(), names.end());
+  size_t sink = 0;
+  double start = now();
+  for (unsigned r = 0; r < rounds; r++)
+    for (auto &s : symbols)
+      sink += std::hash<Symbol>()(s);
+  const double symbol_hash = now() - start;
+  start = now();
+  for (unsigned r = 0; r < rounds; r++)
+    for (auto &s : names)
+      sink += std::hash<std::string>()(s);
+  const double string_hash = now() - start;
+  std::cout << "hash: symbol " << symbol_hash * 1e9 / (words * rounds)
+            << " ns, string " << string_hash * 1e9 / (words * rounds)
+            << " ns (" << (sink & 1) << ")" << std::endl;
+  return 0;
+}
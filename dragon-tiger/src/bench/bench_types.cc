@@ -0,0 +1,53 @@
+// Measure the throughput of the type checker, in nodes per second, on
+// synthetic programs of growing size. Each program is parsed and bound
+// once per round, as types can only be set once.
+//
+// usage: bench_types [functions [rounds]]
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "../ast/traversal.hh"
+#include "../binder/binder.hh"
+#include "../parser/parser_driver.hh"
+#include "../type_checker/type_checker.hh"
+#include "synthetic.hh"
+#include "timing.hh"
+
+int main(int argc, char **argv) {
+  const unsigned max_functions = argc > 1 ? atoi(argv[1]) : 100000;
+  const unsigned rounds = argc > 2 ? atoi(argv[2]) : 3;
+
+  std::cout << "functions  nodes  best time (ms)  Mnodes/s" << std::endl;
+  for (unsigned functions = 100; functions <= max_functions;
+       functions *= 10) {
+    const std::string text = synthetic_program(functions);
+    double best = 1e9;
+    size_t nodes = 0;
+    for (unsigned round = 0; round < rounds; round++) {
+      utils::Arena arena;
+      utils::Arena::Scope arena_scope(&arena);
+      ParserDriver driver(false, false);
+      if (!driver.parse("synthetic", text.data(), text.size())) {
+        std::cerr << "parser failed" << std::endl;
+        return EXIT_FAILURE;
+      }
+      ast::binder::Binder binder;
+      ast::FunDecl *main = binder.analyze_program(*driver.result_ast);
+      nodes = ast::count_nodes(*main);
+
+      const double start = now();
+      const bool ok = ast::type_checker::check_types(*main).empty();
+      best = std::min(best, now() - start);
+      if (!ok) {
+        std::cerr << "type checking failed" << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    std::cout << functions << "  " << nodes << "  " << best * 1e3 << "  "
+              << nodes / best / 1e6 << std::endl;
+  }
+  return 0;
+}
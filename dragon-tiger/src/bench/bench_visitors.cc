@@ -0,0 +1,131 @@
+// Compare the cost of walking an AST through the virtual visitors of
+// nodes.hh (accept() then visit()) and through StaticVisitor, which
+// dispatches on the node kind with direct calls.
+//
+// usage: bench_visitors [statements [rounds]]
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "../ast/nodes.hh"
+#include "../ast/static_visitor.hh"
+#include "timing.hh"
+
+using namespace ast;
+
+namespace {
+
+// A balanced tree of arithmetic operations with 2^depth leaves, which
+// are integer literals and identifiers.
+Expr *make_tree(unsigned depth, unsigned &seed) {
+  seed = seed * 1103515245 + 12345;
+  if (depth == 0) {
+    if (seed & 0x100)
+      return new Identifier(SourceLoc(), Symbol("x"));
+    return new IntegerLiteral(SourceLoc(), seed >> 16 & 0xff);
+  }
+  const Operator op = (seed >> 16) & 1 ? o_plus : o_times;
+  Expr *left = make_tree(depth - 1, seed);
+  Expr *right = make_tree(depth - 1, seed);
+  return new BinaryOperator(SourceLoc(), left, right, op);
+}
+
+// Folds the arithmetic expressions, identifiers counting as 1.
+class VirtualEval : public ConstASTIntVisitor {
+public:
+  virtual int32_t visit(const IntegerLiteral &node) { return node.value; }
+  virtual int32_t visit(const StringLiteral &) { return 0; }
+  virtual int32_t visit(const BinaryOperator &node) {
+    const int32_t left = node.get_left().accept(*this);
+    const int32_t right = node.get_right().accept(*this);
+    return node.op == o_plus ? left + right : left * right;
+  }
+  virtual int32_t visit(const Sequence &node) {
+    int32_t result = 0;
+    for (auto expr : node.get_exprs())
+      result ^= expr->accept(*this);
+    return result;
+  }
+  virtual int32_t visit(const Let &) { return 0; }
+  virtual int32_t visit(const Identifier &) { return 1; }
+  virtual int32_t visit(const IfThenElse &) { return 0; }
+  virtual int32_t visit(const VarDecl &) { return 0; }
+  virtual int32_t visit(const FunDecl &) { return 0; }
+  virtual int32_t visit(const FunCall &) { return 0; }
+  virtual int32_t visit(const WhileLoop &) { return 0; }
+  virtual int32_t visit(const ForLoop &) { return 0; }
+  virtual int32_t visit(const Break &) { return 0; }
+  virtual int32_t visit(const Assign &) { return 0; }
+};
+
+// The same computation with static dispatch.
+class StaticEval : public StaticVisitor<StaticEval, int32_t> {
+public:
+  int32_t visit(const IntegerLiteral &node) { return node.value; }
+  int32_t visit(const StringLiteral &) { return 0; }
+  int32_t visit(const BinaryOperator &node) {
+    const int32_t left = dispatch(node.get_left());
+    const int32_t right = dispatch(node.get_right());
+    return node.op == o_plus ? left + right : left * right;
+  }
+  int32_t visit(const Sequence &node) {
+    int32_t result = 0;
+    for (auto expr : node.get_exprs())
+      result ^= dispatch(*expr);
+    return result;
+  }
+  int32_t visit(const Let &) { return 0; }
+  int32_t visit(const Identifier &) { return 1; }
+  int32_t visit(const IfThenElse &) { return 0; }
+  int32_t visit(const VarDecl &) { return 0; }
+  int32_t visit(const FunDecl &) { return 0; }
+  int32_t visit(const FunCall &) { return 0; }
+  int32_t visit(const WhileLoop &) { return 0; }
+  int32_t visit(const ForLoop &) { return 0; }
+  int32_t visit(const Break &) { return 0; }
+  int32_t visit(const Assign &) { return 0; }
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const size_t statements = argc > 1 ? atol(argv[1]) : 1000;
+  const unsigned rounds = argc > 2 ? atoi(argv[2]) : 20;
+  const unsigned depth = 10;
+
+  utils::Arena arena;
+  utils::Arena::Scope arena_scope(&arena);
+  unsigned seed = 42;
+  std::vector<Expr *> exprs;
+  for (size_t i = 0; i < statements; i++)
+    exprs.push_back(make_tree(depth, seed));
+  Sequence root(SourceLoc(), exprs);
+  const double nodes = double(statements) * ((2u << depth) - 1) + 1;
+
+  // Keep the best of a few runs of each, alternating between the two.
+  VirtualEval virtual_eval;
+  StaticEval static_eval;
+  int32_t sink = 0;
+  double virtual_time = 1e9, static_time = 1e9;
+  for (unsigned run = 0; run < 3; run++) {
+    double start = now();
+    for (unsigned r = 0; r < rounds; r++)
+      sink += root.accept(virtual_eval);
+    virtual_time = std::min(virtual_time, now() - start);
+
+    start = now();
+    for (unsigned r = 0; r < rounds; r++)
+      sink -= static_eval.dispatch(root);
+    static_time = std::min(static_time, now() - start);
+  }
+
+  std::cout << "nodes: " << size_t(nodes) << std::endl;
+  std::cout << "virtual: " << virtual_time * 1e9 / (nodes * rounds)
+            << " ns/node" << std::endl;
+  std::cout << "static: " << static_time * 1e9 / (nodes * rounds)
+            << " ns/node" << std::endl;
+  // Both visitors compute the same value.
+  return sink != 0;
+}
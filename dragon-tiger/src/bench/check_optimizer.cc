@@ -0,0 +1,135 @@
+// Check that optimizing keeps the behaviour of Tiger programs: every program
+// of programs.hh runs at -O0 and -O2, in the evaluator and in the bytecode
+// machine, and must print the same output and return the same value, or fail
+// with the same error, in the four runs.
+//
+// usage: check_optimizer
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "../binder/binder.hh"
+#include "../bytecode/compiler.hh"
+#include "../bytecode/vm.hh"
+#include "../eval/evaluator.hh"
+#include "../optimizer/inliner.hh"
+#include "../optimizer/pipeline.hh"
+#include "../parser/parser_driver.hh"
+#include "../type_checker/type_checker.hh"
+#include "../utils/errors.hh"
+#include "programs.hh"
+
+namespace {
+
+// What running a program shows: its output and diagnostics, and its value
+// unless it stopped on an error.
+struct Outcome {
+  std::string output;
+  bool failed;
+  int32_t value;
+
+  bool operator==(const Outcome &other) const {
+    return output == other.output && failed == other.failed &&
+           (failed || value == other.value);
+  }
+  bool operator!=(const Outcome &other) const { return !(*this == other); }
+};
+
+std::ostream &operator<<(std::ostream &out, const Outcome &outcome) {
+  out << outcome.output << "\n";
+  if (outcome.failed)
+    return out << "(failed)";
+  return out << "(value " << outcome.value << ")";
+}
+
+template <typename Engine> Outcome run_engine(Engine engine) {
+  std::ostringstream out;
+  std::ostringstream diagnostics;
+  utils::DiagnosticScope scope(diagnostics);
+  Outcome outcome;
+  outcome.failed = false;
+  outcome.value = 0;
+  try {
+    outcome.value = engine(out);
+  } catch (utils::FatalError &) {
+    outcome.failed = true;
+  }
+  outcome.output = out.str() + diagnostics.str();
+  return outcome;
+}
+
+// Run program at the given optimization level in both engines, which must
+// agree, and store what it shows into outcome.
+bool run(const Program &program, int level, Outcome &outcome) {
+  utils::Arena arena;
+  utils::Arena::Scope arena_scope(&arena);
+  const std::string text = program.text;
+  ParserDriver driver(false, false);
+  if (!driver.parse(program.name, text.data(), text.size())) {
+    std::cerr << program.name << ": parser failed" << std::endl;
+    return false;
+  }
+  ast::binder::Binder binder;
+  ast::FunDecl *main = binder.analyze_program(*driver.result_ast);
+  if (!ast::type_checker::check_types(*main).empty()) {
+    std::cerr << program.name << ": type checking failed" << std::endl;
+    return false;
+  }
+  ast::optimizer::PipelineOptions options;
+  options.level = level;
+  options.run = true;
+  options.inline_limit = ast::optimizer::default_inline_limit;
+  ast::optimizer::optimize(*main, options, nullptr);
+
+  outcome = run_engine([&](std::ostream &out) {
+    ast::eval::Evaluator evaluator(out);
+    return evaluator.run(*main);
+  });
+  const bytecode::Program code = bytecode::compile(*main);
+  const Outcome interpreted = run_engine([&](std::ostream &out) {
+    bytecode::VM machine(code, out);
+    return machine.run();
+  });
+  if (outcome != interpreted) {
+    std::cerr << program.name << " at -O" << level << ": the evaluator gives\n"
+              << outcome << "\nbut the bytecode machine gives\n"
+              << interpreted << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool check(const Program &program) {
+  Outcome unoptimized, optimized;
+  if (!run(program, 0, unoptimized) || !run(program, 2, optimized))
+    return false;
+  if (unoptimized != optimized) {
+    std::cerr << program.name << ": -O0 gives\n"
+              << unoptimized << "\nbut -O2 gives\n"
+              << optimized << std::endl;
+    return false;
+  }
+  if (!unoptimized.failed && unoptimized.value != program.expected) {
+    std::cerr << program.name << ": got " << unoptimized.value
+              << ", expected " << program.expected << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  unsigned failures = 0;
+  for (auto &program : programs)
+    failures += !check(program);
+  for (auto &program : optimizer_programs)
+    failures += !check(program);
+  if (failures) {
+    std::cerr << failures << " programs changed behaviour" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return 0;
+}
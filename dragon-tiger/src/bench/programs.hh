@@ -0,0 +1,168 @@
+#ifndef PROGRAMS_HH
+#define PROGRAMS_HH
+
+#include <cstdint>
+
+// Tiger programs run by the benchmarks of the engines, with the value they
+// return.
+
+struct Program {
+  const char *name;
+  const char *text;
+  int32_t expected;
+};
+
+const Program programs[] = {
+    {"fib(27)",
+     "let function fib(n: int): int =\n"
+     "  if n < 2 then n else fib(n - 1) + fib(n - 2)\n"
+     "in fib(27) end",
+     196418},
+    {"ackermann(2, 1000)",
+     "let function ack(m: int, n: int): int =\n"
+     "  if m = 0 then n + 1\n"
+     "  else if n = 0 then ack(m - 1, 1)\n"
+     "  else ack(m - 1, ack(m, n - 1))\n"
+     "in ack(2, 1000) end",
+     2003},
+    {"ackermann(3, 6)",
+     "let function ack(m: int, n: int): int =\n"
+     "  if m = 0 then n + 1\n"
+     "  else if n = 0 then ack(m - 1, 1)\n"
+     "  else ack(m - 1, ack(m, n - 1))\n"
+     "in ack(3, 6) end",
+     509},
+    // Nested functions reaching the variables of their parents through
+    // static links.
+    {"nested sum",
+     "let function sum(n: int): int =\n"
+     "  let var total := 0\n"
+     "      function add(i: int) = total := total + i\n"
+     "      function loop(i: int) = if i <= n then (add(i); loop(i + 1))\n"
+     "  in loop(1); total end\n"
+     "in sum(20000) end",
+     200010000},
+    // Recursion 10^7 deep through tail calls, which run in constant stack.
+    {"tail calls",
+     "let function sum(n: int, acc: int): int =\n"
+     "  if n = 0 then acc else sum(n - 1, acc + n)\n"
+     "in sum(10000000, 0) end",
+     -2004260032},
+    {"mutual tail calls",
+     "let function even(n: int): int = if n = 0 then 1 else odd(n - 1)\n"
+     "    function odd(n: int): int = if n = 0 then 0 else even(n - 1)\n"
+     "in even(10000000) end",
+     1},
+    {"nested loops",
+     "let var total := 0 in\n"
+     "  for i := 1 to 1000 do\n"
+     "    for j := 1 to 1000 do\n"
+     "      if ((i < j) & ((j - i) < 10)) | (i = j) then\n"
+     "        total := total + i * j;\n"
+     "  total\n"
+     "end",
+     -979154466},
+    {"while",
+     "let var n := 0 var steps := 0 in\n"
+     "  for i := 1 to 30000 do (\n"
+     "    n := i;\n"
+     "    while n <> 1 do (\n"
+     "      steps := steps + 1;\n"
+     "      if (n - n / 2 * 2) = 0 then n := n / 2 else n := 3 * n + 1));\n"
+     "  steps\n"
+     "end",
+     2864311},
+    // Strings built at runtime, and output.
+    {"strings",
+     "let var s := \"\" in\n"
+     "  for i := 1 to 200 do (\n"
+     "    s := concat(s, chr(ord(\"a\") + i - i / 26 * 26));\n"
+     "    if (i - i / 50 * 50) = 0 then (print(s); print(\"\\n\")));\n"
+     "  size(s)\n"
+     "end",
+     200},
+};
+
+// Programs exercising the optimizer. check_optimizer runs them, with those
+// above, at -O0 and -O2 and compares their output. A program failing at
+// runtime must fail at both levels, and its expected value is unused.
+const Program optimizer_programs[] = {
+    // Loops with literal bounds, unrolled at -O2.
+    {"unrolled loops",
+     "let var t := 0 in\n"
+     "  for i := 1 to 4 do\n"
+     "    for j := 0 to 2 do\n"
+     "      t := t * 3 + i - j;\n"
+     "  for k := 5 to 4 do t := 0;\n"
+     "  t\n"
+     "end",
+     173738},
+    // Products of loop variables, reduced to sums, and an invariant product
+    // hoisted out of the loop.
+    {"strength reduction",
+     "let var t := 0 var k := 7 var n := 100 in\n"
+     "  for i := n - 99 to n do\n"
+     "    t := t + i * 5 + k * i + (n * k - 3);\n"
+     "  for i := 2147483640 to 2147483647 do t := t + i * 3;\n"
+     "  t\n"
+     "end",
+     130192},
+    // Functions inlined, lifted and left unused.
+    {"inlining and lifting",
+     "let function sq(x: int): int = x * x\n"
+     "    function unused(): int = sq(1) + 1\n"
+     "    var dead := 3 * 4\n"
+     "    var total := 0\n"
+     "    function outer(n: int): int =\n"
+     "      let function inner(i: int): int =\n"
+     "        if i > 50 then i else inner(i + n)\n"
+     "      in inner(sq(n)) end\n"
+     "    function add(i: int) = total := total + i\n"
+     "in\n"
+     "  for i := 1 to 10 do add(outer(i));\n"
+     "  if 0 then print(\"never\");\n"
+     "  total + sq(3)\n"
+     "end",
+     625},
+    // Breaks inside assignments, initializers and operands.
+    {"breaks in expressions",
+     "let var x := 7 var n := 0 in\n"
+     "  while 1 do x := (break; 1);\n"
+     "  for i := 1 to 3 do\n"
+     "    let var y := (break; 2) in x := 0 end;\n"
+     "  for i := 1 to 5 do (\n"
+     "    n := n + (if (i = 4) then (break; 0) else i);\n"
+     "    print_int(n));\n"
+     "  x * 100 + n\n"
+     "end",
+     706},
+    // Strings ordered by their contents, whatever the operands.
+    {"string order",
+     "let var a := \"b\" var b := concat(\"a\", \"b\")\n"
+     "    function first(): string = \"abc\" in\n"
+     "  print_int(\"b\" < \"a\"); print_int(a > b);\n"
+     "  print_int(first() >= \"abd\");\n"
+     "  print_int((let var c := \"ab\" in c end) <= b); print_int(a = \"b\");\n"
+     "  (a < b) + (b < a) * 10 + (first() < a) * 100\n"
+     "end",
+     110},
+    // Arithmetic wrapping around, folded at -O1.
+    {"constant folding",
+     "let var x := 2147483647 in\n"
+     "  (x + 1) / (0 - 1) + (3 * 4 - 12) * x + (2147483647 + 1) / -1 +\n"
+     "    (if 0 then 1 else 2) + 0 * x\n"
+     "end",
+     2},
+    // A runtime error, reached after breaks which skip assignments.
+    {"division by zero",
+     "let var x := 7 in\n"
+     "  while 1 do x := (break; 1);\n"
+     "  print_int(x);\n"
+     "  for i := 1 to 3 do\n"
+     "    let var y := (break; 2) in print(\"after\\n\") end;\n"
+     "  print_int(10 / (x - 7))\n"
+     "end",
+     0},
+};
+
+#endif // PROGRAMS_HH
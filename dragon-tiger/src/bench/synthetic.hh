@@ -0,0 +1,27 @@
+#ifndef SYNTHETIC_HH
+#define SYNTHETIC_HH
+
+#include <sstream>
+#include <string>
+
+// Tiger programs generated for benchmarks.
+
+// A program with many small functions.
+inline std::string synthetic_program(unsigned functions) {
+  std::ostringstream program;
+  program << "let\n";
+  for (unsigned i = 0; i < functions; i++)
+    program << "  function f" << i << "(a: int, b: int): int =\n"
+            << "    let var s := 0 in\n"
+            << "      for i := a to b do\n"
+            << "        (if i - i / 2 * 2 = 0 then s := s + i * 3\n"
+            << "         else s := s - 1;\n"
+            << "         while s > 1000 do s := s / 2);\n"
+            << "      print(\"f" << i << "\\n\");\n"
+            << "      s\n"
+            << "    end\n";
+  program << "in\n  f0(1, 10)\nend\n";
+  return program.str();
+}
+
+#endif // SYNTHETIC_HH
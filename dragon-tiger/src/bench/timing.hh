@@ -0,0 +1,13 @@
+#ifndef TIMING_HH
+#define TIMING_HH
+
+#include <chrono>
+
+// The time elapsed since an arbitrary point, in seconds, for benchmarks.
+inline double now() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+#endif // TIMING_HH
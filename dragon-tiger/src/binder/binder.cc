@@ -0,0 +1,289 @@
+#include "binder.hh"
+#include "escapes.hh"
+#include "../utils/errors.hh"
+#include "../utils/nolocation.hh"
+
+using utils::error;
+using utils::nl;
+
+namespace ast {
+namespace binder {
+
+Binder::Binder() {
+  scopes.push_scope();
+  const Symbol s_int("int"), s_string("string");
+  enter_primitive("print", boost::none, {s_string});
+  enter_primitive("print_err", boost::none, {s_string});
+  enter_primitive("print_int", boost::none, {s_int});
+  enter_primitive("flush", boost::none, {});
+  enter_primitive("getchar", s_string, {});
+  enter_primitive("ord", s_int, {s_string});
+  enter_primitive("chr", s_string, {s_int});
+  enter_primitive("size", s_int, {s_string});
+  enter_primitive("substring", s_string, {s_string, s_int, s_int});
+  enter_primitive("concat", s_string, {s_string, s_string});
+  enter_primitive("strcmp", s_int, {s_string, s_string});
+  enter_primitive("streq", s_int, {s_string, s_string});
+  enter_primitive("not", s_int, {s_int});
+  enter_primitive("exit", boost::none, {s_int});
+}
+
+Binder::~Binder() {
+  for (auto primitive : primitives)
+    Node::dispose(primitive);
+}
+
+void Binder::enter_primitive(const std::string &name,
+                             const optional<Symbol> &type_name,
+                             const std::vector<Symbol> &params) {
+  std::vector<VarDecl *> param_decls;
+  for (size_t i = 0; i < params.size(); i++)
+    param_decls.push_back(
+        new VarDecl(nl, Symbol("a" + std::to_string(i)), params[i], nullptr));
+  FunDecl *decl =
+      new FunDecl(nl, Symbol(name), type_name, param_decls, nullptr, true);
+  decl->set_external_name(Symbol("__" + name));
+  primitives.push_back(decl);
+  scopes.enter(*decl);
+}
+
+Decl *Binder::find(const SourceLoc &loc, const Symbol &name) {
+  if (Decl *decl = scopes.find(name))
+    return decl;
+  error(loc, "unknown identifier " + name.get().to_string());
+}
+
+void Binder::allocate(VarDecl &decl) {
+  decl.set_depth(functions.size() - 1);
+  decl.set_slot(frame_sizes.back()++);
+}
+
+void Binder::bind_variable(Identifier &id) {
+  Decl *decl = find(id.loc, id.name);
+  if (decl->kind != k_var_decl)
+    error(id.loc, id.name.get().to_string() + " is not a variable");
+  id.set_decl(static_cast<VarDecl *>(decl));
+  id.set_depth(functions.size() - 1);
+}
+
+void Binder::run(const Task &task) {
+  switch (task.action) {
+  case Task::a_visit:
+    task.node->accept(*this);
+    break;
+  case Task::a_enter_group:
+    enter_group(static_cast<Let &>(*task.node), task.first, task.last);
+    break;
+  case Task::a_declare: {
+    VarDecl &decl = static_cast<VarDecl &>(*task.node);
+    allocate(decl);
+    scopes.enter(decl);
+    break;
+  }
+  case Task::a_end_function:
+    end_function(static_cast<FunDecl &>(*task.node));
+    break;
+  case Task::a_push_loop:
+    loops.push_back(static_cast<Loop *>(task.node));
+    break;
+  case Task::a_pop_loop:
+    loops.pop_back();
+    break;
+  case Task::a_push_scope:
+    scopes.push_scope();
+    break;
+  case Task::a_pop_scopes:
+    for (size_t i = 0; i < task.first; i++)
+      scopes.pop_scope();
+    break;
+  case Task::a_bind_lhs: {
+    Assign &assign = static_cast<Assign &>(*task.node);
+    Identifier &lhs = assign.get_lhs();
+    bind_variable(lhs);
+    if (lhs.get_decl()->read_only)
+      error(assign.loc,
+            "cannot assign to loop variable " + lhs.name.get().to_string());
+    break;
+  }
+  }
+}
+
+// The functions of a group get a scope of their own, nested in that of the
+// let, so that a function may hide a variable declared before it in the
+// same let but not another function of its group.
+void Binder::enter_group(Let &let, size_t first, size_t last) {
+  const auto &decls = let.get_decls();
+  scopes.push_scope();
+  for (size_t i = first; i < last; i++) {
+    if (scopes.in_current_scope(decls[i]->name))
+      error(decls[i]->loc, "function " + decls[i]->name.get().to_string() +
+                               " is declared twice in the same group");
+    scopes.enter(*decls[i]);
+  }
+}
+
+// Functions nested in main are named as in the program, others after the
+// function they are nested in, as in `f__g'. A counter makes names which
+// are already taken unique. Names loaded with the AST are kept.
+void Binder::name_function(FunDecl &decl) {
+  if (decl.get_external_name() != Symbol())
+    return;
+  std::string base = decl.name.get().to_string();
+  if (functions.size() > 1)
+    base = functions.back()->get_external_name().get().to_string() + "__" +
+           base;
+  Symbol name(base);
+  if (!external_names.insert(name).second) {
+    unsigned &suffix = suffixes[name];
+    do
+      name = Symbol(base + "_" + std::to_string(++suffix));
+    while (!external_names.insert(name).second);
+  }
+  decl.set_external_name(name);
+}
+
+void Binder::begin_function(FunDecl &decl) {
+  if (!functions.empty())
+    decl.set_parent(functions.back());
+  decl.set_depth(functions.size());
+  name_function(decl);
+  functions.push_back(&decl);
+  frame_sizes.push_back(0);
+  // Loops of the enclosing function cannot be left from this one.
+  loop_bases.push_back(loops.size());
+
+  scopes.push_scope();
+  for (auto param : decl.get_params()) {
+    if (scopes.in_current_scope(param->name))
+      error(param->loc, "parameter " + param->name.get().to_string() +
+                            " is declared twice");
+    allocate(*param);
+    scopes.enter(*param);
+  }
+  schedule(Task::a_end_function, decl);
+  visit_later(*decl.get_expr());
+}
+
+void Binder::end_function(FunDecl &decl) {
+  scopes.pop_scope();
+  loop_bases.pop_back();
+  decl.set_frame_size(frame_sizes.back());
+  frame_sizes.pop_back();
+  functions.pop_back();
+}
+
+FunDecl *Binder::analyze_program(Expr &root) {
+  FunDecl *main = new FunDecl(root.loc, Symbol("main"), boost::none,
+                              std::vector<VarDecl *>(), &root);
+  begin_function(*main);
+  while (!tasks.empty()) {
+    const Task task = tasks.back();
+    tasks.pop_back();
+    run(task);
+  }
+  find_escapes(*main);
+  return main;
+}
+
+// Tasks run last in first out: the children of a node, and what follows
+// them, are scheduled in reverse order.
+
+void Binder::visit(IntegerLiteral &) {}
+
+void Binder::visit(StringLiteral &) {}
+
+void Binder::visit(BinaryOperator &op) {
+  visit_later(op.get_right());
+  visit_later(op.get_left());
+}
+
+void Binder::visit(Sequence &seq) {
+  const auto &exprs = seq.get_exprs();
+  for (size_t i = exprs.size(); i-- > 0;)
+    visit_later(*exprs[i]);
+}
+
+// Consecutive function declarations form a group, whose functions may call
+// each other: they are all entered before any of their bodies is bound.
+void Binder::visit(Let &let) {
+  scopes.push_scope();
+  const size_t pop = tasks.size();
+  schedule(Task::a_pop_scopes, let, 1);
+  visit_later(let.get_sequence());
+  const auto &decls = let.get_decls();
+  for (size_t end = decls.size(); end > 0;) {
+    if (decls[end - 1]->kind != k_fun_decl) {
+      visit_later(*decls[--end]);
+      continue;
+    }
+    size_t begin = end;
+    while (begin > 0 && decls[begin - 1]->kind == k_fun_decl)
+      visit_later(*decls[--begin]);
+    schedule(Task::a_enter_group, let, begin, end);
+    tasks[pop].first++;
+    end = begin;
+  }
+}
+
+void Binder::visit(Identifier &id) { bind_variable(id); }
+
+void Binder::visit(IfThenElse &ite) {
+  visit_later(ite.get_else_part());
+  visit_later(ite.get_then_part());
+  visit_later(ite.get_condition());
+}
+
+void Binder::visit(VarDecl &decl) {
+  schedule(Task::a_declare, decl);
+  if (auto expr = decl.get_expr())
+    visit_later(*expr);
+}
+
+void Binder::visit(FunDecl &decl) { begin_function(decl); }
+
+void Binder::visit(FunCall &call) {
+  Decl *decl = find(call.loc, call.func_name);
+  if (decl->kind != k_fun_decl)
+    error(call.loc, call.func_name.get().to_string() + " is not a function");
+  FunDecl &fun = static_cast<FunDecl &>(*decl);
+  if (fun.get_params().size() != call.get_args().size())
+    error(call.loc, "wrong number of arguments in call to " +
+                        call.func_name.get().to_string());
+  call.set_decl(&fun);
+  call.set_depth(functions.size() - 1);
+  const auto &args = call.get_args();
+  for (size_t i = args.size(); i-- > 0;)
+    visit_later(*args[i]);
+}
+
+void Binder::visit(WhileLoop &loop) {
+  schedule(Task::a_pop_loop, loop);
+  visit_later(loop.get_body());
+  schedule(Task::a_push_loop, loop);
+  visit_later(loop.get_condition());
+}
+
+// The upper bound is outside of the scope of the loop variable.
+void Binder::visit(ForLoop &loop) {
+  schedule(Task::a_pop_scopes, loop, 1);
+  schedule(Task::a_pop_loop, loop);
+  visit_later(loop.get_body());
+  schedule(Task::a_push_loop, loop);
+  visit_later(loop.get_variable());
+  schedule(Task::a_push_scope, loop);
+  visit_later(loop.get_high());
+}
+
+void Binder::visit(Break &b) {
+  if (loops.size() == loop_bases.back())
+    error(b.loc, "break outside of a loop");
+  b.set_loop(loops.back());
+}
+
+void Binder::visit(Assign &assign) {
+  schedule(Task::a_bind_lhs, assign);
+  visit_later(assign.get_rhs());
+}
+
+} // namespace binder
+} // namespace ast
@@ -0,0 +1,119 @@
+#ifndef BINDER_HH
+#define BINDER_HH
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../ast/nodes.hh"
+#include "scoped_table.hh"
+
+namespace ast {
+namespace binder {
+
+// The binder links every use of a name to its declaration and lays out the
+// frames of the program:
+//
+//   - Identifier::decl, FunCall::decl and Break::loop are set;
+//   - every FunDecl gets its parent and its depth, the number of functions
+//     it is nested in (main, which wraps the program, is at depth 0);
+//   - every VarDecl gets the depth of the function owning it and a slot in
+//     the frame of that function, and every function the size of its frame
+//     (parameters come first, in order);
+//   - every Identifier and FunCall gets the depth of the function it
+//     appears in, so that the number of static links to follow to reach a
+//     variable, or to build the static link of a call, is known statically;
+//   - every FunDecl gets an external name unique in the program, made of
+//     its name qualified by those of the functions it is nested in.
+//
+// Once the program is bound, escaping variables are found (see escapes.hh).
+//
+// The binder does not recurse on the native stack: visiting a node binds
+// what can be bound at once, and schedules its children and the actions
+// which must follow them as tasks on an explicit stack, so that programs
+// nested deeply, such as tens of thousands of `let' in one another, cannot
+// exhaust it.
+
+class Binder : public ASTVisitor {
+  // What remains to be done, the next task last.
+  struct Task {
+    enum Action {
+      a_visit,          // Visit node.
+      a_enter_group,    // Enter the functions [first, last) of Let node.
+      a_declare,        // Allocate and enter VarDecl node.
+      a_end_function,   // Leave FunDecl node.
+      a_push_loop,      // Make Loop node the innermost loop.
+      a_pop_loop,       // Leave the innermost loop.
+      a_push_scope,     // Enter a new scope.
+      a_pop_scopes,     // Leave first scopes.
+      a_bind_lhs,       // Bind the left-hand side of Assign node.
+    } action;
+    Node *node;
+    size_t first, last;
+  };
+  std::vector<Task> tasks;
+
+  ScopedTable scopes;
+  // The functions being analyzed, innermost last.
+  std::vector<FunDecl *> functions;
+  // The loops being analyzed, innermost last, and the number of those
+  // belonging to functions enclosing each function being analyzed.
+  std::vector<Loop *> loops;
+  std::vector<size_t> loop_bases;
+  // The primitive functions, owned by the binder.
+  std::vector<FunDecl *> primitives;
+  // The number of slots allocated in the frame of each function being
+  // analyzed.
+  std::vector<int> frame_sizes;
+  // The external names given so far, and for each name the last suffix
+  // used to make it unique.
+  std::unordered_set<Symbol> external_names;
+  std::unordered_map<Symbol, unsigned> suffixes;
+
+  void schedule(Task::Action action, Node &node, size_t first = 0,
+                size_t last = 0) {
+    tasks.push_back(Task{action, &node, first, last});
+  }
+  void visit_later(Node &node) { schedule(Task::a_visit, node); }
+  void run(const Task &task);
+  void enter_group(Let &let, size_t first, size_t last);
+  void name_function(FunDecl &decl);
+  void enter_primitive(const std::string &name,
+                       const optional<Symbol> &type_name,
+                       const std::vector<Symbol> &params);
+  Decl *find(const SourceLoc &loc, const Symbol &name);
+  void allocate(VarDecl &decl);
+  void bind_variable(Identifier &id);
+  void begin_function(FunDecl &decl);
+  void end_function(FunDecl &decl);
+
+public:
+  Binder();
+  ~Binder();
+  Binder &operator=(const Binder &) = delete;
+  Binder(const Binder &) = delete;
+
+  // Bind root and return the main function wrapping it. main owns root,
+  // and must not outlive the binder, which owns the primitive functions.
+  FunDecl *analyze_program(Expr &root);
+
+  virtual void visit(IntegerLiteral &);
+  virtual void visit(StringLiteral &);
+  virtual void visit(BinaryOperator &);
+  virtual void visit(Sequence &);
+  virtual void visit(Let &);
+  virtual void visit(Identifier &);
+  virtual void visit(IfThenElse &);
+  virtual void visit(VarDecl &);
+  virtual void visit(FunDecl &);
+  virtual void visit(FunCall &);
+  virtual void visit(WhileLoop &);
+  virtual void visit(ForLoop &);
+  virtual void visit(Break &);
+  virtual void visit(Assign &);
+};
+
+} // namespace binder
+} // namespace ast
+
+#endif // BINDER_HH
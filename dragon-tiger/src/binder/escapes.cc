@@ -0,0 +1,50 @@
+#include <algorithm>
+#include <vector>
+
+#include "escapes.hh"
+#include "../ast/traversal.hh"
+
+namespace ast {
+namespace binder {
+
+void find_escapes(FunDecl &main) {
+  // The functions enclosing the node walked, indexed by depth.
+  std::vector<FunDecl *> functions;
+  walk(main,
+       [&](Node &node) {
+         // A program read back from a file may carry earlier results,
+         // which are computed again. Declarations come before their uses.
+         switch (node.kind) {
+         case k_fun_decl:
+           functions.push_back(&static_cast<FunDecl &>(node));
+           functions.back()->get_escaping_decls().clear();
+           return;
+         case k_var_decl:
+           static_cast<VarDecl &>(node).get_escapes() = false;
+           return;
+         case k_identifier:
+           break;
+         default:
+           return;
+         }
+         auto &id = static_cast<Identifier &>(node);
+         VarDecl &decl = *id.get_decl();
+         if (id.get_depth() != decl.get_depth() && !decl.get_escapes()) {
+           decl.set_escapes();
+           functions[decl.get_depth()]->get_escaping_decls().push_back(&decl);
+         }
+       },
+       [&](Node &node) {
+         if (node.kind != k_fun_decl)
+           return;
+         auto &escaping = functions.back()->get_escaping_decls();
+         std::sort(escaping.begin(), escaping.end(),
+                   [](const VarDecl *a, const VarDecl *b) {
+                     return a->get_slot() < b->get_slot();
+                   });
+         functions.pop_back();
+       });
+}
+
+} // namespace binder
+} // namespace ast
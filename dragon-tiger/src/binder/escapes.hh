@@ -0,0 +1,20 @@
+#ifndef ESCAPES_HH
+#define ESCAPES_HH
+
+#include "../ast/nodes.hh"
+
+namespace ast {
+namespace binder {
+
+// Find the variables which escape, that is which are used by functions
+// nested in the function owning them, in a program bound by the binder: a
+// use escapes when the depth of the Identifier differs from that of its
+// declaration. Escaping variables get VarDecl::escapes, and are listed in
+// the escaping_decls of their owner, in the order of their slots. Other
+// variables are only ever accessed from the frame of their own function.
+void find_escapes(FunDecl &main);
+
+} // namespace binder
+} // namespace ast
+
+#endif // ESCAPES_HH
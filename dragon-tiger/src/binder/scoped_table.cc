@@ -0,0 +1,74 @@
+#include "scoped_table.hh"
+
+namespace ast {
+namespace binder {
+
+ScopedTable::ScopedTable() : entries(256, Entry{0, 0, nullptr}) {}
+
+// Identifiers are dense, so their low bits spread them evenly.
+ScopedTable::Entry &ScopedTable::lookup(uint32_t key) {
+  const size_t mask = entries.size() - 1;
+  for (size_t i = key & mask;; i = (i + 1) & mask)
+    if (entries[i].key == key || !entries[i].key)
+      return entries[i];
+}
+
+const ScopedTable::Entry *ScopedTable::lookup(uint32_t key) const {
+  const size_t mask = entries.size() - 1;
+  for (size_t i = key & mask;; i = (i + 1) & mask) {
+    if (entries[i].key == key)
+      return &entries[i];
+    if (!entries[i].key)
+      return nullptr;
+  }
+}
+
+void ScopedTable::grow() {
+  std::vector<Entry> old(entries.size() * 2, Entry{0, 0, nullptr});
+  old.swap(entries);
+  for (auto &entry : old)
+    if (entry.key)
+      lookup(entry.key) = entry;
+}
+
+void ScopedTable::push_scope() { marks.push_back(log.size()); }
+
+void ScopedTable::pop_scope() {
+  assert(!marks.empty());
+  while (log.size() > marks.back()) {
+    const Entry &saved = log.back();
+    lookup(saved.key) = saved;
+    log.pop_back();
+  }
+  marks.pop_back();
+}
+
+void ScopedTable::enter(Decl &decl) {
+  assert(!marks.empty());
+  const uint32_t key = decl.name.get_id();
+  Entry *entry = &lookup(key);
+  if (!entry->key) {
+    if (2 * (used + 1) > entries.size()) {
+      grow();
+      entry = &lookup(key);
+    }
+    entry->key = key;
+    used++;
+  }
+  log.push_back(*entry);
+  entry->scope = marks.size();
+  entry->decl = &decl;
+}
+
+Decl *ScopedTable::find(Symbol name) const {
+  const Entry *entry = lookup(name.get_id());
+  return entry ? entry->decl : nullptr;
+}
+
+bool ScopedTable::in_current_scope(Symbol name) const {
+  const Entry *entry = lookup(name.get_id());
+  return entry && entry->decl && entry->scope == marks.size();
+}
+
+} // namespace binder
+} // namespace ast
@@ -0,0 +1,62 @@
+#ifndef SCOPED_TABLE_HH
+#define SCOPED_TABLE_HH
+
+#include <cstdint>
+#include <vector>
+
+#include "../ast/nodes.hh"
+
+namespace ast {
+namespace binder {
+
+// The declarations visible at some point of a program, in nested scopes.
+//
+// Rather than one map per scope, a single open-addressed table indexed by
+// symbol identifier holds the innermost declaration of every name. When a
+// declaration hides another one, the hidden one is saved in an undo log,
+// and it is put back when the scope is left. Entering a declaration and
+// finding a name take constant time whatever the number of scopes, and
+// leaving a scope takes time linear in the number of names it declared.
+
+class ScopedTable {
+  struct Entry {
+    // The identifier of the symbol, or 0 if the entry is free.
+    uint32_t key;
+    // The scope the declaration belongs to, counted from the outermost.
+    uint32_t scope;
+    // Null when no declaration of the symbol is visible.
+    Decl *decl;
+  };
+
+  // The number of entries is a power of two, of which at most half are
+  // used. Entries are never freed: a symbol whose declarations went out of
+  // scope keeps its entry, with a null declaration.
+  std::vector<Entry> entries;
+  size_t used = 0;
+  // What entered declarations replaced, to be restored in reverse order.
+  std::vector<Entry> log;
+  // The size of the log when each open scope was entered.
+  std::vector<size_t> marks;
+
+  Entry &lookup(uint32_t key);
+  const Entry *lookup(uint32_t key) const;
+  void grow();
+
+public:
+  ScopedTable();
+
+  void push_scope();
+  void pop_scope();
+  // A later declaration of the same name in the same scope hides the
+  // previous one.
+  void enter(Decl &decl);
+  // The innermost visible declaration of name, or null.
+  Decl *find(Symbol name) const;
+  // Whether name is declared in the innermost scope.
+  bool in_current_scope(Symbol name) const;
+};
+
+} // namespace binder
+} // namespace ast
+
+#endif // SCOPED_TABLE_HH
@@ -0,0 +1,43 @@
+#include "bytecode.hh"
+#include "../utils/output_buffer.hh"
+
+namespace bytecode {
+
+const char *const opcode_names[op_count] = {
+#define BYTECODE_NAME(name, operands) #name,
+    BYTECODE_OPCODES(BYTECODE_NAME)
+#undef BYTECODE_NAME
+};
+
+const unsigned opcode_operands[op_count] = {
+#define BYTECODE_OPERANDS(name, operands) operands,
+    BYTECODE_OPCODES(BYTECODE_OPERANDS)
+#undef BYTECODE_OPERANDS
+};
+
+// Functions are laid out one after the other, in order.
+void dump(const Program &program, std::ostream &o) {
+  utils::OutputBuffer out(o);
+  for (size_t f = 0; f < program.functions.size(); f++) {
+    const Function &function = program.functions[f];
+    const size_t end = f + 1 < program.functions.size()
+                           ? program.functions[f + 1].entry
+                           : program.code.size();
+    out << "function " << int32_t(f) << ' ' << function.name << " (params "
+        << int32_t(function.params) << ", frame "
+        << int32_t(function.frame_size) << ", stack "
+        << int32_t(function.max_stack) << ")\n";
+    for (size_t pc = function.entry; pc < end;) {
+      const int32_t op = program.code[pc];
+      out << "  " << int32_t(pc) << ": " << opcode_names[op];
+      for (unsigned i = 1; i <= opcode_operands[op]; i++)
+        out << ' ' << program.code[pc + i];
+      if (op == op_call)
+        out << "  ; " << program.functions[program.code[pc + 1]].name;
+      out << '\n';
+      pc += 1 + opcode_operands[op];
+    }
+  }
+}
+
+} // namespace bytecode
@@ -0,0 +1,124 @@
+#ifndef BYTECODE_HH
+#define BYTECODE_HH
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "../utils/source_map.hh"
+#include "../utils/symbols.hh"
+
+namespace bytecode {
+
+// Bytecode is a sequence of 32-bit words: an opcode followed by its
+// operands. The machine has an operand stack and, for every active call, a
+// frame holding the slots allocated by the binder, with the static link of
+// the frame just below its first slot.
+//
+// Operands are: k, a constant; s, a slot in a frame; h, a number of static
+// links to follow from the current frame; t, the index in the code of a
+// jump target; f, the index of a function; p, a primitive (see
+// eval/runtime.hh); n, a number of arguments; l, the index of a location
+// in the program, for runtime errors.
+//
+//   const k            push k
+//   load s             push slot s
+//   store s            pop into slot s
+//   load_outer h s     push slot s of the frame h links up
+//   store_outer h s    pop into slot s of the frame h links up
+//   pop                drop the top of the stack
+//   add, sub, mul      pop b and a, push a op b
+//   div l              idem, failing at location l on division by zero
+//   add_const k        add k to the top of the stack
+//   eq ... ge          pop b and a, push 1 if a cmp b, 0 otherwise
+//   jump t             jump to t
+//   jump_if_false t    pop, and jump to t if zero
+//   jump_if_not_<cmp> t
+//                      pop b and a, and jump to t unless a cmp b
+//   jump_if_not_<cmp>_local_const s k t
+//                      jump to t unless slot s cmp k
+//   for_test s t       jump to t if slot s is greater than the top of the
+//                      stack (the bound of a for loop)
+//   for_step s t       if slot s is less than the top of the stack,
+//                      increment it and jump to t
+//   push_link h        push the frame h links up, as a static link
+//   call f             call f, whose static link and arguments are on the
+//                      stack, the first argument being the deepest
+//   ret                return the top of the stack to the caller
+//   primitive p n l    call primitive p with n arguments
+//   halt               stop, with the top of the stack as result
+//
+// The compare and branch instructions are superinstructions: they replace
+// the loads, comparison and conditional jump found in most conditions.
+
+#define BYTECODE_OPCODES(X)                                                    \
+  X(const, 1)                                                                  \
+  X(load, 1)                                                                   \
+  X(store, 1)                                                                  \
+  X(load_outer, 2)                                                             \
+  X(store_outer, 2)                                                            \
+  X(pop, 0)                                                                    \
+  X(add, 0)                                                                    \
+  X(sub, 0)                                                                    \
+  X(mul, 0)                                                                    \
+  X(div, 1)                                                                    \
+  X(add_const, 1)                                                              \
+  X(eq, 0)                                                                     \
+  X(ne, 0)                                                                     \
+  X(lt, 0)                                                                     \
+  X(le, 0)                                                                     \
+  X(gt, 0)                                                                     \
+  X(ge, 0)                                                                     \
+  X(jump, 1)                                                                   \
+  X(jump_if_false, 1)                                                          \
+  X(jump_if_not_eq, 1)                                                         \
+  X(jump_if_not_ne, 1)                                                         \
+  X(jump_if_not_lt, 1)                                                         \
+  X(jump_if_not_le, 1)                                                         \
+  X(jump_if_not_gt, 1)                                                         \
+  X(jump_if_not_ge, 1)                                                         \
+  X(jump_if_not_eq_local_const, 3)                                             \
+  X(jump_if_not_ne_local_const, 3)                                             \
+  X(jump_if_not_lt_local_const, 3)                                             \
+  X(jump_if_not_le_local_const, 3)                                             \
+  X(jump_if_not_gt_local_const, 3)                                             \
+  X(jump_if_not_ge_local_const, 3)                                             \
+  X(for_test, 2)                                                               \
+  X(for_step, 2)                                                               \
+  X(push_link, 1)                                                              \
+  X(call, 1)                                                                   \
+  X(ret, 0)                                                                    \
+  X(primitive, 3)                                                              \
+  X(halt, 0)
+
+enum Opcode : int32_t {
+#define BYTECODE_ENUM(name, operands) op_##name,
+  BYTECODE_OPCODES(BYTECODE_ENUM)
+#undef BYTECODE_ENUM
+      op_count
+};
+
+extern const char *const opcode_names[op_count];
+extern const unsigned opcode_operands[op_count];
+
+struct Function {
+  utils::Symbol name;
+  uint32_t entry;      // Index of the first instruction
+  uint32_t params;     // Number of parameters
+  uint32_t frame_size; // Number of slots, parameters included
+  uint32_t max_stack;  // Maximum depth of the operand stack
+};
+
+// A compiled program. Function 0 is main, which ends with halt.
+struct Program {
+  std::vector<int32_t> code;
+  std::vector<Function> functions;
+  std::vector<utils::SourceLoc> locations;
+};
+
+// Write a listing of program to o.
+void dump(const Program &program, std::ostream &o);
+
+} // namespace bytecode
+
+#endif // BYTECODE_HH
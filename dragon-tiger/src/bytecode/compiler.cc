@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <initializer_list>
+#include <unordered_map>
+
+#include "compiler.hh"
+#include "../ast/traversal.hh"
+#include "../eval/runtime.hh"
+#include "../utils/errors.hh"
+
+using namespace ast;
+
+namespace bytecode {
+
+namespace {
+
+// A jump target, which may be used before being bound.
+struct Label {
+  int32_t target = -1;
+  // Indices of the operands to patch when the label is bound.
+  std::vector<size_t> uses;
+};
+
+// Every expression is compiled either for its value, which is then pushed
+// on the stack, or for its effects only, leaving the stack as it was. The
+// compiler keeps track of the depth of the operand stack, so that break can
+// drop what was pushed inside its loop, and so that the machine knows how
+// much room each frame needs.
+class Compiler : public ConstASTVisitor {
+  Program &program;
+  std::vector<int32_t> &code;
+  std::unordered_map<const FunDecl *, int32_t> indices;
+  std::vector<const FunDecl *> queue;
+
+  bool want_value = true;
+  int depth = 0;
+  int max_depth = 0;
+
+  struct LoopInfo {
+    Label *end;
+    int depth;
+  };
+  std::vector<LoopInfo> loops;
+
+  void adjust(int delta) {
+    depth += delta;
+    max_depth = std::max(max_depth, depth);
+  }
+
+  void emit(Opcode op, std::initializer_list<int32_t> operands, int delta) {
+    assert(operands.size() == opcode_operands[op]);
+    code.push_back(op);
+    code.insert(code.end(), operands);
+    adjust(delta);
+  }
+
+  // Emit op with the given operands followed by the target label.
+  void jump(Opcode op, std::initializer_list<int32_t> operands, Label &label,
+            int delta) {
+    assert(operands.size() + 1 == opcode_operands[op]);
+    code.push_back(op);
+    code.insert(code.end(), operands);
+    if (label.target == -1)
+      label.uses.push_back(code.size());
+    code.push_back(label.target);
+    adjust(delta);
+  }
+
+  void bind(Label &label) {
+    label.target = code.size();
+    for (auto use : label.uses)
+      code[use] = label.target;
+  }
+
+  int32_t location(const SourceLoc &loc) {
+    program.locations.push_back(loc);
+    return program.locations.size() - 1;
+  }
+
+  void expr(const Expr &e, bool value) {
+    const bool outer = want_value;
+    want_value = value;
+    e.accept(*this);
+    want_value = outer;
+  }
+
+  void push_zero() {
+    if (want_value)
+      emit(op_const, {0}, 1);
+  }
+
+  // Jump to if_false unless e is true. Conditions built by the parser for
+  // `&' and `|', which are nested IfThenElse with literal branches, become
+  // a chain of conditional jumps.
+  void condition(const Expr &e, Label &if_false) {
+    if (e.kind == k_integer_literal) {
+      if (is_literal(e, 0))
+        jump(op_jump, {}, if_false, 0);
+      return;
+    }
+    if (e.kind == k_binary_operator) {
+      auto &binop = static_cast<const BinaryOperator &>(e);
+      const bool string_order =
+          binop.get_left().get_type() == t_string && binop.op >= o_lt;
+      if (binop.op >= o_eq && !string_order) {
+        const int cmp = binop.op - o_eq;
+        const Expr &left = binop.get_left(), &right = binop.get_right();
+        if (left.kind == k_identifier && right.kind == k_integer_literal) {
+          auto &id = static_cast<const Identifier &>(left);
+          if (id.get_depth() == id.get_decl()->get_depth()) {
+            jump(Opcode(op_jump_if_not_eq_local_const + cmp),
+                 {id.get_decl()->get_slot(),
+                  static_cast<const IntegerLiteral &>(right).value},
+                 if_false, 0);
+            return;
+          }
+        }
+        expr(left, true);
+        expr(right, true);
+        jump(Opcode(op_jump_if_not_eq + cmp), {}, if_false, -2);
+        return;
+      }
+    }
+    if (e.kind == k_if_then_else) {
+      auto &ite = static_cast<const IfThenElse &>(e);
+      // `a & b' is `if a then b else 0'.
+      if (is_literal(ite.get_else_part(), 0)) {
+        condition(ite.get_condition(), if_false);
+        condition(ite.get_then_part(), if_false);
+        return;
+      }
+      Label else_part, end;
+      condition(ite.get_condition(), else_part);
+      condition(ite.get_then_part(), if_false);
+      jump(op_jump, {}, end, 0);
+      bind(else_part);
+      condition(ite.get_else_part(), if_false);
+      bind(end);
+      return;
+    }
+    expr(e, true);
+    jump(op_jump_if_false, {}, if_false, -1);
+  }
+
+  void load(const Identifier &id) {
+    const VarDecl &decl = *id.get_decl();
+    if (const int hops = id.get_depth() - decl.get_depth())
+      emit(op_load_outer, {hops, decl.get_slot()}, 1);
+    else
+      emit(op_load, {decl.get_slot()}, 1);
+  }
+
+  void store(const Identifier &id) {
+    const VarDecl &decl = *id.get_decl();
+    if (const int hops = id.get_depth() - decl.get_depth())
+      emit(op_store_outer, {hops, decl.get_slot()}, -1);
+    else
+      emit(op_store, {decl.get_slot()}, -1);
+  }
+
+public:
+  explicit Compiler(Program &_program)
+      : program(_program), code(_program.code) {}
+
+  int32_t function_index(const FunDecl &decl) {
+    auto index = indices.find(&decl);
+    if (index != indices.end())
+      return index->second;
+    const int32_t f = program.functions.size();
+    program.functions.push_back(
+        Function{decl.name, 0, uint32_t(decl.get_params().size()),
+                 uint32_t(decl.get_frame_size()), 0});
+    indices[&decl] = f;
+    queue.push_back(&decl);
+    return f;
+  }
+
+  // Compile the functions found so far and those they use.
+  void compile_functions() {
+    for (size_t f = 0; f < queue.size(); f++) {
+      const FunDecl &decl = *queue[f];
+      program.functions[f].entry = code.size();
+      depth = max_depth = 0;
+      expr(*decl.get_expr(), true);
+      emit(f == 0 ? op_halt : op_ret, {}, -1);
+      program.functions[f].max_stack = max_depth;
+    }
+  }
+
+  virtual void visit(const IntegerLiteral &literal) {
+    if (want_value)
+      emit(op_const, {literal.value}, 1);
+  }
+
+  virtual void visit(const StringLiteral &literal) {
+    if (want_value)
+      emit(op_const, {int32_t(literal.value.get_id())}, 1);
+  }
+
+  virtual void visit(const BinaryOperator &binop) {
+    // Operators have no effect of their own, but a division may fail.
+    const bool value = want_value;
+    want_value = true;
+    const Expr &left = binop.get_left(), &right = binop.get_right();
+    if (left.get_type() == t_string && binop.op >= o_lt) {
+      expr(left, true);
+      expr(right, true);
+      emit(op_primitive, {eval::p_strcmp, 2, location(binop.loc)}, -1);
+      emit(op_const, {0}, 1);
+      emit(Opcode(op_eq + (binop.op - o_eq)), {}, -1);
+    } else if ((binop.op == o_plus || binop.op == o_minus) &&
+               right.kind == k_integer_literal) {
+      const uint32_t k = static_cast<const IntegerLiteral &>(right).value;
+      expr(left, true);
+      emit(op_add_const, {int32_t(binop.op == o_plus ? k : -k)}, 0);
+    } else {
+      expr(left, true);
+      expr(right, true);
+      switch (binop.op) {
+      case o_plus:
+        emit(op_add, {}, -1);
+        break;
+      case o_minus:
+        emit(op_sub, {}, -1);
+        break;
+      case o_times:
+        emit(op_mul, {}, -1);
+        break;
+      case o_divide:
+        emit(op_div, {location(binop.loc)}, -1);
+        break;
+      default:
+        emit(Opcode(op_eq + (binop.op - o_eq)), {}, -1);
+      }
+    }
+    want_value = value;
+    if (!want_value)
+      emit(op_pop, {}, -1);
+  }
+
+  virtual void visit(const Sequence &seq) {
+    const auto &exprs = seq.get_exprs();
+    if (exprs.empty())
+      return push_zero();
+    for (size_t i = 0; i + 1 < exprs.size(); i++)
+      expr(*exprs[i], false);
+    expr(*exprs.back(), want_value);
+  }
+
+  virtual void visit(const Let &let) {
+    for (auto decl : let.get_decls())
+      if (decl->kind == k_fun_decl)
+        function_index(static_cast<const FunDecl &>(*decl));
+      else
+        decl->accept(*this);
+    let.get_sequence().accept(*this);
+  }
+
+  virtual void visit(const Identifier &id) {
+    if (want_value)
+      load(id);
+  }
+
+  virtual void visit(const IfThenElse &ite) {
+    const Expr &else_part = ite.get_else_part();
+    // `if a then b' has an empty sequence as its else part.
+    if (!want_value && else_part.kind == k_sequence &&
+        static_cast<const Sequence &>(else_part).get_exprs().empty()) {
+      Label end;
+      condition(ite.get_condition(), end);
+      ite.get_then_part().accept(*this);
+      bind(end);
+      return;
+    }
+    Label else_label, end;
+    condition(ite.get_condition(), else_label);
+    const int start_depth = depth;
+    ite.get_then_part().accept(*this);
+    jump(op_jump, {}, end, 0);
+    bind(else_label);
+    depth = start_depth;
+    else_part.accept(*this);
+    bind(end);
+  }
+
+  virtual void visit(const VarDecl &decl) {
+    expr(*decl.get_expr(), true);
+    emit(op_store, {decl.get_slot()}, -1);
+  }
+
+  virtual void visit(const FunDecl &) {}
+
+  virtual void visit(const FunCall &call) {
+    const FunDecl &decl = *call.get_decl();
+    const auto &args = call.get_args();
+    if (decl.is_external) {
+      auto p = eval::find_primitive(decl);
+      if (!p)
+        utils::error(call.loc,
+                     "unknown primitive " + decl.name.get().to_string());
+      for (auto arg : args)
+        expr(*arg, true);
+      emit(op_primitive,
+           {*p, int32_t(args.size()), location(call.loc)},
+           1 - int(args.size()));
+    } else {
+      emit(op_push_link, {call.get_depth() - decl.get_depth() + 1}, 1);
+      for (auto arg : args)
+        expr(*arg, true);
+      emit(op_call, {function_index(decl)}, -int(args.size()));
+    }
+    if (!want_value)
+      emit(op_pop, {}, -1);
+  }
+
+  virtual void visit(const WhileLoop &loop) {
+    Label start, end;
+    bind(start);
+    condition(loop.get_condition(), end);
+    loops.push_back(LoopInfo{&end, depth});
+    expr(loop.get_body(), false);
+    loops.pop_back();
+    jump(op_jump, {}, start, 0);
+    bind(end);
+    push_zero();
+  }
+
+  // The bound stays on the stack while the loop runs.
+  virtual void visit(const ForLoop &loop) {
+    const VarDecl &variable = loop.get_variable();
+    const int32_t slot = variable.get_slot();
+    expr(*variable.get_expr(), true);
+    emit(op_store, {slot}, -1);
+    expr(loop.get_high(), true);
+    Label body, end;
+    jump(op_for_test, {slot}, end, 0);
+    bind(body);
+    loops.push_back(LoopInfo{&end, depth});
+    expr(loop.get_body(), false);
+    loops.pop_back();
+    jump(op_for_step, {slot}, body, 0);
+    bind(end);
+    emit(op_pop, {}, -1);
+    push_zero();
+  }
+
+  virtual void visit(const Break &) {
+    const LoopInfo &loop = loops.back();
+    const int start_depth = depth;
+    while (depth > loop.depth)
+      emit(op_pop, {}, -1);
+    jump(op_jump, {}, *loop.end, 0);
+    // What follows is unreachable, but must be compiled consistently.
+    depth = start_depth;
+    push_zero();
+  }
+
+  virtual void visit(const Assign &assign) {
+    expr(assign.get_rhs(), true);
+    store(assign.get_lhs());
+    push_zero();
+  }
+};
+
+} // namespace
+
+Program compile(const FunDecl &main) {
+  Program program;
+  Compiler compiler(program);
+  compiler.function_index(main);
+  compiler.compile_functions();
+  return program;
+}
+
+} // namespace bytecode
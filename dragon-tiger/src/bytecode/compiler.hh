@@ -0,0 +1,15 @@
+#ifndef BYTECODE_COMPILER_HH
+#define BYTECODE_COMPILER_HH
+
+#include "../ast/nodes.hh"
+#include "bytecode.hh"
+
+namespace bytecode {
+
+// Compile the program whose main function was returned by the binder.
+// Functions are compiled in the order they are found, main first.
+Program compile(const ast::FunDecl &main);
+
+} // namespace bytecode
+
+#endif // BYTECODE_COMPILER_HH
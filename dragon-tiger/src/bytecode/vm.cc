@@ -0,0 +1,237 @@
+#include <memory>
+
+#include "vm.hh"
+#include "../eval/runtime.hh"
+#include "../utils/errors.hh"
+
+#if defined(__GNUC__)
+#define BYTECODE_THREADED
+// Computed goto is an extension.
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+namespace bytecode {
+
+using ast::eval::call_primitive;
+using ast::eval::divide;
+using ast::eval::Primitive;
+
+int32_t VM::run() {
+  // What an active call restores when it returns.
+  struct Return {
+    const Word *pc;
+    int32_t *fp;
+  };
+
+#ifdef BYTECODE_THREADED
+  static const void *const labels[op_count] = {
+#define BYTECODE_LABEL(name, operands) &&l_##name,
+      BYTECODE_OPCODES(BYTECODE_LABEL)
+#undef BYTECODE_LABEL
+  };
+#define CASE(name) l_##name
+#define DISPATCH() goto *pc->label
+#else
+#define CASE(name) case op_##name
+#define DISPATCH() goto dispatch
+#endif
+
+  if (code.empty()) {
+    code.resize(program.code.size());
+    for (size_t i = 0; i < code.size();) {
+      const int32_t op = program.code[i];
+#ifdef BYTECODE_THREADED
+      code[i].label = labels[op];
+#else
+      code[i].operand = op;
+#endif
+      for (unsigned j = 1; j <= opcode_operands[op]; j++)
+        code[i + j].operand = program.code[i + j];
+      i += 1 + opcode_operands[op];
+    }
+  }
+
+  const Word *const base = code.data();
+  std::vector<const Word *> entries;
+  for (auto &f : program.functions)
+    entries.push_back(base + f.entry);
+  std::vector<Return> returns;
+
+  // The stack is not initialized: pages are only touched when used.
+  std::unique_ptr<int32_t[]> stack(new int32_t[stack_size]);
+  int32_t *const limit = stack.get() + stack_size;
+
+  // Main has no static link, but gets a slot for it like other functions.
+  const Function &main = program.functions[0];
+  int32_t *fp = stack.get() + 1;
+  int32_t *sp = fp + main.frame_size;
+  const Word *pc = entries[0];
+  if (sp + main.max_stack > limit)
+    utils::error("stack overflow");
+
+  int32_t result;
+  try {
+#ifndef BYTECODE_THREADED
+  dispatch:
+    switch (Opcode(pc->operand)) {
+#else
+    DISPATCH();
+#endif
+
+    CASE(const) : *sp++ = pc[1].operand;
+    pc += 2;
+    DISPATCH();
+
+    CASE(load) : *sp++ = fp[pc[1].operand];
+    pc += 2;
+    DISPATCH();
+
+    CASE(store) : fp[pc[1].operand] = *--sp;
+    pc += 2;
+    DISPATCH();
+
+    CASE(load_outer) : {
+      int32_t *frame = fp;
+      for (intptr_t h = pc[1].operand; h > 0; h--)
+        frame = stack.get() + frame[-1];
+      *sp++ = frame[pc[2].operand];
+      pc += 3;
+      DISPATCH();
+    }
+
+    CASE(store_outer) : {
+      int32_t *frame = fp;
+      for (intptr_t h = pc[1].operand; h > 0; h--)
+        frame = stack.get() + frame[-1];
+      frame[pc[2].operand] = *--sp;
+      pc += 3;
+      DISPATCH();
+    }
+
+    CASE(pop) : --sp;
+    pc += 1;
+    DISPATCH();
+
+#define BYTECODE_ARITH(name, op)                                               \
+  CASE(name) : sp[-2] = uint32_t(sp[-2]) op uint32_t(sp[-1]);                  \
+  --sp;                                                                        \
+  pc += 1;                                                                     \
+  DISPATCH();
+    BYTECODE_ARITH(add, +)
+    BYTECODE_ARITH(sub, -)
+    BYTECODE_ARITH(mul, *)
+#undef BYTECODE_ARITH
+
+    CASE(div) : sp[-2] =
+        divide(sp[-2], sp[-1], out, program.locations[pc[1].operand]);
+    --sp;
+    pc += 2;
+    DISPATCH();
+
+    CASE(add_const) : sp[-1] = uint32_t(sp[-1]) + uint32_t(pc[1].operand);
+    pc += 2;
+    DISPATCH();
+
+#define BYTECODE_COMPARE(name, op)                                             \
+  CASE(name) : sp[-2] = sp[-2] op sp[-1];                                      \
+  --sp;                                                                        \
+  pc += 1;                                                                     \
+  DISPATCH();                                                                  \
+  CASE(jump_if_not_##name) : sp -= 2;                                          \
+  pc = sp[0] op sp[1] ? pc + 2 : base + pc[1].operand;                         \
+  DISPATCH();                                                                  \
+  CASE(jump_if_not_##name##_local_const)                                       \
+      : pc = fp[pc[1].operand] op pc[2].operand ? pc + 4                       \
+                                                : base + pc[3].operand;        \
+  DISPATCH();
+    BYTECODE_COMPARE(eq, ==)
+    BYTECODE_COMPARE(ne, !=)
+    BYTECODE_COMPARE(lt, <)
+    BYTECODE_COMPARE(le, <=)
+    BYTECODE_COMPARE(gt, >)
+    BYTECODE_COMPARE(ge, >=)
+#undef BYTECODE_COMPARE
+
+    CASE(jump) : pc = base + pc[1].operand;
+    DISPATCH();
+
+    CASE(jump_if_false) : pc = *--sp ? pc + 2 : base + pc[1].operand;
+    DISPATCH();
+
+    CASE(for_test) : pc = fp[pc[1].operand] > sp[-1] ? base + pc[2].operand
+                                                     : pc + 3;
+    DISPATCH();
+
+    CASE(for_step) : {
+      int32_t &i = fp[pc[1].operand];
+      if (i < sp[-1]) {
+        i++;
+        pc = base + pc[2].operand;
+      } else
+        pc += 3;
+      DISPATCH();
+    }
+
+    CASE(push_link) : {
+      int32_t *frame = fp;
+      for (intptr_t h = pc[1].operand; h > 0; h--)
+        frame = stack.get() + frame[-1];
+      *sp++ = frame - stack.get();
+      pc += 2;
+      DISPATCH();
+    }
+
+    // The static link and the arguments become the bottom of the frame.
+    CASE(call) : {
+      const Function &f = program.functions[pc[1].operand];
+      int32_t *const frame = sp - f.params;
+      if (frame + f.frame_size + f.max_stack > limit) {
+        out.flush();
+        utils::error("stack overflow");
+      }
+      returns.push_back(Return{pc + 2, fp});
+      fp = frame;
+      sp = frame + f.frame_size;
+      pc = entries[pc[1].operand];
+      DISPATCH();
+    }
+
+    CASE(ret) : {
+      const int32_t value = sp[-1];
+      sp = fp - 1;
+      *sp++ = value;
+      fp = returns.back().fp;
+      pc = returns.back().pc;
+      returns.pop_back();
+      DISPATCH();
+    }
+
+    CASE(primitive) : {
+      const intptr_t n = pc[2].operand;
+      sp -= n;
+      *sp = call_primitive(Primitive(pc[1].operand), sp, out,
+                           program.locations[pc[3].operand]);
+      sp++;
+      pc += 4;
+      DISPATCH();
+    }
+
+    CASE(halt) : result = sp[-1];
+#ifndef BYTECODE_THREADED
+    break;
+    default:
+      assert(false);
+    }
+#endif
+  } catch (ast::eval::Exit &e) {
+    exited = true;
+    result = e.status;
+  }
+#undef CASE
+#undef DISPATCH
+
+  out.flush();
+  return result;
+}
+
+} // namespace bytecode
@@ -0,0 +1,49 @@
+#ifndef BYTECODE_VM_HH
+#define BYTECODE_VM_HH
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "../utils/output_buffer.hh"
+#include "bytecode.hh"
+
+namespace bytecode {
+
+// The virtual machine runs a Program. With GCC and Clang, it is a
+// direct-threaded interpreter: the code is translated once into words
+// holding either the address of the code implementing an instruction or an
+// operand, and each instruction jumps straight to the next one (computed
+// goto). Other compilers get a switch in a loop.
+
+class VM {
+  const Program &program;
+  // Output of the program, as in the evaluator.
+  utils::OutputBuffer out;
+  bool exited = false;
+
+  union Word {
+    const void *label;
+    intptr_t operand;
+  };
+  // The threaded code, built by the first run.
+  std::vector<Word> code;
+
+  // Number of values of the stack, which holds the frames and the operand
+  // stacks of all the active calls.
+  size_t stack_size;
+
+public:
+  explicit VM(const Program &_program, std::ostream &_ostream,
+              size_t _stack_size = 1 << 24)
+      : program(_program), out(_ostream), stack_size(_stack_size) {}
+
+  // Run the program and return the value of main, or the status given to
+  // exit() if the program called it.
+  int32_t run();
+  bool has_exited() const { return exited; }
+};
+
+} // namespace bytecode
+
+#endif // BYTECODE_VM_HH
@@ -0,0 +1,465 @@
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "c_emitter.hh"
+#include "../ast/traversal.hh"
+#include "../eval/runtime.hh"
+#include "../optimizer/purity.hh"
+#include "../utils/errors.hh"
+
+using namespace ast;
+
+namespace cgen {
+
+namespace {
+
+// A C string literal holding the n bytes of s.
+std::string quote(const char *s, size_t n) {
+  std::string q = "\"";
+  for (size_t i = 0; i < n; i++) {
+    const unsigned char c = s[i];
+    if (c == '"' || c == '\\')
+      q += std::string("\\") + char(c);
+    else if (c >= ' ' && c <= '~')
+      q += char(c);
+    else {
+      // Always three digits, so that a following digit is not absorbed.
+      const char octal[] = {'\\', char('0' + (c >> 6)), char('0' + (c >> 3 & 7)),
+                            char('0' + (c & 7)), 0};
+      q += octal;
+    }
+  }
+  return q + "\"";
+}
+
+std::string quote(const std::string &s) { return quote(s.data(), s.size()); }
+
+std::string quote(const SourceLoc &loc) {
+  std::ostringstream s;
+  s << loc;
+  return quote(s.str());
+}
+
+// INT32_MIN has no literal of its own in C.
+std::string literal(int32_t value) {
+  if (value == INT32_MIN)
+    return "(-2147483647 - 1)";
+  return std::to_string(value);
+}
+
+const char *const primitive_names[] = {
+    "tiger_print",     "tiger_print_err", "tiger_print_int", "tiger_flush",
+    "tiger_getchar",   "tiger_ord",       "tiger_chr",       "tiger_size",
+    "tiger_substring", "tiger_concat",    "tiger_strcmp",    "tiger_streq",
+    "tiger_not",       "tiger_exit"};
+
+// Whether the primitive takes the location of its call, to report errors.
+bool takes_location(eval::Primitive p) {
+  return p == eval::p_chr || p == eval::p_substring;
+}
+
+// Every expression is emitted as statements, which are appended to the
+// body of the current function, followed by a C expression giving its
+// value: a literal, a variable or a temporary. Temporaries and variables
+// get names made unique by a counter, so that Tiger scopes need no C
+// blocks; those of temporaries and labels start with an underscore, which
+// Tiger identifiers cannot.
+class CEmitter : public ConstASTVisitor {
+  std::ostream &out;
+  int counter = 0;
+
+  struct FunctionInfo {
+    std::string name;
+    bool has_frame = false;
+    std::vector<const VarDecl *> frame_decls;
+  };
+  std::unordered_map<const FunDecl *, FunctionInfo> functions;
+  std::vector<const FunDecl *> order;
+  std::unordered_map<const VarDecl *, std::string> names;
+  std::unordered_map<const VarDecl *, bool> in_frame;
+  std::vector<const StringLiteral *> strings;
+  std::unordered_map<const StringLiteral *, size_t> string_indices;
+
+  // State of the function being emitted.
+  std::ostringstream body;
+  int indent_level = 1;
+  std::string value;
+
+  struct LoopInfo {
+    std::string end;
+    bool broken;
+  };
+  std::vector<LoopInfo> loops;
+
+  std::string fresh(const std::string &base) {
+    return base + (base[0] == '_' ? "" : "_") + std::to_string(counter++);
+  }
+
+  std::ostream &line() {
+    for (int i = 0; i < indent_level; i++)
+      body << "  ";
+    return body;
+  }
+
+  std::string emit(const Expr &e) {
+    e.accept(*this);
+    return value;
+  }
+
+  // Copy v to a temporary unless it is one already, or a literal.
+  std::string stable(const std::string &v) {
+    if (v[0] == '(' || v[0] == '-' || (v[0] >= '0' && v[0] <= '9') ||
+        v[0] == '_')
+      return v;
+    const std::string t = fresh("_t");
+    line() << "int32_t " << t << " = " << v << ";\n";
+    return t;
+  }
+
+  std::string temporary(const std::string &v) {
+    const std::string t = fresh("_t");
+    line() << "int32_t " << t << " = " << v << ";\n";
+    return t;
+  }
+
+  // Emit the expressions in order, copying values which later ones could
+  // change.
+  std::vector<std::string> emit_all(const std::vector<const Expr *> &exprs) {
+    std::vector<std::string> values;
+    for (size_t i = 0; i < exprs.size(); i++) {
+      values.push_back(emit(*exprs[i]));
+      bool pure = true;
+      for (size_t j = i + 1; j < exprs.size(); j++)
+        pure = pure && optimizer::is_pure(*exprs[j]);
+      if (!pure)
+        values.back() = stable(values.back());
+    }
+    return values;
+  }
+
+  // The C expression reaching the frame of the function hops levels up.
+  std::string link(int hops) {
+    if (!hops)
+      return "&frame";
+    std::string l = "link";
+    while (--hops > 0)
+      l += "->link";
+    return l;
+  }
+
+  std::string variable(const VarDecl &decl, int hops) {
+    if (hops)
+      return link(hops) + "->" + names[&decl];
+    return (in_frame[&decl] ? "frame." : "") + names[&decl];
+  }
+
+  // Name functions and variables, and find the functions needing a frame.
+  void analyze(const FunDecl &main) {
+    std::vector<const FunDecl *> stack;
+    walk(main,
+         [&](const Node &node) {
+           if (node.kind == k_fun_decl) {
+             auto &decl = static_cast<const FunDecl &>(node);
+             if (!stack.empty())
+               functions[stack.back()].has_frame = true;
+             stack.push_back(&decl);
+             order.push_back(&decl);
+             FunctionInfo &info = functions[&decl];
+             if (&decl == &main)
+               info.name = "tiger_main";
+             else
+               info.name = fresh(decl.get_external_name().get().to_string());
+             info.frame_decls.assign(decl.get_escaping_decls().begin(),
+                                     decl.get_escaping_decls().end());
+           } else if (node.kind == k_var_decl) {
+             auto &decl = static_cast<const VarDecl &>(node);
+             names[&decl] = fresh(decl.name.get().to_string());
+           } else if (node.kind == k_string_literal) {
+             auto &literal = static_cast<const StringLiteral &>(node);
+             string_indices[&literal] = strings.size();
+             strings.push_back(&literal);
+           }
+         },
+         [&](const Node &node) {
+           if (node.kind == k_fun_decl)
+             stack.pop_back();
+         });
+    for (auto &f : functions)
+      for (auto decl : f.second.frame_decls)
+        in_frame[decl] = true;
+  }
+
+  std::string frame_type(const FunDecl &decl) {
+    return "struct frame_" + functions[&decl].name;
+  }
+
+  std::string prototype(const FunDecl &decl) {
+    std::string p = "static int32_t " + functions[&decl].name + "(";
+    bool first = true;
+    if (auto parent = decl.get_parent()) {
+      p += frame_type(*parent) + " *link";
+      first = false;
+    }
+    for (auto param : decl.get_params()) {
+      p += (first ? "" : ", ") + std::string("int32_t ") + names[param];
+      first = false;
+    }
+    return p + (first ? "void)" : ")");
+  }
+
+  void function(const FunDecl &decl) {
+    FunctionInfo &info = functions[&decl];
+    body.str(std::string());
+    indent_level = 1;
+    if (info.has_frame) {
+      line() << frame_type(decl) << " frame;\n";
+      if (decl.get_parent())
+        line() << "frame.link = link;\n";
+      for (auto param : decl.get_params())
+        if (in_frame[param])
+          line() << "frame." << names[param] << " = " << names[param]
+                 << ";\n";
+    }
+    const std::string result = emit(*decl.get_expr());
+    line() << "return " << result << ";\n";
+    out << prototype(decl) << " {\n" << body.str() << "}\n\n";
+  }
+
+public:
+  explicit CEmitter(std::ostream &_out) : out(_out) {}
+
+  void emit_program(const FunDecl &main) {
+    analyze(main);
+    out << c_runtime << "\n";
+
+    for (auto f : order)
+      if (functions[f].has_frame)
+        out << frame_type(*f) << ";\n";
+    for (auto f : order) {
+      const FunctionInfo &info = functions[f];
+      if (!info.has_frame)
+        continue;
+      out << "\n" << frame_type(*f) << " {\n";
+      if (auto parent = f->get_parent())
+        out << "  " << frame_type(*parent) << " *link;\n";
+      else
+        out << "  char unused;\n";
+      for (auto decl : info.frame_decls)
+        out << "  int32_t " << names[decl] << ";\n";
+      out << "};\n";
+    }
+
+    out << "\nstatic int32_t tiger_literals[" << std::max<size_t>(strings.size(), 1)
+        << "];\n\n";
+    for (auto f : order)
+      out << prototype(*f) << ";\n";
+    out << "\n";
+    for (auto f : order)
+      function(*f);
+
+    out << "int main(void) {\n";
+    for (size_t i = 0; i < strings.size(); i++) {
+      const std::string s = strings[i]->value.get().to_string();
+      out << "  tiger_literals[" << i << "] = tiger_intern(" << quote(s)
+          << ", " << s.size() << ");\n";
+    }
+    out << "  printf(\"%\" PRId32 \"\\n\", tiger_main());\n"
+        << "  return 0;\n"
+        << "}\n";
+  }
+
+  virtual void visit(const IntegerLiteral &literal) {
+    value = cgen::literal(literal.value);
+  }
+
+  virtual void visit(const StringLiteral &literal) {
+    value = temporary("tiger_literals[" +
+                      std::to_string(string_indices[&literal]) + "]");
+  }
+
+  // The value of binop, whose operands have the values l and r.
+  std::string combine(const BinaryOperator &binop, const std::string &l,
+                      const std::string &r) {
+    static const char *const comparisons[] = {"==", "!=", "<",
+                                              "<=", ">",  ">="};
+    std::string v;
+    switch (binop.op) {
+    case o_plus:
+      v = "tiger_add(" + l + ", " + r + ")";
+      break;
+    case o_minus:
+      v = "tiger_sub(" + l + ", " + r + ")";
+      break;
+    case o_times:
+      v = "tiger_mul(" + l + ", " + r + ")";
+      break;
+    case o_divide:
+      v = "tiger_div(" + l + ", " + r + ", " + quote(binop.loc) + ")";
+      break;
+    default:
+      if (binop.get_left().get_type() == t_string && binop.op >= o_lt)
+        v = "tiger_strcmp(" + l + ", " + r + ") " +
+            comparisons[binop.op - o_eq] + " 0";
+      else
+        v = l + " " + comparisons[binop.op - o_eq] + " " + r;
+    }
+    return temporary(v);
+  }
+
+  // Chains of operators such as a + b + c nest to the left: they are
+  // emitted from the innermost operator out in a loop, so that long chains
+  // do not recurse deeply. As in emit_all(), a left value is copied when
+  // the right operand could change it.
+  virtual void visit(const BinaryOperator &binop) {
+    std::vector<const BinaryOperator *> chain(1, &binop);
+    while (chain.back()->get_left().kind == k_binary_operator)
+      chain.push_back(
+          static_cast<const BinaryOperator *>(&chain.back()->get_left()));
+    std::string l = emit(chain.back()->get_left());
+    for (auto b = chain.rbegin(); b != chain.rend(); b++) {
+      if (!optimizer::is_pure((*b)->get_right()))
+        l = stable(l);
+      const std::string r = emit((*b)->get_right());
+      l = combine(**b, l, r);
+    }
+    value = l;
+  }
+
+  virtual void visit(const Sequence &seq) {
+    value = "0";
+    for (auto e : seq.get_exprs())
+      emit(*e);
+  }
+
+  virtual void visit(const Let &let) {
+    for (auto decl : let.get_decls())
+      if (decl->kind == k_var_decl)
+        decl->accept(*this);
+    emit(let.get_sequence());
+  }
+
+  virtual void visit(const Identifier &id) {
+    value = variable(*id.get_decl(), id.get_depth() - id.get_decl()->get_depth());
+  }
+
+  virtual void visit(const IfThenElse &ite) {
+    const std::string condition = emit(ite.get_condition());
+    const std::string result = fresh("_t");
+    line() << "int32_t " << result << ";\n";
+    line() << "if (" << condition << ") {\n";
+    indent_level++;
+    const std::string then_value = emit(ite.get_then_part());
+    line() << result << " = " << then_value << ";\n";
+    indent_level--;
+    line() << "} else {\n";
+    indent_level++;
+    const std::string else_value = emit(ite.get_else_part());
+    line() << result << " = " << else_value << ";\n";
+    indent_level--;
+    line() << "}\n";
+    value = result;
+  }
+
+  virtual void visit(const VarDecl &decl) {
+    const std::string init = emit(*decl.get_expr());
+    if (in_frame[&decl])
+      line() << "frame." << names[&decl] << " = " << init << ";\n";
+    else
+      line() << "int32_t " << names[&decl] << " = " << init << ";\n";
+    value = "0";
+  }
+
+  virtual void visit(const FunDecl &) {}
+
+  virtual void visit(const FunCall &call) {
+    const FunDecl &decl = *call.get_decl();
+    std::vector<const Expr *> exprs(call.get_args().begin(),
+                                    call.get_args().end());
+    std::vector<std::string> args = emit_all(exprs);
+    std::string f;
+    if (decl.is_external) {
+      auto p = eval::find_primitive(decl);
+      if (!p)
+        utils::error(call.loc,
+                     "unknown primitive " + decl.name.get().to_string());
+      f = primitive_names[*p];
+      if (takes_location(*p))
+        args.push_back(quote(call.loc));
+    } else {
+      f = functions[&decl].name;
+      args.insert(args.begin(),
+                  link(call.get_depth() - decl.get_depth() + 1));
+    }
+    std::string c = f + "(";
+    for (size_t i = 0; i < args.size(); i++)
+      c += (i ? ", " : "") + args[i];
+    value = temporary(c + ")");
+  }
+
+  virtual void visit(const WhileLoop &loop) {
+    loops.push_back(LoopInfo{fresh("_end"), false});
+    line() << "for (;;) {\n";
+    indent_level++;
+    const std::string condition = emit(loop.get_condition());
+    line() << "if (!" << condition << ")\n";
+    line() << "  break;\n";
+    emit(loop.get_body());
+    indent_level--;
+    line() << "}\n";
+    end_loop();
+  }
+
+  virtual void visit(const ForLoop &loop) {
+    const VarDecl &variable = loop.get_variable();
+    const std::string index = this->variable(variable, 0);
+    const std::string low = emit(*variable.get_expr());
+    if (in_frame[&variable])
+      line() << index << " = " << low << ";\n";
+    else
+      line() << "int32_t " << index << " = " << low << ";\n";
+    const std::string high = temporary(emit(loop.get_high()));
+    loops.push_back(LoopInfo{fresh("_end"), false});
+    line() << "if (" << index << " <= " << high << ")\n";
+    line() << "  for (;;) {\n";
+    indent_level += 2;
+    emit(loop.get_body());
+    line() << "if (" << index << " >= " << high << ")\n";
+    line() << "  break;\n";
+    line() << index << "++;\n";
+    indent_level -= 2;
+    line() << "  }\n";
+    end_loop();
+  }
+
+  void end_loop() {
+    if (loops.back().broken)
+      line() << loops.back().end << ":;\n";
+    loops.pop_back();
+    value = "0";
+  }
+
+  virtual void visit(const Break &) {
+    loops.back().broken = true;
+    line() << "goto " << loops.back().end << ";\n";
+    value = "0";
+  }
+
+  virtual void visit(const Assign &assign) {
+    const std::string rhs = emit(assign.get_rhs());
+    auto &id = assign.get_lhs();
+    line() << variable(*id.get_decl(), id.get_depth() - id.get_decl()->get_depth())
+           << " = " << rhs << ";\n";
+    value = "0";
+  }
+};
+
+} // namespace
+
+void emit_c(const FunDecl &main, std::ostream &out) {
+  CEmitter(out).emit_program(main);
+}
+
+} // namespace cgen
@@ -0,0 +1,27 @@
+#ifndef C_EMITTER_HH
+#define C_EMITTER_HH
+
+#include <ostream>
+
+#include "../ast/nodes.hh"
+
+namespace cgen {
+
+// Translate the program whose main function was returned by the binder
+// into a standalone C99 program, which prints the value of main like
+// `dtiger --eval' does, and exits with the status given to exit().
+//
+// Every Tiger function becomes a top-level C function named after its
+// external name. Functions with nested functions get a frame structure on
+// the C stack, whose first member is the static link: a pointer to the
+// frame of the enclosing function. Escaping variables, those listed in
+// FunDecl::escaping_decls, live in the frame of their function. Others are
+// plain C locals, which the C compiler is free to keep in registers.
+void emit_c(const ast::FunDecl &main, std::ostream &out);
+
+// The C runtime, included at the start of every emitted program.
+extern const char *const c_runtime;
+
+} // namespace cgen
+
+#endif // C_EMITTER_HH
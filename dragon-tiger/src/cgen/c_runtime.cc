@@ -0,0 +1,187 @@
+#include "c_emitter.hh"
+
+namespace cgen {
+
+// The runtime of emitted programs, which mirrors eval/runtime.cc: strings
+// are interned, and represented by their index in tiger_strings.
+const char *const c_runtime = R"(#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  char *data;
+  int32_t size;
+} tiger_string;
+
+static tiger_string *tiger_strings;
+static int32_t tiger_string_count, tiger_string_capacity;
+/* Open-addressed table of the indices of the strings, -1 when empty. */
+static int32_t *tiger_table;
+static uint32_t tiger_table_size;
+
+static void tiger_error(const char *loc, const char *m) {
+  fflush(stdout);
+  fprintf(stderr, "%s: %s\n", loc, m);
+  exit(EXIT_FAILURE);
+}
+
+static void *tiger_alloc(size_t n) {
+  void *p = malloc(n ? n : 1);
+  if (!p)
+    tiger_error("runtime", "out of memory");
+  return p;
+}
+
+static uint32_t tiger_hash(const char *s, int32_t n) {
+  uint32_t h = 2166136261u;
+  for (int32_t i = 0; i < n; i++)
+    h = (h ^ (unsigned char)s[i]) * 16777619u;
+  return h;
+}
+
+static int32_t tiger_intern(const char *s, int32_t n) {
+  uint32_t mask, i;
+  char *data;
+  if (2 * (uint32_t)(tiger_string_count + 1) > tiger_table_size) {
+    uint32_t size = tiger_table_size ? 2 * tiger_table_size : 256;
+    int32_t *table = tiger_alloc(size * sizeof *table);
+    for (i = 0; i < size; i++)
+      table[i] = -1;
+    for (int32_t id = 0; id < tiger_string_count; id++) {
+      i = tiger_hash(tiger_strings[id].data, tiger_strings[id].size) &
+          (size - 1);
+      while (table[i] != -1)
+        i = (i + 1) & (size - 1);
+      table[i] = id;
+    }
+    free(tiger_table);
+    tiger_table = table;
+    tiger_table_size = size;
+  }
+  mask = tiger_table_size - 1;
+  for (i = tiger_hash(s, n) & mask; tiger_table[i] != -1; i = (i + 1) & mask) {
+    const tiger_string *t = &tiger_strings[tiger_table[i]];
+    if (t->size == n && !memcmp(t->data, s, n))
+      return tiger_table[i];
+  }
+  if (tiger_string_count == tiger_string_capacity) {
+    tiger_string_capacity = tiger_string_capacity ? 2 * tiger_string_capacity
+                                                  : 256;
+    tiger_strings = realloc(tiger_strings,
+                            tiger_string_capacity * sizeof *tiger_strings);
+    if (!tiger_strings)
+      tiger_error("runtime", "out of memory");
+  }
+  data = tiger_alloc(n);
+  memcpy(data, s, n);
+  tiger_strings[tiger_string_count].data = data;
+  tiger_strings[tiger_string_count].size = n;
+  tiger_table[i] = tiger_string_count;
+  return tiger_string_count++;
+}
+
+static inline int32_t tiger_add(int32_t l, int32_t r) {
+  return (int32_t)((uint32_t)l + (uint32_t)r);
+}
+
+static inline int32_t tiger_sub(int32_t l, int32_t r) {
+  return (int32_t)((uint32_t)l - (uint32_t)r);
+}
+
+static inline int32_t tiger_mul(int32_t l, int32_t r) {
+  return (int32_t)((uint32_t)l * (uint32_t)r);
+}
+
+static inline int32_t tiger_div(int32_t l, int32_t r, const char *loc) {
+  if (!r)
+    tiger_error(loc, "division by zero");
+  if (l == INT32_MIN && r == -1)
+    return INT32_MIN;
+  return l / r;
+}
+
+static inline int32_t tiger_print(int32_t s) {
+  fwrite(tiger_strings[s].data, 1, tiger_strings[s].size, stdout);
+  return 0;
+}
+
+static inline int32_t tiger_print_err(int32_t s) {
+  fflush(stdout);
+  fwrite(tiger_strings[s].data, 1, tiger_strings[s].size, stderr);
+  return 0;
+}
+
+static inline int32_t tiger_print_int(int32_t i) {
+  printf("%" PRId32, i);
+  return 0;
+}
+
+static inline int32_t tiger_flush(void) {
+  fflush(stdout);
+  return 0;
+}
+
+static inline int32_t tiger_getchar(void) {
+  int c;
+  char ch;
+  fflush(stdout);
+  c = getchar();
+  if (c == EOF)
+    return tiger_intern("", 0);
+  ch = (char)c;
+  return tiger_intern(&ch, 1);
+}
+
+static inline int32_t tiger_ord(int32_t s) {
+  return tiger_strings[s].size ? (unsigned char)tiger_strings[s].data[0] : -1;
+}
+
+static inline int32_t tiger_chr(int32_t i, const char *loc) {
+  char c;
+  if (i < 0 || i > 255)
+    tiger_error(loc, "chr: character out of range");
+  c = (char)i;
+  return tiger_intern(&c, 1);
+}
+
+static inline int32_t tiger_size(int32_t s) { return tiger_strings[s].size; }
+
+static inline int32_t tiger_substring(int32_t s, int32_t first, int32_t n,
+                                      const char *loc) {
+  if (first < 0 || n < 0 || (int64_t)first + n > tiger_strings[s].size)
+    tiger_error(loc, "substring: out of bounds");
+  return tiger_intern(tiger_strings[s].data + first, n);
+}
+
+static inline int32_t tiger_concat(int32_t a, int32_t b) {
+  const tiger_string l = tiger_strings[a], r = tiger_strings[b];
+  char *data = tiger_alloc((size_t)l.size + r.size);
+  int32_t s;
+  memcpy(data, l.data, l.size);
+  memcpy(data + l.size, r.data, r.size);
+  s = tiger_intern(data, l.size + r.size);
+  free(data);
+  return s;
+}
+
+static inline int32_t tiger_strcmp(int32_t a, int32_t b) {
+  const tiger_string l = tiger_strings[a], r = tiger_strings[b];
+  int c = memcmp(l.data, r.data, l.size < r.size ? l.size : r.size);
+  if (!c)
+    c = (l.size > r.size) - (l.size < r.size);
+  return (c > 0) - (c < 0);
+}
+
+static inline int32_t tiger_streq(int32_t a, int32_t b) { return a == b; }
+
+static inline int32_t tiger_not(int32_t i) { return !i; }
+
+static inline int32_t tiger_exit(int32_t status) {
+  fflush(stdout);
+  exit(status);
+}
+)";
+
+} // namespace cgen
@@ -1,29 +1,275 @@
 #include <boost/program_options.hpp>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <sstream>
 
 #include "../ast/ast_dumper.hh"
+#include "../ast/ast_file.hh"
+#include "../binder/binder.hh"
+#include "../bytecode/compiler.hh"
+#include "../bytecode/vm.hh"
+#include "../cgen/c_emitter.hh"
+#include "../eval/evaluator.hh"
+#include "../ir/lowering.hh"
+#include "../ir/passes.hh"
+#include "../jit/jit.hh"
+#include "../optimizer/inliner.hh"
+#include "../optimizer/pipeline.hh"
 #include "../parser/parser_driver.hh"
+#include "../type_checker/type_checker.hh"
+#include "../utils/arena.hh"
 #include "../utils/errors.hh"
+#include "../utils/parallel.hh"
+#include "../utils/symbols.hh"
+
+namespace po = boost::program_options;
+
+namespace {
+
+// Read -fname=value, as in gcc, as --fname=value.
+std::pair<std::string, std::string> gcc_style_option(const std::string &arg) {
+  const size_t eq = arg.find('=');
+  if (arg.compare(0, 2, "-f") || eq == std::string::npos)
+    return std::make_pair(std::string(), std::string());
+  return std::make_pair(arg.substr(1, eq - 1), arg.substr(eq + 1));
+}
+
+void print_heap_stats(std::ostream &o) {
+  const utils::AllocationStats heap = utils::heap_stats();
+  o << "heap: " << heap.allocations << " allocations (" << heap.bytes
+    << " bytes), " << heap.releases << " releases" << std::endl;
+}
+
+void print_symbol_stats(std::ostream &o) {
+  const utils::SymbolStats stats = utils::symbol_stats();
+  o << "symbols: " << stats.symbols << " symbols (" << stats.string_bytes
+    << " bytes of characters), " << stats.total_bytes << " bytes used"
+    << std::endl;
+}
+
+void print_arena_stats(std::ostream &o, const utils::Arena &arena) {
+  const utils::AllocationStats &stats = arena.stats();
+  o << "arena: " << stats.allocations << " allocations (" << stats.bytes
+    << " bytes) in " << arena.chunks_count() << " chunks ("
+    << arena.reserved_bytes() << " bytes reserved)" << std::endl;
+}
+
+// Compile the Tiger file f (or load the AST saved in f with --load-ast) and
+// write the requested output to out. The AST is allocated in arena, or on
+// the heap if arena is null.
+void compile(const std::string &f, const po::variables_map &vm,
+             std::ostream &out, utils::Arena *arena) {
+  utils::Arena::Scope arena_scope(arena);
+  ast::Expr *root;
+  if (vm.count("load-ast")) {
+    ast::ASTFile file(f);
+    root = file.to_tree();
+  } else {
+    ParserDriver parser_driver(vm.count("trace-lexer"),
+                               vm.count("trace-parser"));
+    if (!parser_driver.parse(f)) {
+      utils::error("parser failed");
+    }
+    root = parser_driver.result_ast;
+  }
+
+  if (vm.count("emit-ast-bin"))
+    ast::write_ast_file(vm["emit-ast-bin"].as<std::string>(),
+                        ast::flatten(*root));
+
+  // The binder owns the primitive functions, which are used until the
+  // program is deleted.
+  std::unique_ptr<ast::binder::Binder> binder;
+  ast::FunDecl *main = nullptr;
+  const bool run_bytecode = vm.count("bytecode") || vm.count("dump-bytecode");
+  const int level = vm.count("optimize") ? vm["optimize"].as<int>() : 0;
+  const bool run = vm.count("eval") || run_bytecode || vm.count("jit") ||
+                   vm.count("emit-c");
+  if (vm.count("bind") || vm.count("dump-ir") || run || level > 0) {
+    binder.reset(new ast::binder::Binder());
+    main = binder->analyze_program(*root);
+    const std::vector<ast::type_checker::TypeError> errors =
+        ast::type_checker::check_types(*main);
+    for (auto &e : errors)
+      utils::non_fatal_error(e.loc, e.message);
+    if (!errors.empty())
+      utils::error("type checking failed");
+  }
+
+  if (main) {
+    ast::optimizer::PipelineOptions options;
+    options.level = level;
+    options.run = run;
+    options.inline_limit = vm.count("finline-limit")
+                               ? vm["finline-limit"].as<unsigned>()
+                               : ast::optimizer::default_inline_limit;
+    ast::optimizer::optimize(*main, options,
+                             vm.count("stats") ? &utils::diagnostics_stream()
+                                               : nullptr);
+    // Passes may have replaced the body of main.
+    root = &*main->get_expr();
+  }
+
+  if (vm.count("dump-ast")) {
+    ast::ASTDumper dumper(&out, vm.count("verbose") > 0);
+    dumper.dump(*root);
+    dumper.nl();
+    dumper.flush();
+  }
+
+  if (vm.count("dump-ir")) {
+    ir::Module module = ir::lower(*main);
+    if (level > 0) {
+      ir::PassManager passes;
+      ir::add_default_passes(passes);
+      passes.run(module);
+      if (vm.count("stats"))
+        passes.report(utils::diagnostics_stream());
+    }
+    ir::dump(module, out);
+  }
+
+  if (vm.count("eval")) {
+    ast::eval::Evaluator evaluator(out);
+    const int32_t result = evaluator.run(*main);
+    if (!evaluator.has_exited())
+      out << result << std::endl;
+    else if (result)
+      utils::error("program exited with status " + std::to_string(result));
+  }
+
+  if (run_bytecode) {
+    const bytecode::Program program = bytecode::compile(*main);
+    if (vm.count("dump-bytecode"))
+      bytecode::dump(program, out);
+    if (vm.count("bytecode")) {
+      bytecode::VM machine(program, out);
+      const int32_t result = machine.run();
+      if (!machine.has_exited())
+        out << result << std::endl;
+      else if (result)
+        utils::error("program exited with status " + std::to_string(result));
+    }
+  }
+
+  if (vm.count("emit-c"))
+    cgen::emit_c(*main, out);
+
+  if (vm.count("jit")) {
+    jit::JIT compiled(*main, out);
+    const int32_t result = compiled.run();
+    if (!compiled.has_exited())
+      out << result << std::endl;
+    else if (result)
+      utils::error("program exited with status " + std::to_string(result));
+  }
+
+  // main, if any, owns root.
+  if (!arena) {
+    if (main)
+      delete main;
+    else
+      delete root;
+  }
+}
+
+// The outcome of compiling one file in batch mode.
+struct Job {
+  std::ostringstream output;
+  std::ostringstream diagnostics;
+  bool failed = false;
+};
+
+// Compile every file of input_files using the given number of threads.
+// Each file gets its own diagnostics, which are prefixed by its name, and
+// its own status: a "<file>: failed" line follows the diagnostics of a file
+// which failed. The output of the files is written in order.
+// Returns the number of files which failed.
+size_t compile_batch(const std::vector<std::string> &input_files,
+                     unsigned jobs, const po::variables_map &vm) {
+  const bool use_arena = !vm.count("ast-heap");
+  std::vector<Job> results(input_files.size());
+  size_t failures = 0;
+
+  auto task = [&](size_t i) {
+    Job &job = results[i];
+    utils::DiagnosticScope diagnostic_scope(job.diagnostics);
+    utils::Arena ast_arena;
+    try {
+      compile(input_files[i], vm, job.output, use_arena ? &ast_arena : nullptr);
+    } catch (utils::FatalError &) {
+      job.failed = true;
+    } catch (std::exception &e) {
+      // Other errors, such as running out of memory, only stop this file.
+      utils::non_fatal_error(std::string("internal error: ") + e.what());
+      job.failed = true;
+    }
+    if (vm.count("stats") && use_arena)
+      print_arena_stats(job.diagnostics, ast_arena);
+  };
+
+  auto done = [&](size_t i) {
+    Job &job = results[i];
+    std::cout << job.output.str();
+    std::cout.flush();
+    std::istringstream diagnostics(job.diagnostics.str());
+    for (std::string line; std::getline(diagnostics, line);)
+      std::cerr << input_files[i] << ": " << line << std::endl;
+    if (job.failed) {
+      std::cerr << input_files[i] << ": failed" << std::endl;
+      failures++;
+    }
+    // Release the memory used by this file as soon as possible.
+    job.output.str(std::string());
+    job.diagnostics.str(std::string());
+  };
+
+  utils::parallel_for_ordered(input_files.size(), jobs, task, done);
+
+  if (vm.count("stats")) {
+    print_heap_stats(std::cerr);
+    print_symbol_stats(std::cerr);
+  }
+  return failures;
+}
+
+} // namespace
 
 int main(int argc, char **argv) {
   std::vector<std::string> input_files;
-  namespace po = boost::program_options;
+  unsigned jobs = 1;
   po::options_description options("Options");
   options.add_options()
   ("help,h", "describe arguments")
   ("dump-ast", "dump the parsed AST")
+  ("bind", "bind identifiers to their declarations and check types")
+  ("optimize,O", po::value<int>(), "optimization level (0 to 2)")
+  ("finline-limit", po::value<unsigned>(), "inline functions of at most N nodes with -O2 (0 disables inlining)")
+  ("eval", "evaluate the program and print its value")
+  ("bytecode", "run the program compiled to bytecode and print its value")
+  ("dump-bytecode", "dump the program compiled to bytecode")
+  ("dump-ir", "dump the program lowered to the SSA intermediate representation")
+  ("jit", "run the program compiled to machine code and print its value")
+  ("emit-c", "translate the program to C")
+  ("ast-heap", "allocate AST nodes on the heap and delete them one by one")
+  ("emit-ast-bin", po::value<std::string>(), "save the AST in binary form to the given file")
+  ("load-ast", "read input files as binary ASTs instead of parsing them")
+  ("jobs,j", po::value(&jobs), "number of input files processed in parallel")
+  ("stats", "print statistics on standard error")
   ("trace-parser", "enable parser traces")
   ("trace-lexer", "enable lexer traces")
   ("verbose,v", "be verbose")
   ("input-file", po::value(&input_files), "input Tiger file");
 
   po::positional_options_description positional;
-  positional.add("input-file", 1);
+  positional.add("input-file", -1);
 
   po::variables_map vm;
   po::store(po::command_line_parser(argc, argv)
                 .options(options)
                 .positional(positional)
+                .extra_parser(gcc_style_option)
                 .run(),
             vm);
   po::notify(vm);
@@ -33,21 +279,28 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  if (input_files.size() != 1) {
-    utils::error("usage: dtiger [options] input-file");
+  if (input_files.empty()) {
+    utils::error("usage: dtiger [options] input-file...");
   }
 
-  ParserDriver parser_driver = ParserDriver(vm.count("trace-lexer"), vm.count("trace-parser"));
-
-  if (!parser_driver.parse(input_files[0])) {
-    utils::error("parser failed");
+  if (input_files.size() > 1 && vm.count("emit-ast-bin")) {
+    utils::error("--emit-ast-bin needs a single input file");
   }
 
-  if (vm.count("dump-ast")) {
-    ast::ASTDumper dumper(&std::cout, vm.count("verbose") > 0);
-    parser_driver.result_ast->accept(dumper);
-    dumper.nl();
+  if (input_files.size() > 1)
+    return compile_batch(input_files, jobs, vm) ? EXIT_FAILURE : 0;
+
+  // Unless asked otherwise, the AST lives in an arena which is released
+  // as a whole once we are done with it.
+  const bool use_arena = !vm.count("ast-heap");
+  utils::Arena ast_arena;
+  compile(input_files[0], vm, std::cout, use_arena ? &ast_arena : nullptr);
+
+  if (vm.count("stats")) {
+    print_heap_stats(std::cerr);
+    print_symbol_stats(std::cerr);
+    if (use_arena)
+      print_arena_stats(std::cerr, ast_arena);
   }
-  delete parser_driver.result_ast;
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,241 @@
+#include "evaluator.hh"
+#include "runtime.hh"
+
+namespace ast {
+namespace eval {
+
+// A variable declared at decl.depth and used at depth lives in the frame
+// reached by following depth - decl.depth static links.
+int32_t &Evaluator::variable(int depth, const VarDecl &decl) {
+  size_t frame = current;
+  for (int hops = depth - decl.get_depth(); hops > 0; hops--)
+    frame = frames[frame].link;
+  return values[frames[frame].base + decl.get_slot()];
+}
+
+int32_t Evaluator::run(const FunDecl &main) {
+  assert(main.get_frame_size() != -1);
+  values.assign(main.get_frame_size(), 0);
+  frames.assign(1, Frame{0, 0});
+  current = 0;
+  char base;
+  stack_base = reinterpret_cast<uintptr_t>(&base);
+  int32_t result;
+  try {
+    result = main.get_expr()->accept(*this);
+  } catch (Exit &e) {
+    exited = true;
+    result = e.status;
+  }
+  out.flush();
+  return result;
+}
+
+int32_t Evaluator::visit(const IntegerLiteral &literal) {
+  return literal.value;
+}
+
+int32_t Evaluator::visit(const StringLiteral &literal) {
+  return literal.value.get_id();
+}
+
+// Arithmetic wraps around on overflow.
+int32_t Evaluator::visit(const BinaryOperator &binop) {
+  const int32_t l = binop.get_left().accept(*this);
+  if (breaking)
+    return 0;
+  const int32_t r = binop.get_right().accept(*this);
+  if (breaking)
+    return 0;
+  if (binop.get_left().get_type() == t_string && binop.op >= o_lt) {
+    const int c = string_value(l).compare(string_value(r));
+    switch (binop.op) {
+    case o_lt:
+      return c < 0;
+    case o_le:
+      return c <= 0;
+    case o_gt:
+      return c > 0;
+    default:
+      return c >= 0;
+    }
+  }
+  switch (binop.op) {
+  case o_plus:
+    return uint32_t(l) + uint32_t(r);
+  case o_minus:
+    return uint32_t(l) - uint32_t(r);
+  case o_times:
+    return uint32_t(l) * uint32_t(r);
+  case o_divide:
+    return divide(l, r, out, binop.loc);
+  case o_eq:
+    return l == r;
+  case o_neq:
+    return l != r;
+  case o_lt:
+    return l < r;
+  case o_le:
+    return l <= r;
+  case o_gt:
+    return l > r;
+  case o_ge:
+    return l >= r;
+  }
+  assert(false);
+  return 0;
+}
+
+int32_t Evaluator::visit(const Sequence &seq) {
+  int32_t result = 0;
+  for (auto expr : seq.get_exprs()) {
+    result = expr->accept(*this);
+    if (breaking)
+      return 0;
+  }
+  return result;
+}
+
+int32_t Evaluator::visit(const Let &let) {
+  for (auto decl : let.get_decls()) {
+    decl->accept(*this);
+    if (breaking)
+      return 0;
+  }
+  return let.get_sequence().accept(*this);
+}
+
+int32_t Evaluator::visit(const Identifier &id) {
+  return variable(id.get_depth(), *id.get_decl());
+}
+
+int32_t Evaluator::visit(const IfThenElse &ite) {
+  const int32_t condition = ite.get_condition().accept(*this);
+  if (breaking)
+    return 0;
+  if (condition)
+    return ite.get_then_part().accept(*this);
+  return ite.get_else_part().accept(*this);
+}
+
+int32_t Evaluator::visit(const VarDecl &decl) {
+  const int32_t value = decl.get_expr()->accept(*this);
+  if (breaking)
+    return 0;
+  values[frames[current].base + decl.get_slot()] = value;
+  return 0;
+}
+
+int32_t Evaluator::visit(const FunDecl &) { return 0; }
+
+// The arguments are evaluated straight into the slots of the parameters of
+// the new frame: calls made while evaluating them use frames above it, which
+// are gone when they return.
+int32_t Evaluator::visit(const FunCall &call) {
+  const FunDecl &decl = *call.get_decl();
+  if (decl.is_external)
+    return primitive(call, decl);
+
+  // The stack grows down on every supported platform.
+  char here;
+  if (stack_base - reinterpret_cast<uintptr_t>(&here) > stack_size)
+    runtime_error(out, call.loc, "stack overflow");
+
+  const size_t base = values.size();
+  for (auto arg : call.get_args()) {
+    const int32_t value = arg->accept(*this);
+    if (breaking) {
+      values.resize(base);
+      return 0;
+    }
+    values.push_back(value);
+  }
+  values.resize(base + decl.get_frame_size());
+
+  // The static link is the frame of the function enclosing decl, which is
+  // at depth decl.depth - 1.
+  size_t link = current;
+  for (int hops = call.get_depth() - decl.get_depth() + 1; hops > 0; hops--)
+    link = frames[link].link;
+  frames.push_back(Frame{base, link});
+
+  const size_t caller = current;
+  current = frames.size() - 1;
+  const int32_t result = decl.get_expr()->accept(*this);
+  current = caller;
+  frames.pop_back();
+  values.resize(base);
+  return result;
+}
+
+int32_t Evaluator::visit(const WhileLoop &loop) {
+  for (;;) {
+    const int32_t condition = loop.get_condition().accept(*this);
+    // A break in the condition leaves an enclosing loop.
+    if (breaking || !condition)
+      break;
+    loop.get_body().accept(*this);
+    if (breaking) {
+      breaking = false;
+      break;
+    }
+  }
+  return 0;
+}
+
+int32_t Evaluator::visit(const ForLoop &loop) {
+  const VarDecl &variable = loop.get_variable();
+  int32_t i = variable.get_expr()->accept(*this);
+  if (breaking)
+    return 0;
+  const int32_t high = loop.get_high().accept(*this);
+  const size_t slot = frames[current].base + variable.get_slot();
+  if (breaking || i > high)
+    return 0;
+  for (;;) {
+    values[slot] = i;
+    loop.get_body().accept(*this);
+    if (breaking) {
+      breaking = false;
+      break;
+    }
+    // Stop before i overflows when high is INT32_MAX.
+    if (i == high)
+      break;
+    i++;
+  }
+  return 0;
+}
+
+int32_t Evaluator::visit(const Break &) {
+  breaking = true;
+  return 0;
+}
+
+int32_t Evaluator::visit(const Assign &assign) {
+  const int32_t value = assign.get_rhs().accept(*this);
+  if (breaking)
+    return 0;
+  const Identifier &lhs = assign.get_lhs();
+  variable(lhs.get_depth(), *lhs.get_decl()) = value;
+  return 0;
+}
+
+int32_t Evaluator::primitive(const FunCall &call, const FunDecl &decl) {
+  int32_t args[3];
+  const auto &arg_exprs = call.get_args();
+  assert(arg_exprs.size() <= 3);
+  for (size_t i = 0; i < arg_exprs.size(); i++) {
+    args[i] = arg_exprs[i]->accept(*this);
+    if (breaking)
+      return 0;
+  }
+  auto p = find_primitive(decl);
+  if (!p)
+    runtime_error(out, call.loc,
+                  "unknown primitive " + decl.name.get().to_string());
+  return call_primitive(*p, args, out, call.loc);
+}
+
+} // namespace eval
+} // namespace ast
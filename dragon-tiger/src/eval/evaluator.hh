@@ -0,0 +1,85 @@
+#ifndef EVALUATOR_HH
+#define EVALUATOR_HH
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "../ast/nodes.hh"
+#include "../utils/output_buffer.hh"
+
+namespace ast {
+namespace eval {
+
+// The evaluator runs a program bound by binder::Binder by walking its tree.
+// Values are those of the runtime (see runtime.hh).
+//
+// Variables live in frames, one per active call, stored back to back in a
+// single vector. A frame holds the slots allocated by the binder for the
+// parameters and locals of its function, and the index of the frame of the
+// enclosing function (its static link). A variable is found by following
+// as many static links as the depth of its use exceeds the depth of its
+// declaration, then by indexing the frame with its slot: no name is looked
+// up at runtime.
+//
+// Tiger calls are native calls of the evaluator. A call which would take the
+// native stack used since run() began beyond stack_size bytes fails with
+// "stack overflow", which leaves room for the rest of the stack of the
+// thread (8 MiB by default on Linux).
+
+class Evaluator : public ConstASTIntVisitor {
+  // Output of the program, flushed by flush(), before reading from the
+  // standard input or writing to the standard error, and on exit.
+  utils::OutputBuffer out;
+
+  struct Frame {
+    size_t base; // Index of the first slot in values
+    size_t link; // Index of the static link in frames
+  };
+  std::vector<int32_t> values;
+  std::vector<Frame> frames;
+  size_t current = 0;
+
+  // Set by break, and cleared by the loop it leaves. Every visit returns
+  // as soon as a subexpression sets it, without any further effect.
+  bool breaking = false;
+
+  // Whether the program called exit().
+  bool exited = false;
+
+  // The native stack available to the program, and where it began.
+  size_t stack_size;
+  uintptr_t stack_base = 0;
+
+  int32_t &variable(int depth, const VarDecl &decl);
+  int32_t primitive(const FunCall &call, const FunDecl &decl);
+
+public:
+  explicit Evaluator(std::ostream &_ostream, size_t _stack_size = 6 << 20)
+      : out(_ostream), stack_size(_stack_size) {}
+
+  // Run main, as returned by the binder, and return its value, or the
+  // status given to exit() if the program called it.
+  int32_t run(const FunDecl &main);
+  bool has_exited() const { return exited; }
+
+  virtual int32_t visit(const IntegerLiteral &);
+  virtual int32_t visit(const StringLiteral &);
+  virtual int32_t visit(const BinaryOperator &);
+  virtual int32_t visit(const Sequence &);
+  virtual int32_t visit(const Let &);
+  virtual int32_t visit(const Identifier &);
+  virtual int32_t visit(const IfThenElse &);
+  virtual int32_t visit(const VarDecl &);
+  virtual int32_t visit(const FunDecl &);
+  virtual int32_t visit(const FunCall &);
+  virtual int32_t visit(const WhileLoop &);
+  virtual int32_t visit(const ForLoop &);
+  virtual int32_t visit(const Break &);
+  virtual int32_t visit(const Assign &);
+};
+
+} // namespace eval
+} // namespace ast
+
+#endif // EVALUATOR_HH
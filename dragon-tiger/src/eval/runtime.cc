@@ -0,0 +1,91 @@
+#include <cstdio>
+#include <iostream>
+#include <unordered_map>
+
+#include "runtime.hh"
+#include "../utils/errors.hh"
+
+namespace ast {
+namespace eval {
+
+boost::optional<Primitive> find_primitive(const FunDecl &decl) {
+  static const std::unordered_map<Symbol, Primitive> primitives = {
+      {"print", p_print},         {"print_err", p_print_err},
+      {"print_int", p_print_int}, {"flush", p_flush},
+      {"getchar", p_getchar},     {"ord", p_ord},
+      {"chr", p_chr},             {"size", p_size},
+      {"substring", p_substring}, {"concat", p_concat},
+      {"strcmp", p_strcmp},       {"streq", p_streq},
+      {"not", p_not},             {"exit", p_exit}};
+  if (!decl.is_external)
+    return boost::none;
+  auto p = primitives.find(decl.name);
+  if (p == primitives.end())
+    return boost::none;
+  return p->second;
+}
+
+void runtime_error(utils::OutputBuffer &out, const SourceLoc &loc,
+                   const std::string &m) {
+  out.flush();
+  utils::error(loc, m);
+}
+
+int32_t call_primitive(Primitive p, const int32_t *args,
+                       utils::OutputBuffer &out, const SourceLoc &loc) {
+  switch (p) {
+  case p_print:
+    out << string_value(args[0]);
+    return 0;
+  case p_print_err:
+    out.flush();
+    std::cerr << string_value(args[0]);
+    return 0;
+  case p_print_int:
+    out << args[0];
+    return 0;
+  case p_flush:
+    out.flush();
+    return 0;
+  case p_getchar: {
+    out.flush();
+    const int c = std::cin.get();
+    return make_string(c == EOF ? std::string() : std::string(1, char(c)));
+  }
+  case p_ord: {
+    const boost::string_view s = string_value(args[0]);
+    return s.empty() ? -1 : int32_t((unsigned char)s[0]);
+  }
+  case p_chr:
+    if (args[0] < 0 || args[0] > 255)
+      runtime_error(out, loc, "chr: character out of range");
+    return make_string(std::string(1, char(args[0])));
+  case p_size:
+    return string_value(args[0]).size();
+  case p_substring: {
+    const boost::string_view s = string_value(args[0]);
+    const int32_t first = args[1], n = args[2];
+    if (first < 0 || n < 0 || int64_t(first) + n > int64_t(s.size()))
+      runtime_error(out, loc, "substring: out of bounds");
+    return make_string(s.substr(first, n).to_string());
+  }
+  case p_concat:
+    return make_string(string_value(args[0]).to_string() +
+                       string_value(args[1]).to_string());
+  case p_strcmp: {
+    const int c = string_value(args[0]).compare(string_value(args[1]));
+    return (c > 0) - (c < 0);
+  }
+  case p_streq:
+    return args[0] == args[1];
+  case p_not:
+    return !args[0];
+  case p_exit:
+    throw Exit{args[0]};
+  }
+  assert(false);
+  return 0;
+}
+
+} // namespace eval
+} // namespace ast
@@ -0,0 +1,76 @@
+#ifndef RUNTIME_HH
+#define RUNTIME_HH
+
+#include <cstdint>
+#include <string>
+
+#include <boost/optional.hpp>
+#include <boost/utility/string_view.hpp>
+
+#include "../ast/nodes.hh"
+#include "../utils/output_buffer.hh"
+
+namespace ast {
+namespace eval {
+
+// The runtime shared by the engines executing Tiger programs. Every value
+// is an int32_t: strings are represented by the identifier of the symbol
+// holding their characters, so that strings built at runtime are interned
+// and never released, and equal strings have equal values.
+
+enum Primitive {
+  p_print,
+  p_print_err,
+  p_print_int,
+  p_flush,
+  p_getchar,
+  p_ord,
+  p_chr,
+  p_size,
+  p_substring,
+  p_concat,
+  p_strcmp,
+  p_streq,
+  p_not,
+  p_exit
+};
+
+// The primitive implementing the external function decl, if any.
+boost::optional<Primitive> find_primitive(const FunDecl &decl);
+
+// Thrown by exit() to unwind the execution of the program.
+struct Exit {
+  int32_t status;
+};
+
+// Call p with args, writing to out. loc is the location of the call, used
+// in runtime errors.
+int32_t call_primitive(Primitive p, const int32_t *args,
+                       utils::OutputBuffer &out, const SourceLoc &loc);
+
+inline boost::string_view string_value(int32_t value) {
+  return Symbol::from_id(value).get();
+}
+
+inline int32_t make_string(const std::string &s) {
+  return Symbol(s).get_id();
+}
+
+// Flush out, then report a fatal error at loc.
+[[noreturn]] void runtime_error(utils::OutputBuffer &out, const SourceLoc &loc,
+                                const std::string &m);
+
+// Division, which wraps around on overflow like the other operators.
+inline int32_t divide(int32_t l, int32_t r, utils::OutputBuffer &out,
+                      const SourceLoc &loc) {
+  if (!r)
+    runtime_error(out, loc, "division by zero");
+  if (l == INT32_MIN && r == -1)
+    return INT32_MIN;
+  return l / r;
+}
+
+} // namespace eval
+} // namespace ast
+
+#endif // RUNTIME_HH
@@ -0,0 +1,189 @@
+#include <algorithm>
+
+#include "ir.hh"
+#include "../utils/output_buffer.hh"
+
+namespace ir {
+
+const char *const opcode_names[op_count] = {
+#define IR_NAME(name) #name,
+    IR_OPCODES(IR_NAME)
+#undef IR_NAME
+};
+
+int Function::add_block() {
+  blocks.emplace_back();
+  return blocks.size() - 1;
+}
+
+int Function::add(int block, Opcode op, ast::Type type,
+                  const std::vector<int> &operands) {
+  const int value = instrs.size();
+  instrs.push_back(
+      Instr{op, type, block, 0, utils::Symbol(), nullptr, nullptr, operands});
+  forward.push_back(value);
+  auto &list = blocks[block].instrs;
+  if (op == op_phi || op == op_undef)
+    list.insert(list.begin(), value);
+  else
+    list.push_back(value);
+  return value;
+}
+
+void Function::add_edge(int from, int to) {
+  blocks[from].succs.push_back(to);
+  blocks[to].preds.push_back(from);
+}
+
+void Function::remove_edge(int from, int to) {
+  auto &succs = blocks[from].succs;
+  succs.erase(std::find(succs.begin(), succs.end(), to));
+  auto &preds = blocks[to].preds;
+  const auto pred = std::find(preds.begin(), preds.end(), from);
+  const size_t rank = pred - preds.begin();
+  preds.erase(pred);
+  for (auto i : blocks[to].instrs)
+    if (instrs[i].op == op_phi && instrs[i].block == to)
+      instrs[i].operands.erase(instrs[i].operands.begin() + rank);
+}
+
+int Function::resolve(int value) {
+  int root = value;
+  while (forward[root] != root)
+    root = forward[root];
+  while (forward[value] != root) {
+    const int next = forward[value];
+    forward[value] = root;
+    value = next;
+  }
+  return root;
+}
+
+void Function::replace(int value, int with) {
+  forward[value] = resolve(with);
+  remove(value);
+}
+
+size_t Function::remove_unreachable_blocks() {
+  std::vector<bool> reached(blocks.size());
+  std::vector<int> todo(1, 0);
+  reached[0] = true;
+  while (!todo.empty()) {
+    const int b = todo.back();
+    todo.pop_back();
+    for (auto s : blocks[b].succs)
+      if (!reached[s]) {
+        reached[s] = true;
+        todo.push_back(s);
+      }
+  }
+  // Unreachable blocks only have unreachable predecessors, so they have
+  // none left once the edges leaving them are removed.
+  for (size_t b = 0; b < blocks.size(); b++)
+    if (!reached[b])
+      while (!blocks[b].succs.empty())
+        remove_edge(b, blocks[b].succs.back());
+  size_t removed = 0;
+  for (size_t b = 0; b < blocks.size(); b++) {
+    if (reached[b] || blocks[b].removed)
+      continue;
+    for (auto i : blocks[b].instrs)
+      remove(i);
+    removed += blocks[b].instrs.size();
+    blocks[b].instrs.clear();
+    blocks[b].removed = true;
+  }
+  return removed;
+}
+
+void Function::compact() {
+  for (size_t b = 0; b < blocks.size(); b++) {
+    auto &list = blocks[b].instrs;
+    list.erase(std::remove_if(list.begin(), list.end(),
+                              [&](int i) { return instrs[i].block != int(b); }),
+               list.end());
+    for (auto i : list)
+      for (auto &operand : instrs[i].operands)
+        operand = resolve(operand);
+  }
+}
+
+size_t Function::instruction_count() const {
+  size_t n = 0;
+  for (auto &block : blocks)
+    n += block.instrs.size();
+  return n;
+}
+
+namespace {
+
+void dump_operands(utils::OutputBuffer &out, const Instr &instr,
+                   size_t first) {
+  for (size_t i = first; i < instr.operands.size(); i++)
+    out << (i > first ? ", %" : "%") << int32_t(instr.operands[i]);
+}
+
+void dump(utils::OutputBuffer &out, const Function &f, int value) {
+  const Instr &instr = f.instrs[value];
+  out << "    ";
+  if (instr.type != ast::t_void)
+    out << '%' << int32_t(value) << " = ";
+  out << opcode_names[instr.op];
+  switch (instr.op) {
+  case op_const:
+  case op_param:
+    out << ' ' << instr.value;
+    break;
+  case op_string:
+    out << " \"" << instr.string << '"';
+    break;
+  case op_load:
+    out << ' ' << instr.var->name << ' ' << instr.value;
+    break;
+  case op_store:
+    out << ' ' << instr.var->name << ' ' << instr.value << ", ";
+    dump_operands(out, instr, 0);
+    break;
+  case op_call:
+    out << ' ' << instr.callee->get_external_name() << '(';
+    dump_operands(out, instr, 0);
+    out << ')';
+    break;
+  default:
+    if (!instr.operands.empty()) {
+      out << ' ';
+      dump_operands(out, instr, 0);
+    }
+  }
+  out << '\n';
+}
+
+} // namespace
+
+// Blocks are listed with their predecessors, and end with the successors
+// their terminator goes to.
+void dump(const Module &module, std::ostream &o) {
+  utils::OutputBuffer out(o);
+  for (auto &f : module.functions) {
+    out << "function " << f.decl->get_external_name() << '\n';
+    for (size_t b = 0; b < f.blocks.size(); b++) {
+      const Block &block = f.blocks[b];
+      if (block.removed)
+        continue;
+      out << "  b" << int32_t(b) << ':';
+      for (size_t i = 0; i < block.preds.size(); i++)
+        out << (i ? ", b" : " <- b") << int32_t(block.preds[i]);
+      out << '\n';
+      for (auto i : block.instrs)
+        dump(out, f, i);
+      if (!block.succs.empty()) {
+        out << "    ->";
+        for (auto s : block.succs)
+          out << " b" << int32_t(s);
+        out << '\n';
+      }
+    }
+  }
+}
+
+} // namespace ir
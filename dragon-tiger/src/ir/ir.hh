@@ -0,0 +1,140 @@
+#ifndef IR_HH
+#define IR_HH
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "../ast/nodes.hh"
+#include "../utils/symbols.hh"
+
+namespace ir {
+
+// A mid-level representation of a bound and typed program: each function
+// is a control-flow graph of basic blocks, whose instructions compute
+// values in SSA form. Blocks and instructions are stored in arrays of the
+// function, and refer to each other by index; the index of an instruction
+// is the name of its value, written %n.
+//
+// Variables of the function which do not escape become values. The others,
+// and those of the enclosing functions, live in frames as in the AST: they
+// are read and written by load and store, which follow a number of static
+// links.
+//
+//   const k              the integer k
+//   string s             the string literal s
+//   undef                any value, read in unreachable code
+//   param i              parameter i of the function
+//   add ... div a, b     arithmetic, div failing on division by zero
+//   eq ... ge a, b       1 if a cmp b, 0 otherwise, on integers or strings
+//   load v h             variable v of the frame h links up
+//   store v h, a         write a into variable v of the frame h links up
+//   call f(a...)         call f, a function or a primitive
+//   phi a...             the operand coming from the predecessor of the
+//                        same rank
+//   jump                 go to the successor of the block
+//   branch a             go to the first successor if a is not zero, to
+//                        the second otherwise
+//   ret [a]              return from the function
+//
+// Phis come first in their block, and each block ends with exactly one of
+// jump, branch and ret.
+
+#define IR_OPCODES(X)                                                          \
+  X(const)                                                                     \
+  X(string)                                                                    \
+  X(undef)                                                                     \
+  X(param)                                                                     \
+  X(add)                                                                       \
+  X(sub)                                                                       \
+  X(mul)                                                                       \
+  X(div)                                                                       \
+  X(eq)                                                                        \
+  X(ne)                                                                        \
+  X(lt)                                                                        \
+  X(le)                                                                        \
+  X(gt)                                                                        \
+  X(ge)                                                                        \
+  X(load)                                                                      \
+  X(store)                                                                     \
+  X(call)                                                                      \
+  X(phi)                                                                       \
+  X(jump)                                                                      \
+  X(branch)                                                                    \
+  X(ret)
+
+enum Opcode {
+#define IR_ENUM(name) op_##name,
+  IR_OPCODES(IR_ENUM)
+#undef IR_ENUM
+      op_count
+};
+
+extern const char *const opcode_names[op_count];
+
+struct Instr {
+  Opcode op;
+  // t_void for instructions without a value.
+  ast::Type type;
+  // The block of the instruction, -1 once it is removed.
+  int block;
+  // The constant of const, the index of param, the links of load and
+  // store.
+  int32_t value;
+  utils::Symbol string;
+  const ast::VarDecl *var;
+  const ast::FunDecl *callee;
+  std::vector<int> operands;
+};
+
+struct Block {
+  std::vector<int> instrs;
+  std::vector<int> preds, succs;
+  bool removed = false;
+};
+
+struct Function {
+  const ast::FunDecl *decl;
+  // Block 0 is the entry.
+  std::vector<Block> blocks;
+  std::vector<Instr> instrs;
+  // The value standing for each instruction: itself, unless it was
+  // replaced. Use resolve() to follow replacements.
+  std::vector<int> forward;
+
+  explicit Function(const ast::FunDecl &_decl) : decl(&_decl) {}
+
+  int add_block();
+  // Append an instruction to block, or insert it first if it is a phi or
+  // an undef, and return its value.
+  int add(int block, Opcode op, ast::Type type,
+          const std::vector<int> &operands = std::vector<int>());
+  void add_edge(int from, int to);
+  // Remove the edge, and the operands of the phis of to coming from it.
+  void remove_edge(int from, int to);
+
+  int resolve(int value);
+  // Make the users of value use with instead, and remove value.
+  void replace(int value, int with);
+  // Mark the instruction as removed. It leaves its block at the next
+  // compact().
+  void remove(int value) { instrs[value].block = -1; }
+  // Remove the blocks unreachable from the entry, with their edges.
+  size_t remove_unreachable_blocks();
+  // Drop removed instructions from their blocks, and resolve operands.
+  void compact();
+
+  size_t instruction_count() const;
+};
+
+// The functions of a program, main first.
+struct Module {
+  std::vector<Function> functions;
+};
+
+// Write a listing of module to o.
+void dump(const Module &module, std::ostream &o);
+
+} // namespace ir
+
+#endif // IR_HH
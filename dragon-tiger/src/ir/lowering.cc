@@ -0,0 +1,299 @@
+#include <unordered_map>
+
+#include "lowering.hh"
+#include "../ast/traversal.hh"
+
+using namespace ast;
+
+namespace ir {
+
+namespace {
+
+class FunctionLowering : public ConstASTIntVisitor {
+  Function &f;
+  const FunDecl &decl;
+  // The block instructions are appended to.
+  int current = 0;
+  std::vector<bool> sealed;
+  // The value of each variable at the end of each block, and the phis
+  // waiting for a block to be sealed.
+  std::vector<std::unordered_map<const VarDecl *, int>> defs;
+  std::vector<std::vector<std::pair<const VarDecl *, int>>> incomplete;
+  // The block following each loop.
+  std::unordered_map<const Loop *, int> exits;
+
+  int new_block() {
+    sealed.push_back(false);
+    defs.emplace_back();
+    incomplete.emplace_back();
+    return f.add_block();
+  }
+
+  void seal(int block) {
+    for (auto &p : incomplete[block])
+      add_phi_operands(p.first, p.second);
+    incomplete[block].clear();
+    sealed[block] = true;
+  }
+
+  void jump(int to) {
+    f.add(current, op_jump, t_void);
+    f.add_edge(current, to);
+  }
+
+  void branch(int condition, int then_block, int else_block) {
+    f.add(current, op_branch, t_void, {condition});
+    f.add_edge(current, then_block);
+    f.add_edge(current, else_block);
+  }
+
+  // Variables escaping or declared by enclosing functions stay in frames.
+  bool in_frame(const VarDecl &var) const {
+    return var.get_escapes() || var.get_depth() != decl.get_depth();
+  }
+
+  int read(const VarDecl &var, int depth) {
+    if (in_frame(var)) {
+      const int value = f.add(current, op_load, var.get_type());
+      f.instrs[value].var = &var;
+      f.instrs[value].value = depth - var.get_depth();
+      return value;
+    }
+    return read_variable(&var, current);
+  }
+
+  void write(const VarDecl &var, int depth, int value) {
+    if (in_frame(var)) {
+      const int store = f.add(current, op_store, t_void, {value});
+      f.instrs[store].var = &var;
+      f.instrs[store].value = depth - var.get_depth();
+    } else
+      defs[current][&var] = value;
+  }
+
+  int read_variable(const VarDecl *var, int block) {
+    auto def = defs[block].find(var);
+    if (def != defs[block].end())
+      return f.resolve(def->second);
+    const auto &preds = f.blocks[block].preds;
+    int value;
+    if (!sealed[block]) {
+      value = f.add(block, op_phi, var->get_type());
+      incomplete[block].push_back(std::make_pair(var, value));
+    } else if (preds.size() == 1)
+      value = read_variable(var, preds[0]);
+    else if (preds.empty())
+      value = f.add(block, op_undef, var->get_type());
+    else {
+      value = f.add(block, op_phi, var->get_type());
+      defs[block][var] = value;
+      value = add_phi_operands(var, value);
+    }
+    defs[block][var] = value;
+    return value;
+  }
+
+  int add_phi_operands(const VarDecl *var, int phi) {
+    const int block = f.instrs[phi].block;
+    for (auto pred : f.blocks[block].preds) {
+      const int operand = read_variable(var, pred);
+      f.instrs[phi].operands.push_back(operand);
+    }
+    return remove_trivial_phi(phi);
+  }
+
+  // A phi whose operands are all the same value, or itself, is that value.
+  int remove_trivial_phi(int phi) {
+    int same = -1;
+    for (auto operand : f.instrs[phi].operands) {
+      operand = f.resolve(operand);
+      if (operand == same || operand == phi)
+        continue;
+      if (same >= 0)
+        return phi;
+      same = operand;
+    }
+    if (same < 0)
+      same = f.add(f.instrs[phi].block, op_undef, f.instrs[phi].type);
+    f.replace(phi, same);
+    return same;
+  }
+
+  int lower(const Expr &e) { return e.accept(*this); }
+
+public:
+  FunctionLowering(Function &_f) : f(_f), decl(*_f.decl) {}
+
+  void run() {
+    new_block();
+    seal(0);
+    const auto &params = decl.get_params();
+    for (size_t i = 0; i < params.size(); i++) {
+      const int value = f.add(0, op_param, params[i]->get_type());
+      f.instrs[value].value = i;
+      write(*params[i], decl.get_depth(), value);
+    }
+    const int result = lower(*decl.get_expr());
+    if (result >= 0 && decl.get_type() != t_void)
+      f.add(current, op_ret, t_void, {result});
+    else
+      f.add(current, op_ret, t_void);
+    f.compact();
+  }
+
+  virtual int32_t visit(const IntegerLiteral &literal) {
+    const int value = f.add(current, op_const, t_int);
+    f.instrs[value].value = literal.value;
+    return value;
+  }
+
+  virtual int32_t visit(const StringLiteral &literal) {
+    const int value = f.add(current, op_string, t_string);
+    f.instrs[value].string = literal.value;
+    return value;
+  }
+
+  virtual int32_t visit(const BinaryOperator &binop) {
+    static const Opcode opcodes[] = {op_add, op_sub, op_mul, op_div,
+                                     op_eq,  op_ne,  op_lt,  op_le,
+                                     op_gt,  op_ge};
+    const int left = lower(binop.get_left());
+    const int right = lower(binop.get_right());
+    return f.add(current, opcodes[binop.op], t_int, {left, right});
+  }
+
+  virtual int32_t visit(const Sequence &seq) {
+    int value = -1;
+    for (auto expr : seq.get_exprs())
+      value = lower(*expr);
+    return value;
+  }
+
+  // Nested functions are lowered on their own.
+  virtual int32_t visit(const Let &let) {
+    for (auto d : let.get_decls())
+      if (d->kind == k_var_decl)
+        d->accept(*this);
+    return lower(let.get_sequence());
+  }
+
+  virtual int32_t visit(const Identifier &id) {
+    return read(*id.get_decl(), id.get_depth());
+  }
+
+  virtual int32_t visit(const IfThenElse &ite) {
+    const int condition = lower(ite.get_condition());
+    const int then_block = new_block(), else_block = new_block(),
+              join = new_block();
+    branch(condition, then_block, else_block);
+    seal(then_block);
+    seal(else_block);
+    current = then_block;
+    const int then_value = lower(ite.get_then_part());
+    jump(join);
+    current = else_block;
+    const int else_value = lower(ite.get_else_part());
+    jump(join);
+    seal(join);
+    current = join;
+    if (ite.get_type() == t_void)
+      return -1;
+    if (then_value == else_value)
+      return then_value;
+    return f.add(join, op_phi, ite.get_type(), {then_value, else_value});
+  }
+
+  virtual int32_t visit(const VarDecl &var) {
+    write(var, decl.get_depth(), lower(*var.get_expr()));
+    return -1;
+  }
+
+  virtual int32_t visit(const FunDecl &) { return -1; }
+
+  virtual int32_t visit(const FunCall &call) {
+    std::vector<int> args;
+    for (auto arg : call.get_args())
+      args.push_back(lower(*arg));
+    const int value = f.add(current, op_call, call.get_type(), args);
+    f.instrs[value].callee = &*call.get_decl();
+    return call.get_type() == t_void ? -1 : value;
+  }
+
+  virtual int32_t visit(const WhileLoop &loop) {
+    const int header = new_block();
+    jump(header);
+    current = header;
+    const int condition = lower(loop.get_condition());
+    const int body = new_block(), exit = new_block();
+    exits[&loop] = exit;
+    branch(condition, body, exit);
+    seal(body);
+    current = body;
+    lower(loop.get_body());
+    jump(header);
+    seal(header);
+    seal(exit);
+    current = exit;
+    return -1;
+  }
+
+  // The loop stops before incrementing the variable past the bound, which
+  // may be the largest integer.
+  virtual int32_t visit(const ForLoop &loop) {
+    const VarDecl &var = loop.get_variable();
+    const int depth = decl.get_depth();
+    write(var, depth, lower(*var.get_expr()));
+    const int high = lower(loop.get_high());
+    const int body = new_block(), exit = new_block();
+    exits[&loop] = exit;
+    branch(f.add(current, op_gt, t_int, {read(var, depth), high}), exit,
+           body);
+    current = body;
+    lower(loop.get_body());
+    const int next = new_block();
+    branch(f.add(current, op_eq, t_int, {read(var, depth), high}), exit,
+           next);
+    seal(next);
+    current = next;
+    const int one = f.add(current, op_const, t_int);
+    f.instrs[one].value = 1;
+    write(var, depth, f.add(current, op_add, t_int, {read(var, depth), one}));
+    jump(body);
+    seal(body);
+    seal(exit);
+    current = exit;
+    return -1;
+  }
+
+  // What follows a break is lowered into a block without predecessors.
+  virtual int32_t visit(const Break &b) {
+    jump(exits.at(&*b.get_loop()));
+    current = new_block();
+    seal(current);
+    return -1;
+  }
+
+  virtual int32_t visit(const Assign &assign) {
+    const Identifier &lhs = assign.get_lhs();
+    write(*lhs.get_decl(), lhs.get_depth(), lower(assign.get_rhs()));
+    return -1;
+  }
+};
+
+} // namespace
+
+Module lower(const FunDecl &main) {
+  Module module;
+  walk(main,
+       [&](const Node &node) {
+         if (node.kind == k_fun_decl &&
+             !static_cast<const FunDecl &>(node).is_external)
+           module.functions.emplace_back(static_cast<const FunDecl &>(node));
+       },
+       [](const Node &) {});
+  for (auto &f : module.functions)
+    FunctionLowering(f).run();
+  return module;
+}
+
+} // namespace ir
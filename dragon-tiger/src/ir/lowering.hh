@@ -0,0 +1,18 @@
+#ifndef IR_LOWERING_HH
+#define IR_LOWERING_HH
+
+#include "../ast/nodes.hh"
+#include "ir.hh"
+
+namespace ir {
+
+// Lower the program whose main function was returned by the binder, once
+// types are checked. The SSA form is built while lowering, as in Braun et
+// al., "Simple and Efficient Construction of Static Single Assignment
+// Form": a block is sealed once all its predecessors are known, and phis
+// reading variables in blocks not yet sealed are completed then.
+Module lower(const ast::FunDecl &main);
+
+} // namespace ir
+
+#endif // IR_LOWERING_HH
@@ -0,0 +1,31 @@
+#include <chrono>
+
+#include "pass_manager.hh"
+
+namespace ir {
+
+void PassManager::add(const std::string &name,
+                      std::function<size_t(Function &)> run) {
+  passes.push_back(Pass{name, std::move(run), 0, 0});
+}
+
+void PassManager::run(Module &module) {
+  for (auto &pass : passes) {
+    const auto start = std::chrono::steady_clock::now();
+    for (auto &f : module.functions) {
+      pass.changes += pass.run(f);
+      f.compact();
+    }
+    pass.seconds += std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  }
+}
+
+void PassManager::report(std::ostream &o) const {
+  for (auto &pass : passes)
+    o << "ir " << pass.name << ": " << pass.changes << " changes in "
+      << pass.seconds * 1000 << " ms" << std::endl;
+}
+
+} // namespace ir
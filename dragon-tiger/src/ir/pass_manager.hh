@@ -0,0 +1,35 @@
+#ifndef IR_PASS_MANAGER_HH
+#define IR_PASS_MANAGER_HH
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ir.hh"
+
+namespace ir {
+
+// A sequence of passes run on every function of a module, which records
+// the time each pass takes and the changes it makes.
+class PassManager {
+  struct Pass {
+    std::string name;
+    std::function<size_t(Function &)> run;
+    size_t changes;
+    double seconds;
+  };
+  std::vector<Pass> passes;
+
+public:
+  // Add a pass, run after those already added. A pass may appear several
+  // times.
+  void add(const std::string &name, std::function<size_t(Function &)> run);
+  void run(Module &module);
+  // Write a line for each pass run, with its changes and time.
+  void report(std::ostream &o) const;
+};
+
+} // namespace ir
+
+#endif // IR_PASS_MANAGER_HH
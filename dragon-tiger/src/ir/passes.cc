@@ -0,0 +1,439 @@
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "passes.hh"
+
+namespace ir {
+
+namespace {
+
+// The users of each value.
+std::vector<std::vector<int>> find_users(Function &f) {
+  std::vector<std::vector<int>> users(f.instrs.size());
+  for (auto &block : f.blocks)
+    for (auto i : block.instrs)
+      for (auto operand : f.instrs[i].operands)
+        users[f.resolve(operand)].push_back(i);
+  return users;
+}
+
+bool fold(Opcode op, int32_t l, int32_t r, int32_t &result) {
+  switch (op) {
+  case op_add:
+    result = uint32_t(l) + uint32_t(r);
+    return true;
+  case op_sub:
+    result = uint32_t(l) - uint32_t(r);
+    return true;
+  case op_mul:
+    result = uint32_t(l) * uint32_t(r);
+    return true;
+  case op_div:
+    if (!r)
+      return false;
+    result = l == INT32_MIN && r == -1 ? INT32_MIN : l / r;
+    return true;
+  case op_eq:
+    result = l == r;
+    return true;
+  case op_ne:
+    result = l != r;
+    return true;
+  case op_lt:
+    result = l < r;
+    return true;
+  case op_le:
+    result = l <= r;
+    return true;
+  case op_gt:
+    result = l > r;
+    return true;
+  case op_ge:
+    result = l >= r;
+    return true;
+  default:
+    return false;
+  }
+}
+
+class ConstantPropagation {
+  // Values go down from unknown to constant to varying.
+  enum State { s_unknown, s_constant, s_varying };
+  struct Lattice {
+    State state;
+    int32_t value;
+    bool operator!=(const Lattice &other) const {
+      return state != other.state ||
+             (state == s_constant && value != other.value);
+    }
+  };
+
+  Function &f;
+  std::vector<Lattice> values;
+  std::vector<std::vector<int>> users;
+  std::vector<bool> reached;
+  std::set<std::pair<int, int>> executable;
+  std::vector<std::pair<int, int>> flow_work;
+  std::vector<int> ssa_work;
+
+  void set(int v, Lattice l) {
+    if (values[v] != l) {
+      values[v] = l;
+      ssa_work.push_back(v);
+    }
+  }
+
+  void mark(int from, int to) {
+    if (executable.insert(std::make_pair(from, to)).second)
+      flow_work.push_back(std::make_pair(from, to));
+  }
+
+  const Lattice &operand(const Instr &instr, size_t i) {
+    return values[f.resolve(instr.operands[i])];
+  }
+
+  void evaluate_phi(int v) {
+    const Instr &instr = f.instrs[v];
+    const auto &preds = f.blocks[instr.block].preds;
+    Lattice result{s_unknown, 0};
+    for (size_t i = 0; i < preds.size(); i++) {
+      if (!executable.count(std::make_pair(preds[i], instr.block)))
+        continue;
+      const Lattice &l = operand(instr, i);
+      if (l.state == s_unknown || result.state == s_varying)
+        continue;
+      if (l.state == s_varying ||
+          (result.state == s_constant && result.value != l.value))
+        result.state = s_varying;
+      else
+        result = l;
+    }
+    set(v, result);
+  }
+
+  void evaluate(int v) {
+    const Instr &instr = f.instrs[v];
+    switch (instr.op) {
+    case op_const:
+      set(v, Lattice{s_constant, instr.value});
+      return;
+    case op_phi:
+      evaluate_phi(v);
+      return;
+    case op_jump:
+      mark(instr.block, f.blocks[instr.block].succs[0]);
+      return;
+    case op_branch: {
+      const Lattice &condition = operand(instr, 0);
+      const auto &succs = f.blocks[instr.block].succs;
+      if (condition.state == s_constant)
+        mark(instr.block, succs[condition.value ? 0 : 1]);
+      else if (condition.state == s_varying) {
+        mark(instr.block, succs[0]);
+        mark(instr.block, succs[1]);
+      }
+      return;
+    }
+    case op_ret:
+    case op_store:
+      return;
+    default:
+      break;
+    }
+    if (instr.op < op_add || instr.op > op_ge) {
+      if (instr.type != ast::t_void)
+        set(v, Lattice{s_varying, 0});
+      return;
+    }
+    const Lattice &l = operand(instr, 0), &r = operand(instr, 1);
+    if (l.state == s_unknown || r.state == s_unknown)
+      return;
+    int32_t result;
+    if (l.state == s_constant && r.state == s_constant &&
+        fold(instr.op, l.value, r.value, result))
+      set(v, Lattice{s_constant, result});
+    else
+      set(v, Lattice{s_varying, 0});
+  }
+
+  void reach(int block) {
+    if (reached[block]) {
+      for (auto i : f.blocks[block].instrs)
+        if (f.instrs[i].op == op_phi)
+          evaluate(i);
+      return;
+    }
+    reached[block] = true;
+    for (auto i : f.blocks[block].instrs)
+      evaluate(i);
+  }
+
+  size_t rewrite() {
+    size_t changes = 0;
+    for (size_t b = 0; b < f.blocks.size(); b++) {
+      auto &list = f.blocks[b].instrs;
+      if (!reached[b] || list.empty())
+        continue;
+      for (auto i : list) {
+        Instr &instr = f.instrs[i];
+        if (values[i].state != s_constant || instr.op == op_const)
+          continue;
+        instr.op = op_const;
+        instr.value = values[i].value;
+        instr.operands.clear();
+        changes++;
+      }
+      std::stable_partition(list.begin(), list.end(), [&](int i) {
+        return f.instrs[i].op == op_phi || f.instrs[i].op == op_undef;
+      });
+      Instr &last = f.instrs[list.back()];
+      const auto succs = f.blocks[b].succs;
+      if (last.op != op_branch || succs[0] == succs[1])
+        continue;
+      const Lattice &condition = operand(last, 0);
+      if (condition.state != s_constant)
+        continue;
+      f.remove_edge(b, succs[condition.value ? 1 : 0]);
+      last.op = op_jump;
+      last.operands.clear();
+      changes++;
+    }
+    return changes + f.remove_unreachable_blocks();
+  }
+
+public:
+  explicit ConstantPropagation(Function &_f)
+      : f(_f), values(f.instrs.size(), Lattice{s_unknown, 0}),
+        users(find_users(f)), reached(f.blocks.size()) {}
+
+  size_t run() {
+    reach(0);
+    while (!flow_work.empty() || !ssa_work.empty()) {
+      if (!flow_work.empty()) {
+        const int to = flow_work.back().second;
+        flow_work.pop_back();
+        reach(to);
+        continue;
+      }
+      const int v = ssa_work.back();
+      ssa_work.pop_back();
+      for (auto user : users[v])
+        if (f.instrs[user].block >= 0 && reached[f.instrs[user].block])
+          evaluate(user);
+    }
+    return rewrite();
+  }
+};
+
+bool has_effect(Function &f, const Instr &instr) {
+  switch (instr.op) {
+  case op_call:
+  case op_store:
+  case op_jump:
+  case op_branch:
+  case op_ret:
+    return true;
+  case op_div: {
+    const Instr &divisor = f.instrs[f.resolve(instr.operands[1])];
+    return divisor.op != op_const || !divisor.value;
+  }
+  default:
+    return false;
+  }
+}
+
+// The immediate dominator of each block reachable from the entry, found
+// with the algorithm of Cooper, Harvey and Kennedy, and -1 for the others.
+std::vector<int> find_dominators(const Function &f) {
+  const int n = f.blocks.size();
+  // Postorder of a depth-first search from the entry.
+  std::vector<int> postorder, number(n, -1);
+  std::vector<std::pair<int, size_t>> stack(1, std::make_pair(0, 0));
+  std::vector<bool> seen(n);
+  seen[0] = true;
+  while (!stack.empty()) {
+    auto &top = stack.back();
+    const auto &succs = f.blocks[top.first].succs;
+    if (top.second < succs.size()) {
+      const int s = succs[top.second++];
+      if (!seen[s]) {
+        seen[s] = true;
+        stack.push_back(std::make_pair(s, 0));
+      }
+      continue;
+    }
+    number[top.first] = postorder.size();
+    postorder.push_back(top.first);
+    stack.pop_back();
+  }
+  std::vector<int> idom(n, -1);
+  idom[0] = 0;
+  auto intersect = [&](int a, int b) {
+    while (a != b) {
+      while (number[a] < number[b])
+        a = idom[a];
+      while (number[b] < number[a])
+        b = idom[b];
+    }
+    return a;
+  };
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (auto b = postorder.rbegin(); b != postorder.rend(); b++) {
+      if (*b == 0)
+        continue;
+      int dom = -1;
+      for (auto p : f.blocks[*b].preds)
+        if (idom[p] >= 0)
+          dom = dom < 0 ? p : intersect(p, dom);
+      if (idom[*b] != dom) {
+        idom[*b] = dom;
+        changed = true;
+      }
+    }
+  }
+  return idom;
+}
+
+bool is_commutative(Opcode op) {
+  return op == op_add || op == op_mul || op == op_eq || op == op_ne;
+}
+
+// Values are numbered walking the dominator tree in preorder, with a table
+// of the expressions available in the blocks dominating the current one.
+class ValueNumbering {
+  typedef std::vector<int64_t> Key;
+
+  Function &f;
+  std::map<Key, int> available;
+  size_t changes = 0;
+
+  // Whether the phi has a single operand other than itself, then replaced.
+  bool remove_trivial_phi(int phi) {
+    int same = -1;
+    for (auto operand : f.instrs[phi].operands) {
+      operand = f.resolve(operand);
+      if (operand == same || operand == phi)
+        continue;
+      if (same >= 0)
+        return false;
+      same = operand;
+    }
+    if (same < 0)
+      return false;
+    f.replace(phi, same);
+    return true;
+  }
+
+  // Number the pure instructions of block, and return the keys added.
+  std::vector<Key> number(int block) {
+    std::vector<Key> added;
+    for (auto i : f.blocks[block].instrs) {
+      Instr &instr = f.instrs[i];
+      if (instr.op == op_phi && remove_trivial_phi(i)) {
+        changes++;
+        continue;
+      }
+      if (instr.op == op_undef || (instr.op >= op_load && instr.op != op_phi))
+        continue;
+      Key key{instr.op, instr.type, instr.value, instr.string.get_id(),
+              instr.op == op_phi ? block : -1};
+      std::vector<int> operands;
+      for (auto operand : instr.operands)
+        operands.push_back(f.resolve(operand));
+      if (is_commutative(instr.op))
+        std::sort(operands.begin(), operands.end());
+      key.insert(key.end(), operands.begin(), operands.end());
+      auto found = available.find(key);
+      if (found != available.end()) {
+        f.replace(i, found->second);
+        changes++;
+        continue;
+      }
+      available[key] = i;
+      added.push_back(std::move(key));
+    }
+    return added;
+  }
+
+public:
+  explicit ValueNumbering(Function &_f) : f(_f) {}
+
+  size_t run() {
+    const std::vector<int> idom = find_dominators(f);
+    std::vector<std::vector<int>> children(f.blocks.size());
+    for (size_t b = 1; b < f.blocks.size(); b++)
+      if (idom[b] >= 0)
+        children[idom[b]].push_back(b);
+    // A block is left once the blocks it dominates are numbered.
+    struct Entry {
+      int block;
+      bool leave;
+    };
+    std::vector<Entry> stack(1, Entry{0, false});
+    std::vector<std::vector<Key>> scopes;
+    while (!stack.empty()) {
+      const Entry entry = stack.back();
+      stack.pop_back();
+      if (entry.leave) {
+        for (auto &key : scopes.back())
+          available.erase(key);
+        scopes.pop_back();
+        continue;
+      }
+      scopes.push_back(number(entry.block));
+      stack.push_back(Entry{entry.block, true});
+      for (auto child : children[entry.block])
+        stack.push_back(Entry{child, false});
+    }
+    return changes;
+  }
+};
+
+} // namespace
+
+size_t propagate_constants(Function &f) {
+  return ConstantPropagation(f).run();
+}
+
+size_t eliminate_dead_code(Function &f) {
+  std::vector<bool> live(f.instrs.size());
+  std::vector<int> work;
+  for (auto &block : f.blocks)
+    for (auto i : block.instrs)
+      if (f.instrs[i].block >= 0 && has_effect(f, f.instrs[i])) {
+        live[i] = true;
+        work.push_back(i);
+      }
+  while (!work.empty()) {
+    const int i = work.back();
+    work.pop_back();
+    for (auto operand : f.instrs[i].operands) {
+      operand = f.resolve(operand);
+      if (!live[operand]) {
+        live[operand] = true;
+        work.push_back(operand);
+      }
+    }
+  }
+  size_t removed = 0;
+  for (auto &block : f.blocks)
+    for (auto i : block.instrs)
+      if (f.instrs[i].block >= 0 && !live[i]) {
+        f.remove(i);
+        removed++;
+      }
+  return removed;
+}
+
+size_t number_values(Function &f) { return ValueNumbering(f).run(); }
+
+void add_default_passes(PassManager &manager) {
+  manager.add("sccp", propagate_constants);
+  manager.add("dce", eliminate_dead_code);
+  manager.add("gvn", number_values);
+  manager.add("dce", eliminate_dead_code);
+}
+
+} // namespace ir
@@ -0,0 +1,35 @@
+#ifndef IR_PASSES_HH
+#define IR_PASSES_HH
+
+#include <cstddef>
+
+#include "ir.hh"
+#include "pass_manager.hh"
+
+namespace ir {
+
+// Each pass returns the number of changes it made to the function.
+
+// Sparse conditional constant propagation (Wegman and Zadeck): values are
+// assumed constant until proven otherwise, and blocks unreachable until a
+// reachable branch may go to them. Constant values become const, branches
+// on constants become jumps, and blocks never reached are removed.
+// Arithmetic wraps around as in the other backends.
+size_t propagate_constants(Function &f);
+
+// Remove the instructions whose value is not used, unless they have an
+// effect: calls, stores, terminators and divisions which may fail.
+size_t eliminate_dead_code(Function &f);
+
+// Global value numbering: an operation computing the same value as one in
+// a dominating block is replaced by it. Phis whose operands are all the
+// same value are replaced by that value.
+size_t number_values(Function &f);
+
+// Constant propagation, then value numbering, each followed by the
+// removal of dead code.
+void add_default_passes(PassManager &manager);
+
+} // namespace ir
+
+#endif // IR_PASSES_HH
@@ -0,0 +1,212 @@
+#include <cassert>
+
+#include "assembler.hh"
+
+namespace jit {
+
+void Assembler::dword(uint32_t d) {
+  for (int i = 0; i < 4; i++)
+    byte(d >> (8 * i));
+}
+
+void Assembler::qword(uint64_t q) {
+  for (int i = 0; i < 8; i++)
+    byte(q >> (8 * i));
+}
+
+// The REX prefix, when one is needed to reach 64-bit operands or r8-r15.
+void Assembler::rex(bool w, int reg, int rm) {
+  const uint8_t prefix = 0x40 | w << 3 | (reg >> 3) << 2 | (rm >> 3);
+  if (prefix != 0x40)
+    byte(prefix);
+}
+
+void Assembler::mem(int reg, Reg base, int32_t disp) {
+  assert((base & 7) != rsp);
+  byte(0x80 | (reg & 7) << 3 | (base & 7));
+  dword(disp);
+}
+
+void Assembler::rel32(Label &label) {
+  if (label.position == -1) {
+    label.fixups.push_back(code.size());
+    dword(0);
+  } else
+    dword(label.position - int64_t(code.size() + 4));
+}
+
+void Assembler::bind(Label &label) {
+  assert(label.position == -1);
+  label.position = code.size();
+  for (auto fixup : label.fixups) {
+    const uint32_t rel = label.position - int64_t(fixup + 4);
+    for (int i = 0; i < 4; i++)
+      code[fixup + i] = rel >> (8 * i);
+  }
+  label.fixups.clear();
+}
+
+void Assembler::mov(Reg dst, Reg src) {
+  rex(false, src, dst);
+  byte(0x89);
+  modrm(src, dst);
+}
+
+void Assembler::mov(Reg dst, int32_t imm) {
+  rex(false, 0, dst);
+  byte(0xb8 + (dst & 7));
+  dword(imm);
+}
+
+void Assembler::mov64(Reg dst, Reg src) {
+  rex(true, src, dst);
+  byte(0x89);
+  modrm(src, dst);
+}
+
+void Assembler::mov64(Reg dst, uint64_t imm) {
+  rex(true, 0, dst);
+  byte(0xb8 + (dst & 7));
+  qword(imm);
+}
+
+void Assembler::load(Reg dst, Reg base, int32_t disp) {
+  rex(false, dst, base);
+  byte(0x8b);
+  mem(dst, base, disp);
+}
+
+void Assembler::load64(Reg dst, Reg base, int32_t disp) {
+  rex(true, dst, base);
+  byte(0x8b);
+  mem(dst, base, disp);
+}
+
+void Assembler::store(Reg base, int32_t disp, Reg src) {
+  rex(false, src, base);
+  byte(0x89);
+  mem(src, base, disp);
+}
+
+void Assembler::lea64(Reg dst, Reg base, int32_t disp) {
+  rex(true, dst, base);
+  byte(0x8d);
+  mem(dst, base, disp);
+}
+
+void Assembler::alu(AluOp op, Reg dst, Reg src) {
+  rex(false, src, dst);
+  byte(op << 3 | 1);
+  modrm(src, dst);
+}
+
+void Assembler::alu(AluOp op, Reg dst, int32_t imm) {
+  rex(false, 0, dst);
+  byte(0x81);
+  modrm(op, dst);
+  dword(imm);
+}
+
+void Assembler::alu(AluOp op, Reg dst, Reg base, int32_t disp) {
+  rex(false, dst, base);
+  byte(op << 3 | 3);
+  mem(dst, base, disp);
+}
+
+void Assembler::alu_mem(AluOp op, Reg base, int32_t disp, int32_t imm) {
+  rex(false, 0, base);
+  byte(0x81);
+  mem(op, base, disp);
+  dword(imm);
+}
+
+void Assembler::alu64(AluOp op, Reg dst, Reg src) {
+  rex(true, src, dst);
+  byte(op << 3 | 1);
+  modrm(src, dst);
+}
+
+void Assembler::alu64(AluOp op, Reg dst, int32_t imm) {
+  rex(true, 0, dst);
+  byte(0x81);
+  modrm(op, dst);
+  dword(imm);
+}
+
+void Assembler::imul(Reg dst, Reg src) {
+  rex(false, dst, src);
+  byte(0x0f);
+  byte(0xaf);
+  modrm(dst, src);
+}
+
+void Assembler::imul(Reg dst, Reg base, int32_t disp) {
+  rex(false, dst, base);
+  byte(0x0f);
+  byte(0xaf);
+  mem(dst, base, disp);
+}
+
+void Assembler::imul(Reg dst, int32_t imm) {
+  rex(false, dst, dst);
+  byte(0x69);
+  modrm(dst, dst);
+  dword(imm);
+}
+
+void Assembler::neg(Reg r) {
+  rex(false, 0, r);
+  byte(0xf7);
+  modrm(3, r);
+}
+
+void Assembler::idiv(Reg r) {
+  rex(false, 0, r);
+  byte(0xf7);
+  modrm(7, r);
+}
+
+// setcc on the low byte, then movzx.
+void Assembler::set(Cond c, Reg dst) {
+  assert(dst <= rbx);
+  byte(0x0f);
+  byte(0x90 + c);
+  modrm(0, dst);
+  byte(0x0f);
+  byte(0xb6);
+  modrm(dst, dst);
+}
+
+void Assembler::push(Reg r) {
+  rex(false, 0, r);
+  byte(0x50 + (r & 7));
+}
+
+void Assembler::pop(Reg r) {
+  rex(false, 0, r);
+  byte(0x58 + (r & 7));
+}
+
+void Assembler::jmp(Label &label) {
+  byte(0xe9);
+  rel32(label);
+}
+
+void Assembler::j(Cond c, Label &label) {
+  byte(0x0f);
+  byte(0x80 + c);
+  rel32(label);
+}
+
+void Assembler::call(Label &label) {
+  byte(0xe8);
+  rel32(label);
+}
+
+void Assembler::call(Reg r) {
+  rex(false, 0, r);
+  byte(0xff);
+  modrm(2, r);
+}
+
+} // namespace jit
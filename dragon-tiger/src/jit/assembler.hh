@@ -0,0 +1,119 @@
+#ifndef JIT_ASSEMBLER_HH
+#define JIT_ASSEMBLER_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace jit {
+
+// A minimal x86-64 assembler, covering the instructions used by the JIT.
+// Operations are on 32-bit registers unless their name ends with 64, and
+// memory operands are always [base + disp32], where base is neither rsp
+// nor r12 (which would need a SIB byte).
+
+enum Reg {
+  rax,
+  rcx,
+  rdx,
+  rbx,
+  rsp,
+  rbp,
+  rsi,
+  rdi,
+  r8,
+  r9,
+  r10,
+  r11,
+  r12,
+  r13,
+  r14,
+  r15
+};
+
+// Condition codes, in encoding order: a condition and its negation only
+// differ by their lowest bit.
+enum Cond {
+  c_o,
+  c_no,
+  c_b,
+  c_ae,
+  c_e,
+  c_ne,
+  c_be,
+  c_a,
+  c_s,
+  c_ns,
+  c_p,
+  c_np,
+  c_l,
+  c_ge,
+  c_le,
+  c_g
+};
+
+inline Cond negate(Cond c) { return Cond(c ^ 1); }
+
+// Arithmetic operations sharing the same encodings, by their /digit.
+enum AluOp { a_add = 0, a_or = 1, a_and = 4, a_sub = 5, a_xor = 6, a_cmp = 7 };
+
+// A position in the code, which may be used before being bound.
+struct Label {
+  int64_t position = -1;
+  // Offsets of the rel32 fields to patch when the label is bound.
+  std::vector<size_t> fixups;
+};
+
+class Assembler {
+  std::vector<uint8_t> code;
+
+  void byte(uint8_t b) { code.push_back(b); }
+  void dword(uint32_t d);
+  void qword(uint64_t q);
+  void rex(bool w, int reg, int rm);
+  void modrm(int reg, int rm) { byte(0xc0 | (reg & 7) << 3 | (rm & 7)); }
+  void mem(int reg, Reg base, int32_t disp);
+  void rel32(Label &label);
+
+public:
+  const std::vector<uint8_t> &bytes() const { return code; }
+  size_t size() const { return code.size(); }
+
+  void bind(Label &label);
+
+  void mov(Reg dst, Reg src);
+  void mov(Reg dst, int32_t imm);
+  void mov64(Reg dst, Reg src);
+  void mov64(Reg dst, uint64_t imm);
+  void load(Reg dst, Reg base, int32_t disp);
+  void load64(Reg dst, Reg base, int32_t disp);
+  void store(Reg base, int32_t disp, Reg src);
+  void lea64(Reg dst, Reg base, int32_t disp);
+
+  void alu(AluOp op, Reg dst, Reg src);
+  void alu(AluOp op, Reg dst, int32_t imm);
+  void alu(AluOp op, Reg dst, Reg base, int32_t disp);
+  void alu_mem(AluOp op, Reg base, int32_t disp, int32_t imm);
+  void alu64(AluOp op, Reg dst, Reg src);
+  void alu64(AluOp op, Reg dst, int32_t imm);
+  void imul(Reg dst, Reg src);
+  void imul(Reg dst, Reg base, int32_t disp);
+  void imul(Reg dst, int32_t imm);
+  void neg(Reg r);
+  void cdq() { byte(0x99); }
+  void idiv(Reg r);
+  // dst = 1 if c holds, 0 otherwise; dst must be rax, rcx, rdx or rbx.
+  void set(Cond c, Reg dst);
+
+  void push(Reg r);
+  void pop(Reg r);
+  void jmp(Label &label);
+  void j(Cond c, Label &label);
+  void call(Label &label);
+  void call(Reg r);
+  void ret() { byte(0xc3); }
+};
+
+} // namespace jit
+
+#endif // JIT_ASSEMBLER_HH
@@ -0,0 +1,776 @@
+#include "jit.hh"
+#include "../utils/errors.hh"
+
+#if defined(__x86_64__) && defined(__unix__)
+#define JIT_SUPPORTED
+#endif
+
+#ifdef JIT_SUPPORTED
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include <sys/mman.h>
+
+#include "assembler.hh"
+#include "../ast/traversal.hh"
+#include "../eval/runtime.hh"
+
+using namespace ast;
+
+namespace jit {
+
+namespace {
+
+enum Failure { f_division_by_zero, f_stack_overflow };
+
+// The registers given to variables, which calls preserve.
+const Reg variable_registers[] = {rbx, r12, r13, r14, r15};
+
+// Room left below the stack limit for the runtime called by the program.
+const size_t runtime_stack = 1 << 18;
+
+// Where a variable, or the bound of a for loop, lives: in a register, or
+// in the slot of the native frame of its function.
+struct Home {
+  bool in_register;
+  Reg reg;
+  int slot;
+};
+
+Cond condition_code(Operator op) {
+  static const Cond codes[] = {c_e, c_ne, c_l, c_le, c_g, c_ge};
+  return codes[op - o_eq];
+}
+
+} // namespace
+
+// The code generator. Expressions leave their value in eax; intermediate
+// values are pushed on the native stack. The frame of a function is
+//
+//   [rbp + 16 + 8 * (n - i)]  argument i of n
+//   [rbp + 16]                static link: rbp of the enclosing function
+//   [rbp + 8]                 return address
+//   [rbp]                     saved rbp
+//   [rbp - 8 * k]             saved registers used by the function
+//   below                     slots of the variables living in memory
+//
+// and rsp is 16-byte aligned at the start of its body, so the code keeps
+// count of what it pushes to call the runtime with an aligned stack.
+class Codegen : public ConstASTVisitor {
+  JIT &jit;
+  Assembler a;
+
+  struct FunctionInfo {
+    Label entry;
+    std::vector<Reg> saved;
+    int slots;
+  };
+  std::unordered_map<const FunDecl *, FunctionInfo> functions;
+  std::vector<const FunDecl *> order;
+  // Homes of variables, and of the bounds of for loops.
+  std::unordered_map<const Node *, Home> homes;
+  std::unordered_map<const VarDecl *, const FunDecl *> owners;
+
+  const FunDecl *current = nullptr;
+  bool want_value = true;
+  int pushes = 0;
+  Label overflow;
+
+  struct LoopInfo {
+    Label *end;
+    int pushes;
+  };
+  std::vector<LoopInfo> loops;
+
+  int32_t offset(const FunDecl &f, int slot) {
+    return -8 * int32_t(functions[&f].saved.size()) - 8 * (slot + 1);
+  }
+
+  // Allocate registers to the variables which do not escape.
+  void analyze(const FunDecl &main) {
+    struct State {
+      const FunDecl *decl;
+      std::vector<Reg> free;
+      std::vector<Reg> used;
+      int slots;
+    };
+    std::vector<State> stack;
+    auto allocate = [&](const Node &node, int slot) {
+      State &state = stack.back();
+      Home home{false, rax, slot};
+      if (!state.free.empty()) {
+        home = Home{true, state.free.back(), slot};
+        state.free.pop_back();
+        if (std::find(state.used.begin(), state.used.end(), home.reg) ==
+            state.used.end())
+          state.used.push_back(home.reg);
+      }
+      homes[&node] = home;
+    };
+    auto release = [&](const Node &node) {
+      const Home &home = homes[&node];
+      if (home.in_register)
+        stack.back().free.push_back(home.reg);
+    };
+
+    walk(main,
+         [&](const Node &node) {
+           switch (node.kind) {
+           case k_fun_decl: {
+             auto &decl = static_cast<const FunDecl &>(node);
+             order.push_back(&decl);
+             stack.push_back(State{&decl,
+                                   std::vector<Reg>(variable_registers,
+                                                    variable_registers + 5),
+                                   {},
+                                   decl.get_frame_size()});
+             std::reverse(stack.back().free.begin(), stack.back().free.end());
+             break;
+           }
+           case k_var_decl: {
+             auto &decl = static_cast<const VarDecl &>(node);
+             owners[&decl] = stack.back().decl;
+             if (decl.get_escapes())
+               homes[&decl] = Home{false, rax, decl.get_slot()};
+             else
+               allocate(decl, decl.get_slot());
+             break;
+           }
+           case k_for_loop:
+             allocate(node, stack.back().slots++);
+             break;
+           default:
+             break;
+           }
+         },
+         [&](const Node &node) {
+           switch (node.kind) {
+           case k_fun_decl: {
+             State &state = stack.back();
+             FunctionInfo &info = functions[state.decl];
+             std::sort(state.used.begin(), state.used.end());
+             info.saved = state.used;
+             info.slots = state.slots;
+             stack.pop_back();
+             break;
+           }
+           case k_let:
+             for (auto decl : static_cast<const Let &>(node).get_decls())
+               if (decl->kind == k_var_decl)
+                 release(*decl);
+             break;
+           case k_for_loop:
+             release(static_cast<const ForLoop &>(node).get_variable());
+             release(node);
+             break;
+           default:
+             break;
+           }
+         });
+  }
+
+  int32_t location(const SourceLoc &loc) {
+    jit.locations.push_back(loc);
+    return jit.locations.size() - 1;
+  }
+
+  void expr(const Expr &e, bool value) {
+    const bool outer = want_value;
+    want_value = value;
+    e.accept(*this);
+    want_value = outer;
+  }
+
+  void zero() {
+    if (want_value)
+      a.alu(a_xor, rax, rax);
+  }
+
+  void push() {
+    a.push(rax);
+    pushes++;
+  }
+
+  void pop(Reg r) {
+    a.pop(r);
+    pushes--;
+  }
+
+  void drop(int n) {
+    if (n) {
+      a.alu64(a_add, rsp, 8 * n);
+      pushes -= n;
+    }
+  }
+
+  // Leave in ptr the frame pointer of the function hops levels up.
+  void frame(Reg ptr, int hops) {
+    a.load64(ptr, rbp, 16);
+    while (--hops > 0)
+      a.load64(ptr, ptr, 16);
+  }
+
+  // Whether id is a variable of the current function, whose home is then
+  // stored in home.
+  bool local(const Expr &e, Home &home) {
+    if (e.kind != k_identifier)
+      return false;
+    auto &id = static_cast<const Identifier &>(e);
+    if (id.get_depth() != id.get_decl()->get_depth())
+      return false;
+    home = homes[&*id.get_decl()];
+    return true;
+  }
+
+  void load(Reg dst, const Home &home) {
+    if (home.in_register)
+      a.mov(dst, home.reg);
+    else
+      a.load(dst, rbp, offset(*current, home.slot));
+  }
+
+  void store(const Home &home, Reg src) {
+    if (home.in_register)
+      a.mov(home.reg, src);
+    else
+      a.store(rbp, offset(*current, home.slot), src);
+  }
+
+  // dst op= the value at home.
+  void alu(AluOp op, Reg dst, const Home &home) {
+    if (home.in_register)
+      a.alu(op, dst, home.reg);
+    else
+      a.alu(op, dst, rbp, offset(*current, home.slot));
+  }
+
+  void load(Reg dst, const Identifier &id) {
+    const VarDecl &decl = *id.get_decl();
+    if (const int hops = id.get_depth() - decl.get_depth()) {
+      frame(dst, hops);
+      a.load(dst, dst, offset(*owners[&decl], decl.get_slot()));
+    } else
+      load(dst, homes[&decl]);
+  }
+
+  void store(const Identifier &id, Reg src) {
+    const VarDecl &decl = *id.get_decl();
+    if (const int hops = id.get_depth() - decl.get_depth()) {
+      const Reg ptr = src == rcx ? rdx : rcx;
+      frame(ptr, hops);
+      a.store(ptr, offset(*owners[&decl], decl.get_slot()), src);
+    } else
+      store(homes[&decl], src);
+  }
+
+  // Call a function of the runtime, whose arguments are already in
+  // registers, with an aligned stack.
+  void call_runtime(const void *f) {
+    const bool pad = pushes % 2;
+    if (pad)
+      a.alu64(a_sub, rsp, 8);
+    a.mov64(rax, uint64_t(f));
+    a.call(rax);
+    if (pad)
+      a.alu64(a_add, rsp, 8);
+  }
+
+  void fail(Failure what, int32_t loc) {
+    a.alu64(a_and, rsp, -16);
+    a.mov64(rdi, uint64_t(&jit));
+    a.mov(rsi, int32_t(what));
+    a.mov(rdx, loc);
+    a.mov64(rax, uint64_t(&JIT::fail));
+    a.call(rax);
+  }
+
+  // eax = eax / ecx.
+  void divide(const SourceLoc &loc) {
+    Label nonzero, general, done;
+    a.alu(a_cmp, rcx, 0);
+    a.j(c_ne, nonzero);
+    fail(f_division_by_zero, location(loc));
+    a.bind(nonzero);
+    // Dividing INT_MIN by -1 traps, but negating it wraps around.
+    a.alu(a_cmp, rcx, -1);
+    a.j(c_ne, general);
+    a.neg(rax);
+    a.jmp(done);
+    a.bind(general);
+    a.cdq();
+    a.idiv(rcx);
+    a.bind(done);
+  }
+
+  // Compare left with right, setting the flags, for an integer comparison.
+  void compare(const Expr &left, const Expr &right) {
+    Home l, r;
+    const bool literal = right.kind == k_integer_literal;
+    const int32_t k =
+        literal ? static_cast<const IntegerLiteral &>(right).value : 0;
+    // Evaluating right could assign the variable compared.
+    if (local(left, l) && l.in_register && (literal || local(right, r))) {
+      if (literal)
+        a.alu(a_cmp, l.reg, k);
+      else
+        alu(a_cmp, l.reg, r);
+      return;
+    }
+    expr(left, true);
+    if (literal)
+      a.alu(a_cmp, rax, k);
+    else if (local(right, r))
+      alu(a_cmp, rax, r);
+    else {
+      push();
+      expr(right, true);
+      a.mov(rcx, rax);
+      pop(rax);
+      a.alu(a_cmp, rax, rcx);
+    }
+  }
+
+  // eax = strcmp(left, right).
+  void string_compare(const BinaryOperator &binop) {
+    expr(binop.get_left(), true);
+    push();
+    expr(binop.get_right(), true);
+    push();
+    call_primitive(eval::p_strcmp, 2, binop.loc);
+  }
+
+  // Call primitive p with the n arguments pushed last.
+  void call_primitive(eval::Primitive p, int n, const SourceLoc &loc) {
+    a.mov64(rsi, rsp);
+    a.mov64(rdi, uint64_t(&jit));
+    a.mov(rdx, int32_t(p));
+    a.mov(rcx, n);
+    a.mov(r8, location(loc));
+    call_runtime(reinterpret_cast<const void *>(&JIT::primitive));
+    drop(n);
+  }
+
+  // Jump to if_false unless e is true, as in the bytecode compiler.
+  void condition(const Expr &e, Label &if_false) {
+    if (e.kind == k_integer_literal) {
+      if (is_literal(e, 0))
+        a.jmp(if_false);
+      return;
+    }
+    if (e.kind == k_binary_operator) {
+      auto &binop = static_cast<const BinaryOperator &>(e);
+      if (binop.op >= o_eq) {
+        if (binop.get_left().get_type() == t_string && binop.op >= o_lt) {
+          string_compare(binop);
+          a.alu(a_cmp, rax, 0);
+        } else
+          compare(binop.get_left(), binop.get_right());
+        a.j(negate(condition_code(binop.op)), if_false);
+        return;
+      }
+    }
+    if (e.kind == k_if_then_else) {
+      auto &ite = static_cast<const IfThenElse &>(e);
+      if (is_literal(ite.get_else_part(), 0)) {
+        condition(ite.get_condition(), if_false);
+        condition(ite.get_then_part(), if_false);
+        return;
+      }
+      Label else_part, end;
+      condition(ite.get_condition(), else_part);
+      condition(ite.get_then_part(), if_false);
+      a.jmp(end);
+      a.bind(else_part);
+      condition(ite.get_else_part(), if_false);
+      a.bind(end);
+      return;
+    }
+    expr(e, true);
+    a.alu(a_cmp, rax, 0);
+    a.j(c_e, if_false);
+  }
+
+  void function(const FunDecl &decl) {
+    current = &decl;
+    FunctionInfo &info = functions[&decl];
+    a.bind(info.entry);
+    a.push(rbp);
+    a.mov64(rbp, rsp);
+    for (auto r : info.saved)
+      a.push(r);
+    const int slots = info.slots + (info.saved.size() + info.slots) % 2;
+    if (slots)
+      a.alu64(a_sub, rsp, 8 * slots);
+    a.mov64(rax, uint64_t(static_cast<char *>(jit.stack) + runtime_stack));
+    a.alu64(a_cmp, rsp, rax);
+    a.j(c_b, overflow);
+
+    const auto &params = decl.get_params();
+    const int n = params.size();
+    for (int i = 0; i < n; i++) {
+      const Home &home = homes[params[i]];
+      if (home.in_register)
+        a.load(home.reg, rbp, 16 + 8 * (n - i));
+      else {
+        a.load(rax, rbp, 16 + 8 * (n - i));
+        store(home, rax);
+      }
+    }
+
+    pushes = 0;
+    expr(*decl.get_expr(), true);
+    assert(pushes == 0);
+
+    a.lea64(rsp, rbp, -8 * int32_t(info.saved.size()));
+    for (auto r = info.saved.rbegin(); r != info.saved.rend(); r++)
+      a.pop(*r);
+    a.pop(rbp);
+    a.ret();
+  }
+
+public:
+  explicit Codegen(JIT &_jit) : jit(_jit) {}
+
+  // Generate the program, then the trampoline switching to the stack of
+  // the program to call main, whose offset is returned.
+  size_t generate(const FunDecl &main) {
+    analyze(main);
+    for (auto f : order)
+      function(*f);
+    a.bind(overflow);
+    fail(f_stack_overflow, 0);
+
+    // int32_t trampoline(void *stack_top, const void *main)
+    const size_t trampoline = a.size();
+    a.push(rbp);
+    a.mov64(rbp, rsp);
+    a.mov64(rsp, rdi);
+    a.alu64(a_sub, rsp, 8);
+    a.alu(a_xor, rax, rax);
+    a.push(rax);
+    a.call(rsi);
+    a.mov64(rsp, rbp);
+    a.pop(rbp);
+    a.ret();
+    return trampoline;
+  }
+
+  const std::vector<uint8_t> &bytes() const { return a.bytes(); }
+  size_t entry(const FunDecl &f) { return functions[&f].entry.position; }
+
+  virtual void visit(const IntegerLiteral &literal) {
+    if (want_value)
+      a.mov(rax, literal.value);
+  }
+
+  virtual void visit(const StringLiteral &literal) {
+    if (want_value)
+      a.mov(rax, int32_t(literal.value.get_id()));
+  }
+
+  virtual void visit(const BinaryOperator &binop) {
+    const Expr &left = binop.get_left(), &right = binop.get_right();
+    if (binop.op >= o_eq) {
+      if (left.get_type() == t_string && binop.op >= o_lt) {
+        string_compare(binop);
+        a.alu(a_cmp, rax, 0);
+      } else
+        compare(left, right);
+      if (want_value)
+        a.set(condition_code(binop.op), rax);
+      return;
+    }
+
+    // Operators have no effect of their own, but a division may fail.
+    Home r;
+    expr(left, true);
+    if (right.kind == k_integer_literal && binop.op != o_divide) {
+      const int32_t k = static_cast<const IntegerLiteral &>(right).value;
+      if (binop.op == o_times)
+        a.imul(rax, k);
+      else
+        a.alu(binop.op == o_plus ? a_add : a_sub, rax, k);
+      return;
+    }
+    if (local(right, r) && binop.op != o_divide) {
+      if (binop.op == o_times) {
+        if (r.in_register)
+          a.imul(rax, r.reg);
+        else
+          a.imul(rax, rbp, offset(*current, r.slot));
+      } else
+        alu(binop.op == o_plus ? a_add : a_sub, rax, r);
+      return;
+    }
+    if (right.kind == k_integer_literal || local(right, r)) {
+      if (right.kind == k_integer_literal)
+        a.mov(rcx, static_cast<const IntegerLiteral &>(right).value);
+      else
+        load(rcx, r);
+    } else {
+      push();
+      expr(right, true);
+      a.mov(rcx, rax);
+      pop(rax);
+    }
+    switch (binop.op) {
+    case o_plus:
+      a.alu(a_add, rax, rcx);
+      break;
+    case o_minus:
+      a.alu(a_sub, rax, rcx);
+      break;
+    case o_times:
+      a.imul(rax, rcx);
+      break;
+    default:
+      divide(binop.loc);
+    }
+  }
+
+  virtual void visit(const Sequence &seq) {
+    const auto &exprs = seq.get_exprs();
+    if (exprs.empty())
+      return zero();
+    for (size_t i = 0; i + 1 < exprs.size(); i++)
+      expr(*exprs[i], false);
+    expr(*exprs.back(), want_value);
+  }
+
+  virtual void visit(const Let &let) {
+    for (auto decl : let.get_decls())
+      if (decl->kind == k_var_decl)
+        decl->accept(*this);
+    let.get_sequence().accept(*this);
+  }
+
+  virtual void visit(const Identifier &id) {
+    if (want_value)
+      load(rax, id);
+  }
+
+  virtual void visit(const IfThenElse &ite) {
+    const Expr &else_part = ite.get_else_part();
+    Label else_label, end;
+    condition(ite.get_condition(), else_label);
+    ite.get_then_part().accept(*this);
+    if (!want_value && else_part.kind == k_sequence &&
+        static_cast<const Sequence &>(else_part).get_exprs().empty()) {
+      a.bind(else_label);
+      return;
+    }
+    a.jmp(end);
+    a.bind(else_label);
+    else_part.accept(*this);
+    a.bind(end);
+  }
+
+  virtual void visit(const VarDecl &decl) {
+    expr(*decl.get_expr(), true);
+    store(homes[&decl], rax);
+  }
+
+  virtual void visit(const FunDecl &) {}
+
+  virtual void visit(const FunCall &call) {
+    const FunDecl &decl = *call.get_decl();
+    const auto &args = call.get_args();
+    const int n = args.size();
+    if (decl.is_external) {
+      auto p = eval::find_primitive(decl);
+      if (!p)
+        utils::error(call.loc,
+                     "unknown primitive " + decl.name.get().to_string());
+      for (auto arg : args) {
+        expr(*arg, true);
+        push();
+      }
+      call_primitive(*p, n, call.loc);
+      return;
+    }
+    // The callee starts with an aligned stack once the return address is
+    // pushed.
+    const bool pad = (pushes + n + 1) % 2;
+    if (pad) {
+      a.alu64(a_sub, rsp, 8);
+      pushes++;
+    }
+    for (auto arg : args) {
+      expr(*arg, true);
+      push();
+    }
+    if (const int hops = call.get_depth() - decl.get_depth() + 1)
+      frame(rax, hops);
+    else
+      a.mov64(rax, rbp);
+    push();
+    a.call(functions[&decl].entry);
+    drop(n + 1 + pad);
+  }
+
+  virtual void visit(const WhileLoop &loop) {
+    Label start, end;
+    a.bind(start);
+    condition(loop.get_condition(), end);
+    loops.push_back(LoopInfo{&end, pushes});
+    expr(loop.get_body(), false);
+    loops.pop_back();
+    a.jmp(start);
+    a.bind(end);
+    zero();
+  }
+
+  virtual void visit(const ForLoop &loop) {
+    const VarDecl &variable = loop.get_variable();
+    const Home &index = homes[&variable], &bound = homes[&loop];
+    expr(*variable.get_expr(), true);
+    store(index, rax);
+    expr(loop.get_high(), true);
+    store(bound, rax);
+
+    // Compare the index with the bound.
+    auto test = [&]() {
+      Reg i = rcx;
+      if (index.in_register)
+        i = index.reg;
+      else
+        load(rcx, index);
+      alu(a_cmp, i, bound);
+    };
+
+    Label body, end;
+    test();
+    a.j(c_g, end);
+    a.bind(body);
+    loops.push_back(LoopInfo{&end, pushes});
+    expr(loop.get_body(), false);
+    loops.pop_back();
+    test();
+    a.j(c_ge, end);
+    if (index.in_register)
+      a.alu(a_add, index.reg, 1);
+    else
+      a.alu_mem(a_add, rbp, offset(*current, index.slot), 1);
+    a.jmp(body);
+    a.bind(end);
+    zero();
+  }
+
+  virtual void visit(const Break &) {
+    const LoopInfo &loop = loops.back();
+    const int start = pushes;
+    if (pushes > loop.pushes)
+      a.alu64(a_add, rsp, 8 * (pushes - loop.pushes));
+    a.jmp(*loop.end);
+    // What follows is unreachable, but must be compiled consistently.
+    pushes = start;
+  }
+
+  virtual void visit(const Assign &assign) {
+    expr(assign.get_rhs(), true);
+    store(assign.get_lhs(), rax);
+    zero();
+  }
+};
+
+JIT::JIT(const FunDecl &main, std::ostream &_ostream, size_t _stack_size)
+    : out(_ostream), stack_size(_stack_size) {
+  stack = mmap(nullptr, stack_size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (stack == MAP_FAILED)
+    utils::error("cannot allocate the stack of the JIT");
+
+  Codegen codegen(*this);
+  const size_t trampoline = codegen.generate(main);
+  const std::vector<uint8_t> &bytes = codegen.bytes();
+
+  // The code is written, then made executable but no longer writable.
+  code_size = bytes.size();
+  code = mmap(nullptr, code_size, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (code == MAP_FAILED)
+    utils::error("cannot allocate memory for the JIT");
+  std::memcpy(code, bytes.data(), code_size);
+  if (mprotect(code, code_size, PROT_READ | PROT_EXEC))
+    utils::error("cannot make the code of the JIT executable");
+  main_entry = static_cast<char *>(code) + codegen.entry(main);
+  entry = static_cast<char *>(code) + trampoline;
+}
+
+JIT::~JIT() {
+  if (code && code != MAP_FAILED)
+    munmap(code, code_size);
+  if (stack && stack != MAP_FAILED)
+    munmap(stack, stack_size);
+}
+
+bool JIT::supported() { return true; }
+
+// The generated code has no unwinding information, so exceptions must not
+// go through it: runtime errors and exit() longjmp back to run() instead.
+int32_t JIT::primitive(JIT *jit, const int64_t *args, int32_t p, int32_t n,
+                       int32_t loc) {
+  // The arguments were pushed in order.
+  int32_t values[3];
+  for (int32_t i = 0; i < n; i++)
+    values[i] = int32_t(args[n - 1 - i]);
+  try {
+    return call_primitive(eval::Primitive(p), values, jit->out,
+                          jit->locations[loc]);
+  } catch (eval::Exit &e) {
+    jit->exited = true;
+    jit->status = e.status;
+  } catch (utils::FatalError &) {
+    jit->failed = true;
+  }
+  std::longjmp(jit->env, 1);
+}
+
+void JIT::fail(JIT *jit, int32_t what, int32_t loc) {
+  try {
+    if (what == f_division_by_zero)
+      eval::runtime_error(jit->out, jit->locations[loc], "division by zero");
+    jit->out.flush();
+    utils::error("stack overflow");
+  } catch (utils::FatalError &) {
+    jit->failed = true;
+  }
+  std::longjmp(jit->env, 1);
+}
+
+int32_t JIT::run() {
+  typedef int32_t (*Trampoline)(void *, const void *);
+  exited = failed = false;
+  int32_t result = 0;
+  if (!setjmp(env)) {
+    void *top = static_cast<char *>(stack) + stack_size;
+    result = reinterpret_cast<Trampoline>(entry)(top, main_entry);
+  }
+  out.flush();
+  if (failed)
+    throw utils::FatalError();
+  return exited ? status : result;
+}
+
+} // namespace jit
+
+#else
+
+namespace jit {
+
+JIT::JIT(const ast::FunDecl &, std::ostream &_ostream, size_t _stack_size)
+    : out(_ostream), stack_size(_stack_size) {
+  utils::error("the JIT is not supported on this platform");
+}
+
+JIT::~JIT() {}
+
+bool JIT::supported() { return false; }
+
+int32_t JIT::run() { return 0; }
+
+} // namespace jit
+
+#endif
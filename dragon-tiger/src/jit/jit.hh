@@ -0,0 +1,77 @@
+#ifndef JIT_HH
+#define JIT_HH
+
+#include <csetjmp>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "../ast/nodes.hh"
+#include "../utils/output_buffer.hh"
+
+namespace jit {
+
+class Codegen;
+
+// The JIT compiles a bound program to x86-64 machine code, in a buffer
+// mapped executable, and runs it on a stack of its own.
+//
+// Registers are allocated linearly over the body of each function: every
+// variable of the function, the loop variables and bounds of for loops
+// included, gets a callee-saved register (rbx, r12 to r15) when one is
+// free at its declaration, and gives it back at the end of its scope.
+// Variables which do not escape, that is which are not used by nested
+// functions, live in their register for their whole lifetime and are never
+// spilled. Escaping variables, and those left without a register, live in
+// the native frame of their function, where nested functions reach them
+// through the static link.
+//
+// The JIT is only available on x86-64; elsewhere, its constructor reports
+// an error.
+
+class JIT {
+  // Output of the program, as in the evaluator.
+  utils::OutputBuffer out;
+  bool exited = false;
+  int32_t status = 0;
+  // Whether the program failed with a runtime error.
+  bool failed = false;
+  // Where runtime errors and exit() return to.
+  std::jmp_buf env;
+
+  std::vector<ast::SourceLoc> locations;
+  void *code = nullptr;
+  size_t code_size = 0;
+  // The native stack running the program.
+  void *stack = nullptr;
+  size_t stack_size;
+  // The trampoline calling main, and main.
+  const void *entry = nullptr;
+  const void *main_entry = nullptr;
+
+  friend class Codegen;
+
+  // Called by the generated code.
+  static int32_t primitive(JIT *jit, const int64_t *args, int32_t p,
+                           int32_t n, int32_t loc);
+  [[noreturn]] static void fail(JIT *jit, int32_t what, int32_t loc);
+
+public:
+  JIT(const ast::FunDecl &main, std::ostream &_ostream,
+      size_t _stack_size = size_t(1) << 28);
+  ~JIT();
+  JIT(const JIT &) = delete;
+  JIT &operator=(const JIT &) = delete;
+
+  static bool supported();
+
+  // Run the program and return the value of main, or the status given to
+  // exit() if the program called it.
+  int32_t run();
+  bool has_exited() const { return exited; }
+  size_t size() const { return code_size; }
+};
+
+} // namespace jit
+
+#endif // JIT_HH
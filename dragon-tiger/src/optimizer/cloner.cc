@@ -0,0 +1,121 @@
+#include "cloner.hh"
+#include "rewriter.hh"
+
+namespace ast {
+namespace optimizer {
+
+VarDecl *Cloner::declare(VarDecl &decl, Expr *expr) {
+  VarDecl *copy = new VarDecl(
+      decl.loc,
+      Symbol(decl.name.get().to_string() + "_" + std::to_string(++counter)),
+      decl.type_name, expr, decl.read_only);
+  copy->set_type(decl.get_type());
+  copy->set_depth(function.get_depth());
+  copy->set_slot(function.get_frame_size()++);
+  decls[&decl] = copy;
+  return copy;
+}
+
+Identifier *Cloner::identifier(Identifier &id) {
+  auto decl = decls.find(&*id.get_decl());
+  VarDecl *target = decl == decls.end() ? &*id.get_decl() : decl->second;
+  Identifier *copy = new Identifier(id.loc, target->name);
+  copy->set_decl(target);
+  copy->set_depth(function.get_depth());
+  return typed(copy, id.get_type());
+}
+
+void Cloner::visit(IntegerLiteral &literal) {
+  result = typed(new IntegerLiteral(literal.loc, literal.value),
+                 literal.get_type());
+}
+
+void Cloner::visit(StringLiteral &literal) {
+  result = typed(new StringLiteral(literal.loc, literal.value),
+                 literal.get_type());
+}
+
+void Cloner::visit(BinaryOperator &binop) {
+  Expr *left = clone(binop.get_left());
+  result = typed(
+      new BinaryOperator(binop.loc, left, clone(binop.get_right()), binop.op),
+      binop.get_type());
+}
+
+void Cloner::visit(Sequence &seq) {
+  std::vector<Expr *> exprs;
+  for (auto expr : seq.get_exprs())
+    exprs.push_back(clone(*expr));
+  result = typed(new Sequence(seq.loc, exprs), seq.get_type());
+}
+
+// Without functions, the decls of a let are variables.
+void Cloner::visit(Let &let) {
+  std::vector<Decl *> copies;
+  for (auto decl : let.get_decls()) {
+    VarDecl &var = static_cast<VarDecl &>(*decl);
+    copies.push_back(
+        declare(var, var.get_expr() ? clone(*var.get_expr()) : nullptr));
+  }
+  Sequence *seq = static_cast<Sequence *>(clone(let.get_sequence()));
+  result = typed(new Let(let.loc, copies, seq), let.get_type());
+}
+
+void Cloner::visit(Identifier &id) { result = identifier(id); }
+
+void Cloner::visit(IfThenElse &ite) {
+  Expr *condition = clone(ite.get_condition());
+  Expr *then_part = clone(ite.get_then_part());
+  result = typed(new IfThenElse(ite.loc, condition, then_part,
+                                clone(ite.get_else_part())),
+                 ite.get_type());
+}
+
+void Cloner::visit(VarDecl &) { assert(false); }
+
+void Cloner::visit(FunDecl &) { assert(false); }
+
+void Cloner::visit(FunCall &call) {
+  std::vector<Expr *> args;
+  for (auto arg : call.get_args())
+    args.push_back(clone(*arg));
+  FunCall *copy = new FunCall(call.loc, args, call.func_name);
+  copy->set_decl(&*call.get_decl());
+  copy->set_depth(function.get_depth());
+  result = typed(copy, call.get_type());
+}
+
+// Loops are created before their bodies are copied, for breaks to be
+// linked to them.
+void Cloner::visit(WhileLoop &loop) {
+  WhileLoop *copy =
+      new WhileLoop(loop.loc, clone(loop.get_condition()), nullptr);
+  loops[&loop] = copy;
+  copy->set_body(clone(loop.get_body()));
+  result = typed(copy, loop.get_type());
+}
+
+void Cloner::visit(ForLoop &loop) {
+  VarDecl &variable = loop.get_variable();
+  Expr *low = clone(*variable.get_expr());
+  Expr *high = clone(loop.get_high());
+  ForLoop *copy = new ForLoop(loop.loc, declare(variable, low), high, nullptr);
+  loops[&loop] = copy;
+  copy->set_body(clone(loop.get_body()));
+  result = typed(copy, loop.get_type());
+}
+
+void Cloner::visit(Break &b) {
+  Break *copy = new Break(b.loc);
+  copy->set_loop(loops.at(&*b.get_loop()));
+  result = typed(copy, b.get_type());
+}
+
+void Cloner::visit(Assign &assign) {
+  Identifier *lhs = identifier(assign.get_lhs());
+  result = typed(new Assign(assign.loc, lhs, clone(assign.get_rhs())),
+                 assign.get_type());
+}
+
+} // namespace optimizer
+} // namespace ast
@@ -0,0 +1,58 @@
+#ifndef CLONER_HH
+#define CLONER_HH
+
+#include <unordered_map>
+
+#include "../ast/nodes.hh"
+
+namespace ast {
+namespace optimizer {
+
+// Copies of expressions of a bound and typed program, made to be placed
+// in function. Variables declared in an expression copied get new
+// declarations in the frame of function, renamed with counter, which the
+// identifiers of the copy use; other identifiers keep their declarations.
+// Breaks in the copy are linked to the copies of their loops, which must
+// be in the expression copied. Functions cannot be copied.
+class Cloner : public ASTVisitor {
+  FunDecl &function;
+  std::unordered_map<VarDecl *, VarDecl *> decls;
+  std::unordered_map<Loop *, Loop *> loops;
+  unsigned &counter;
+  Expr *result = nullptr;
+
+  Identifier *identifier(Identifier &id);
+
+public:
+  Cloner(FunDecl &_function, unsigned &_counter)
+      : function(_function), counter(_counter) {}
+
+  Expr *clone(Expr &e) {
+    e.accept(*this);
+    return result;
+  }
+
+  // A new variable of the frame of function standing for decl in the
+  // copies, with value expr.
+  VarDecl *declare(VarDecl &decl, Expr *expr);
+
+  virtual void visit(IntegerLiteral &literal);
+  virtual void visit(StringLiteral &literal);
+  virtual void visit(BinaryOperator &binop);
+  virtual void visit(Sequence &seq);
+  virtual void visit(Let &let);
+  virtual void visit(Identifier &id);
+  virtual void visit(IfThenElse &ite);
+  virtual void visit(VarDecl &decl);
+  virtual void visit(FunDecl &decl);
+  virtual void visit(FunCall &call);
+  virtual void visit(WhileLoop &loop);
+  virtual void visit(ForLoop &loop);
+  virtual void visit(Break &b);
+  virtual void visit(Assign &assign);
+};
+
+} // namespace optimizer
+} // namespace ast
+
+#endif // CLONER_HH
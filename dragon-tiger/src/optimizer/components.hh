@@ -0,0 +1,78 @@
+#ifndef COMPONENTS_HH
+#define COMPONENTS_HH
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace ast {
+namespace optimizer {
+
+// The strongly connected components of the graph whose vertices are given
+// in order and whose edges leave v towards the elements of successors(v),
+// found with Tarjan's algorithm run with an explicit stack. A component is
+// listed after every component it reaches, so that callees come before
+// their callers in a call graph.
+template <typename V, typename Successors>
+std::vector<std::vector<V>> strong_components(const std::vector<V> &vertices,
+                                              Successors successors) {
+  struct Info {
+    // Order of discovery, and lowest order reachable.
+    int index = -1, low = -1;
+    bool on_stack = false;
+  };
+  struct Frame {
+    V v;
+    std::vector<V> next;
+    size_t done;
+  };
+  std::unordered_map<V, Info> info;
+  std::vector<std::vector<V>> components;
+  std::vector<V> stack;
+  std::vector<Frame> frames;
+  int index = 0;
+  auto discover = [&](V v) {
+    Info &i = info[v];
+    i.index = i.low = index++;
+    i.on_stack = true;
+    stack.push_back(v);
+    frames.push_back(Frame{v, successors(v), 0});
+  };
+  for (auto root : vertices) {
+    if (info[root].index >= 0)
+      continue;
+    discover(root);
+    while (!frames.empty()) {
+      Frame &frame = frames.back();
+      Info &i = info[frame.v];
+      if (frame.done < frame.next.size()) {
+        V w = frame.next[frame.done++];
+        Info &other = info[w];
+        if (other.index < 0)
+          discover(w);
+        else if (other.on_stack)
+          i.low = std::min(i.low, other.index);
+        continue;
+      }
+      const V v = frame.v;
+      frames.pop_back();
+      if (!frames.empty()) {
+        Info &parent = info[frames.back().v];
+        parent.low = std::min(parent.low, i.low);
+      }
+      if (i.low != i.index)
+        continue;
+      const auto first = std::find(stack.begin(), stack.end(), v);
+      components.emplace_back(first, stack.end());
+      for (auto w : components.back())
+        info[w].on_stack = false;
+      stack.erase(first, stack.end());
+    }
+  }
+  return components;
+}
+
+} // namespace optimizer
+} // namespace ast
+
+#endif // COMPONENTS_HH
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "dead_code.hh"
+#include "purity.hh"
+#include "rewriter.hh"
+#include "../ast/traversal.hh"
+#include "../binder/escapes.hh"
+
+namespace ast {
+namespace optimizer {
+
+namespace {
+
+// Whether evaluating e always ends with a break.
+bool always_breaks(const Expr &e) {
+  switch (e.kind) {
+  case k_break:
+    return true;
+  case k_sequence: {
+    const auto &exprs = static_cast<const Sequence &>(e).get_exprs();
+    return std::any_of(exprs.begin(), exprs.end(),
+                       [](const Expr *expr) { return always_breaks(*expr); });
+  }
+  case k_let:
+    return always_breaks(static_cast<const Let &>(e).get_sequence());
+  case k_if_then_else: {
+    auto &ite = static_cast<const IfThenElse &>(e);
+    return always_breaks(ite.get_condition()) ||
+           (always_breaks(ite.get_then_part()) &&
+            always_breaks(ite.get_else_part()));
+  }
+  default:
+    return false;
+  }
+}
+
+// Removes the code which cannot run: dead branches and tails of
+// sequences.
+class BranchPruner : public Rewriter {
+  size_t &removed;
+
+  void dispose(Node *node) {
+    removed += count_nodes(*node);
+    Node::dispose(node);
+  }
+
+  void prune(Sequence &seq) {
+    auto &exprs = seq.get_exprs();
+    if (seq.get_type() != t_void)
+      return;
+    for (size_t i = 0; i + 1 < exprs.size(); i++)
+      if (exprs[i]->get_type() == t_void && always_breaks(*exprs[i])) {
+        for (size_t j = i + 1; j < exprs.size(); j++)
+          dispose(exprs[j]);
+        exprs.erase(exprs.begin() + i + 1, exprs.end());
+        return;
+      }
+  }
+
+public:
+  explicit BranchPruner(size_t &_removed) : removed(_removed) {}
+
+  virtual void visit(Sequence &seq) { prune(seq); }
+  virtual void visit(Let &let) { prune(let.get_sequence()); }
+
+  virtual void visit(IfThenElse &ite) {
+    const Expr &condition = ite.get_condition();
+    if (condition.kind != k_integer_literal)
+      return;
+    Expr *chosen;
+    if (static_cast<const IntegerLiteral &>(condition).value) {
+      chosen = &ite.get_then_part();
+      ite.set_then_part(nullptr);
+    } else {
+      chosen = &ite.get_else_part();
+      ite.set_else_part(nullptr);
+    }
+    dispose(&ite);
+    result = chosen;
+  }
+};
+
+class DeadCodeEliminator {
+  FunDecl &main;
+  DeadCodeStats stats{0, 0, 0};
+  std::unordered_set<const FunDecl *> live_functions;
+  // The lets of live functions, and the number of identifiers of live code
+  // bound to each variable.
+  std::vector<Let *> lets;
+  std::unordered_map<const VarDecl *, size_t> references;
+  std::unordered_set<const VarDecl *> dead_variables;
+
+  // Find the lets, references and calls of the code of f, but not of the
+  // functions nested in it, which are scanned once found to be called.
+  void scan(FunDecl &f, std::vector<FunDecl *> &work) {
+    std::vector<Node *> stack(1, &*f.get_expr());
+    while (!stack.empty()) {
+      Node *node = stack.back();
+      stack.pop_back();
+      switch (node->kind) {
+      case k_fun_decl:
+        continue;
+      case k_let:
+        lets.push_back(static_cast<Let *>(node));
+        break;
+      case k_identifier:
+        references[&*static_cast<Identifier *>(node)->get_decl()]++;
+        break;
+      case k_fun_call: {
+        FunDecl *callee = &*static_cast<FunCall *>(node)->get_decl();
+        if (!callee->is_external && live_functions.insert(callee).second)
+          work.push_back(callee);
+        break;
+      }
+      default:
+        break;
+      }
+      for_each_child(*node, [&](const Node &child) {
+        stack.push_back(const_cast<Node *>(&child));
+      });
+    }
+  }
+
+  // Mark as dead the unused variables with pure values, and then those
+  // only used by their values.
+  void find_dead_variables() {
+    std::vector<const VarDecl *> work;
+    for (auto let : lets)
+      for (auto decl : let->get_decls())
+        if (decl->kind == k_var_decl &&
+            !references[static_cast<VarDecl *>(decl)] &&
+            is_pure(*static_cast<VarDecl *>(decl)->get_expr()))
+          work.push_back(static_cast<VarDecl *>(decl));
+    while (!work.empty()) {
+      const VarDecl *var = work.back();
+      work.pop_back();
+      if (!dead_variables.insert(var).second)
+        continue;
+      walk(*var->get_expr(),
+           [&](const Node &node) {
+             if (node.kind != k_identifier)
+               return;
+             const VarDecl *used =
+                 &*static_cast<const Identifier &>(node).get_decl();
+             // Only variables declared in a let may be removed.
+             if (!--references[used] && used->get_expr() &&
+                 !used->read_only && is_pure(*used->get_expr()))
+               work.push_back(used);
+           },
+           [](const Node &) {});
+    }
+  }
+
+  bool is_dead(const Decl *decl) {
+    if (decl->kind == k_fun_decl)
+      return !live_functions.count(static_cast<const FunDecl *>(decl));
+    return dead_variables.count(static_cast<const VarDecl *>(decl));
+  }
+
+  void remove_dead_declarations() {
+    for (auto let : lets) {
+      auto &decls = let->get_decls();
+      auto dead =
+          std::stable_partition(decls.begin(), decls.end(),
+                                [&](Decl *decl) { return !is_dead(decl); });
+      for (auto decl = dead; decl != decls.end(); decl++) {
+        ((*decl)->kind == k_fun_decl ? stats.functions : stats.variables)++;
+        stats.nodes_removed += count_nodes(**decl);
+        Node::dispose(*decl);
+      }
+      decls.erase(dead, decls.end());
+    }
+  }
+
+public:
+  explicit DeadCodeEliminator(FunDecl &_main) : main(_main) {}
+
+  DeadCodeStats run() {
+    BranchPruner pruner(stats.nodes_removed);
+    pruner.rewrite(main);
+    std::vector<FunDecl *> work(1, &main);
+    live_functions.insert(&main);
+    while (!work.empty()) {
+      FunDecl *f = work.back();
+      work.pop_back();
+      scan(*f, work);
+    }
+    find_dead_variables();
+    remove_dead_declarations();
+    binder::find_escapes(main);
+    return stats;
+  }
+};
+
+} // namespace
+
+DeadCodeStats eliminate_dead_code(FunDecl &main) {
+  return DeadCodeEliminator(main).run();
+}
+
+} // namespace optimizer
+} // namespace ast
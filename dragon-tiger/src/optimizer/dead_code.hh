@@ -0,0 +1,36 @@
+#ifndef DEAD_CODE_HH
+#define DEAD_CODE_HH
+
+#include <cstddef>
+
+#include "../ast/nodes.hh"
+
+namespace ast {
+namespace optimizer {
+
+// Dead-code elimination removes, with their subtrees:
+//
+//   - the branch of an `if' whose condition is a literal;
+//   - what follows, in a sequence of type void, an expression which always
+//     breaks out of a loop;
+//   - the functions which cannot be called from main, following the
+//     declarations bound to calls from code which may run;
+//   - the variables declared in a let which are neither read nor assigned
+//     by such code, when their value can be computed without failing or
+//     having an effect. Removing one may leave others unused.
+//
+// Variables keep their slots: removed ones leave unused slots in frames.
+// The program must be bound and typed.
+
+struct DeadCodeStats {
+  size_t nodes_removed;
+  size_t functions;
+  size_t variables;
+};
+
+DeadCodeStats eliminate_dead_code(FunDecl &main);
+
+} // namespace optimizer
+} // namespace ast
+
+#endif // DEAD_CODE_HH
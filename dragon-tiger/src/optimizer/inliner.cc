@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "inliner.hh"
+#include "cloner.hh"
+#include "components.hh"
+#include "rewriter.hh"
+#include "../ast/traversal.hh"
+#include "../binder/escapes.hh"
+
+namespace ast {
+namespace optimizer {
+
+namespace {
+
+struct FunctionInfo {
+  // The functions called, in the order of the program.
+  std::vector<FunDecl *> callees;
+  bool has_nested = false;
+  bool recursive = false;
+  // The number of nodes of the body, once its calls are inlined.
+  size_t size = SIZE_MAX;
+};
+
+class Inliner : public Rewriter {
+  FunDecl &main;
+  const unsigned limit;
+  std::unordered_map<FunDecl *, FunctionInfo> functions;
+  // The functions in the order of the program.
+  std::vector<FunDecl *> program;
+  // The same functions, in the order they are handled.
+  std::vector<FunDecl *> order;
+  std::unordered_set<FunDecl *> inlined;
+  // The function whose calls are being inlined.
+  FunDecl *caller = nullptr;
+  unsigned counter = 0;
+
+  // Record the calls of every function, excluding those of the functions
+  // nested in it.
+  void build_call_graph() {
+    std::vector<FunDecl *> stack;
+    walk(main,
+         [&](Node &node) {
+           if (node.kind == k_fun_decl) {
+             auto &decl = static_cast<FunDecl &>(node);
+             if (!stack.empty())
+               functions[stack.back()].has_nested = true;
+             functions[&decl];
+             program.push_back(&decl);
+             stack.push_back(&decl);
+           } else if (node.kind == k_fun_call) {
+             FunDecl *callee = &*static_cast<FunCall &>(node).get_decl();
+             if (callee->is_external)
+               return;
+             auto &callees = functions[stack.back()].callees;
+             if (std::find(callees.begin(), callees.end(), callee) ==
+                 callees.end())
+               callees.push_back(callee);
+           }
+         },
+         [&](Node &node) {
+           if (node.kind == k_fun_decl)
+             stack.pop_back();
+         });
+  }
+
+  // Functions are handled callees first, except inside cycles, whose
+  // functions are recursive.
+  void find_order() {
+    auto components = strong_components(
+        program, [&](FunDecl *f) { return functions[f].callees; });
+    for (auto &component : components)
+      for (auto f : component) {
+        FunctionInfo &info = functions[f];
+        info.recursive =
+            component.size() > 1 ||
+            std::find(info.callees.begin(), info.callees.end(), f) !=
+                info.callees.end();
+        order.push_back(f);
+      }
+  }
+
+  bool inlinable(FunDecl &f) {
+    const FunctionInfo &info = functions[&f];
+    return !info.recursive && !info.has_nested && info.size <= limit;
+  }
+
+  // Replace call by a let binding the arguments to copies of the parameters
+  // of the function called, around a copy of its body.
+  Expr *expand(FunCall &call) {
+    FunDecl &callee = *call.get_decl();
+    Cloner cloner(*caller, counter);
+    std::vector<Decl *> params;
+    auto &args = call.get_args();
+    for (size_t i = 0; i < args.size(); i++)
+      params.push_back(cloner.declare(*callee.get_params()[i], args[i]));
+    args.clear();
+    Expr *body = cloner.clone(*callee.get_expr());
+    Sequence *seq = typed(
+        new Sequence(call.loc, std::vector<Expr *>(1, body)), body->get_type());
+    Let *let = typed(new Let(call.loc, params, seq), body->get_type());
+    Node::dispose(&call);
+    inlined.insert(&callee);
+    call_sites++;
+    return let;
+  }
+
+public:
+  size_t call_sites = 0;
+
+  Inliner(FunDecl &_main, unsigned _limit) : main(_main), limit(_limit) {}
+
+  InlinerStats run() {
+    build_call_graph();
+    find_order();
+    for (auto f : order) {
+      caller = f;
+      f->set_expr(rewrite(*f->get_expr()));
+      functions[f].size = count_nodes(*f->get_expr());
+    }
+    if (call_sites)
+      binder::find_escapes(main);
+    return InlinerStats{call_sites, inlined.size()};
+  }
+
+  // Nested functions are handled in their turn.
+  virtual bool enter(Node &node) { return node.kind != k_fun_decl; }
+
+  virtual void visit(FunCall &call) {
+    if (!call.get_decl()->is_external && inlinable(*call.get_decl()))
+      result = expand(call);
+  }
+};
+
+} // namespace
+
+InlinerStats inline_functions(FunDecl &main, unsigned limit) {
+  if (!limit)
+    return InlinerStats{0, 0};
+  return Inliner(main, limit).run();
+}
+
+} // namespace optimizer
+} // namespace ast
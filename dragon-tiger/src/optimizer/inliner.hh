@@ -0,0 +1,42 @@
+#ifndef INLINER_HH
+#define INLINER_HH
+
+#include <cstddef>
+
+#include "../ast/nodes.hh"
+
+namespace ast {
+namespace optimizer {
+
+// The inliner replaces calls to small functions by a copy of their body:
+//
+//   f(a, b)   becomes   let var x_1 := a var y_2 := b in <body of f> end
+//
+// where x and y are the parameters of f. Variables of the copy are new
+// declarations in the frame of the caller, renamed with a counter so that
+// the dump of the program stays unambiguous, and breaks are linked to the
+// copies of their loops.
+//
+// A function is inlined when it is not recursive in the call graph, has
+// no nested function, and its body has at most limit nodes. Functions are
+// handled callees first, so that a body copied has already had its own
+// calls inlined. The functions inlined everywhere are kept, for later
+// passes to remove.
+//
+// The program must be bound and typed.
+
+struct InlinerStats {
+  size_t call_sites;
+  // Functions inlined at one call site at least.
+  size_t functions;
+};
+
+const unsigned default_inline_limit = 30;
+
+InlinerStats inline_functions(FunDecl &main,
+                              unsigned limit = default_inline_limit);
+
+} // namespace optimizer
+} // namespace ast
+
+#endif // INLINER_HH
@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "lambda_lifter.hh"
+#include "../ast/traversal.hh"
+#include "../binder/escapes.hh"
+
+namespace ast {
+namespace optimizer {
+
+namespace {
+
+struct FunctionInfo {
+  // The let declaring the function.
+  Let *let = nullptr;
+  // The function nested in main containing the function, maybe itself.
+  FunDecl *top = nullptr;
+  bool leaf = true;
+  // The variables of enclosing functions used by the function and, once
+  // lifted functions are known, by the nested functions it calls.
+  std::vector<VarDecl *> free;
+  // The nested functions called, but itself.
+  std::vector<FunDecl *> callees;
+  bool lifted = false;
+  // The parameters replacing the free variables of a lifted function.
+  std::unordered_map<VarDecl *, VarDecl *> params;
+};
+
+void add(std::vector<VarDecl *> &v, VarDecl *decl) {
+  if (std::find(v.begin(), v.end(), decl) == v.end())
+    v.push_back(decl);
+}
+
+class LambdaLifter {
+  FunDecl &main;
+  const unsigned max_free_variables;
+  std::unordered_map<FunDecl *, FunctionInfo> functions;
+  // The functions in the order of the program.
+  std::vector<FunDecl *> order;
+  // The calls of the program, with the function they appear in.
+  std::vector<std::pair<FunCall *, FunDecl *>> calls;
+  std::unordered_set<VarDecl *> assigned;
+
+  void analyze() {
+    std::vector<FunDecl *> stack;
+    walk(main,
+         [&](Node &node) {
+           switch (node.kind) {
+           case k_fun_decl: {
+             auto &decl = static_cast<FunDecl &>(node);
+             if (!stack.empty()) {
+               functions[&decl].top = stack.size() == 1 ? &decl : stack[1];
+               if (stack.size() > 1)
+                 functions[stack.back()].leaf = false;
+             }
+             stack.push_back(&decl);
+             order.push_back(&decl);
+             break;
+           }
+           case k_let:
+             for (auto decl : static_cast<Let &>(node).get_decls())
+               if (decl->kind == k_fun_decl)
+                 functions[static_cast<FunDecl *>(decl)].let =
+                     &static_cast<Let &>(node);
+             break;
+           case k_identifier: {
+             auto &id = static_cast<Identifier &>(node);
+             if (id.get_decl()->get_depth() < id.get_depth())
+               add(functions[stack.back()].free, &*id.get_decl());
+             break;
+           }
+           case k_fun_call: {
+             auto &call = static_cast<FunCall &>(node);
+             FunDecl *callee = &*call.get_decl();
+             calls.push_back(std::make_pair(&call, stack.back()));
+             if (!callee->is_external && callee != stack.back() &&
+                 callee->get_depth() > 1) {
+               auto &callees = functions[stack.back()].callees;
+               if (std::find(callees.begin(), callees.end(), callee) ==
+                   callees.end())
+                 callees.push_back(callee);
+             }
+             break;
+           }
+           case k_assign: {
+             auto &assign = static_cast<Assign &>(node);
+             assigned.insert(&*assign.get_lhs().get_decl());
+             break;
+           }
+           default:
+             break;
+           }
+         },
+         [&](Node &node) {
+           if (node.kind == k_fun_decl)
+             stack.pop_back();
+         });
+  }
+
+  // Assume that every candidate is lifted, then drop those calling nested
+  // functions which are not, or with too many free variables, until none
+  // is dropped.
+  void choose() {
+    for (auto &f : functions) {
+      FunctionInfo &info = f.second;
+      info.lifted = f.first->get_depth() > 1 && info.leaf;
+      for (auto decl : info.free)
+        info.lifted = info.lifted && !assigned.count(decl);
+    }
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (auto &f : functions) {
+        FunctionInfo &info = f.second;
+        if (!info.lifted)
+          continue;
+        const size_t before = info.free.size();
+        for (auto callee : info.callees) {
+          const FunctionInfo &other = functions[callee];
+          info.lifted = info.lifted && other.lifted;
+          for (auto decl : other.free)
+            add(info.free, decl);
+        }
+        if (info.free.size() > max_free_variables)
+          info.lifted = false;
+        changed = changed || !info.lifted || info.free.size() != before;
+      }
+    }
+  }
+
+  // Give the free variables of f parameters, slots after those of the
+  // original parameters, and the depth of functions nested in main.
+  void lift(FunDecl &f) {
+    FunctionInfo &info = functions[&f];
+    std::sort(info.free.begin(), info.free.end(),
+              [](const VarDecl *a, const VarDecl *b) {
+                return a->get_depth() != b->get_depth()
+                           ? a->get_depth() < b->get_depth()
+                           : a->get_slot() < b->get_slot();
+              });
+    const int params = f.get_params().size(), k = info.free.size();
+    walk(*f.get_expr(),
+         [&](Node &node) {
+           switch (node.kind) {
+           case k_var_decl: {
+             auto &decl = static_cast<VarDecl &>(node);
+             decl.get_depth() = 1;
+             decl.get_slot() += k;
+             break;
+           }
+           case k_identifier: {
+             auto &id = static_cast<Identifier &>(node);
+             id.get_depth() = 1;
+             break;
+           }
+           case k_fun_call:
+             static_cast<FunCall &>(node).get_depth() = 1;
+             break;
+           default:
+             break;
+           }
+         },
+         [](Node &) {});
+    for (auto param : f.get_params())
+      param->get_depth() = 1;
+    for (int i = 0; i < k; i++) {
+      VarDecl *free = info.free[i];
+      VarDecl *param =
+          new VarDecl(f.loc, free->name,
+                      Symbol(free->get_type() == t_string ? "string" : "int"),
+                      nullptr);
+      param->set_type(free->get_type());
+      param->set_depth(1);
+      param->set_slot(params + i);
+      f.get_params().push_back(param);
+      info.params[free] = param;
+    }
+    f.get_frame_size() += k;
+    f.get_depth() = 1;
+    f.reparent(&main);
+  }
+
+  // Bind identifiers of lifted functions to their new parameters.
+  void rebind(FunDecl &f) {
+    FunctionInfo &info = functions[&f];
+    walk(*f.get_expr(),
+         [&](Node &node) {
+           if (node.kind != k_identifier)
+             return;
+           auto &id = static_cast<Identifier &>(node);
+           auto param = info.params.find(&*id.get_decl());
+           if (param != info.params.end())
+             id.rebind(param->second);
+         },
+         [](Node &) {});
+  }
+
+  // Pass the free variables of lifted functions to every call.
+  void extend_calls() {
+    for (auto &c : calls) {
+      FunCall &call = *c.first;
+      auto callee = functions.find(&*call.get_decl());
+      if (callee == functions.end() || !callee->second.lifted)
+        continue;
+      const FunctionInfo &caller = functions[c.second];
+      for (auto decl : callee->second.free) {
+        VarDecl *actual = decl;
+        if (caller.lifted)
+          actual = caller.params.at(decl);
+        Identifier *id = new Identifier(call.loc, decl->name);
+        id->set_decl(actual);
+        id->set_depth(call.get_depth());
+        id->set_type(decl->get_type());
+        call.get_args().push_back(id);
+      }
+    }
+  }
+
+  // Move lifted functions after the function nested in main containing
+  // them, in its group.
+  void move(FunDecl &f, std::unordered_map<FunDecl *, size_t> &moved) {
+    FunctionInfo &info = functions[&f];
+    auto &from = info.let->get_decls();
+    from.erase(std::find(from.begin(), from.end(), &f));
+    FunDecl *top = info.top;
+    auto &to = functions[top].let->get_decls();
+    auto position = std::find(to.begin(), to.end(), top) + 1 + moved[top]++;
+    to.insert(position, &f);
+    info.let = functions[top].let;
+  }
+
+public:
+  LambdaLifter(FunDecl &_main, unsigned _max_free_variables)
+      : main(_main), max_free_variables(_max_free_variables) {}
+
+  LifterStats run() {
+    analyze();
+    choose();
+    LifterStats stats{0, 0};
+    std::vector<FunDecl *> lifted;
+    for (auto f : order) {
+      if (f->get_depth() > 1)
+        stats.nested++;
+      if (functions[f].lifted)
+        lifted.push_back(f);
+    }
+    stats.lifted = lifted.size();
+    if (lifted.empty())
+      return stats;
+
+    for (auto f : lifted)
+      lift(*f);
+    for (auto f : lifted)
+      rebind(*f);
+    extend_calls();
+    std::unordered_map<FunDecl *, size_t> moved;
+    for (auto f : lifted)
+      move(*f, moved);
+    binder::find_escapes(main);
+    return stats;
+  }
+};
+
+} // namespace
+
+LifterStats lift_functions(FunDecl &main, unsigned max_free_variables) {
+  return LambdaLifter(main, max_free_variables).run();
+}
+
+} // namespace optimizer
+} // namespace ast
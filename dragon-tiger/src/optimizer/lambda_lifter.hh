@@ -0,0 +1,45 @@
+#ifndef LAMBDA_LIFTER_HH
+#define LAMBDA_LIFTER_HH
+
+#include <cstddef>
+
+#include "../ast/nodes.hh"
+
+namespace ast {
+namespace optimizer {
+
+// The lambda lifter moves functions nested in other functions than main
+// next to the function nested in main which contains them, at depth 1.
+// Their free variables, those of the functions enclosing them, become
+// extra parameters, given by every call. Accesses to those variables, and
+// the static links of calls, then need no hops through static links.
+//
+// Passing a variable by value is only correct if it never changes, so a
+// function is lifted when:
+//
+//   - it contains no function;
+//   - none of its free variables is ever assigned (loop variables are
+//     fine: they cannot change while the function runs);
+//   - it has at most max_free_variables free variables, counting those of
+//     the nested functions it calls, which must be lifted as well so that
+//     it can call them.
+//
+// The runtime has no heap cells to box assigned variables in, so
+// functions using them keep their static link.
+//
+// The program must be bound and typed. Lifted functions keep their name,
+// so the dump of a lifted program may be ambiguous, but declarations are
+// linked and the engines are not affected.
+
+struct LifterStats {
+  // Functions nested in other functions than main.
+  size_t nested;
+  size_t lifted;
+};
+
+LifterStats lift_functions(FunDecl &main, unsigned max_free_variables = 4);
+
+} // namespace optimizer
+} // namespace ast
+
+#endif // LAMBDA_LIFTER_HH
@@ -0,0 +1,385 @@
+#include <unordered_set>
+#include <vector>
+
+#include "loops.hh"
+#include "cloner.hh"
+#include "rewriter.hh"
+#include "../ast/traversal.hh"
+#include "../binder/escapes.hh"
+
+namespace ast {
+namespace optimizer {
+
+namespace {
+
+// Loops are unrolled when they run at most max_trips times, and their
+// copies hold at most max_nodes nodes.
+const int64_t max_trips = 8;
+const size_t max_nodes = 256;
+
+// l * r, folded when r is 1 or both are literals.
+Expr *multiply(Expr *l, Expr *r) {
+  if (r->kind == k_integer_literal) {
+    const int32_t k = static_cast<IntegerLiteral *>(r)->value;
+    if (k == 1) {
+      Node::dispose(r);
+      return l;
+    }
+    if (l->kind == k_integer_literal) {
+      const int32_t product =
+          uint32_t(static_cast<IntegerLiteral *>(l)->value) * uint32_t(k);
+      Expr *folded = typed(new IntegerLiteral(l->loc, product), t_int);
+      Node::dispose(l);
+      Node::dispose(r);
+      return folded;
+    }
+  }
+  return typed(new BinaryOperator(l->loc, l, r, o_times), t_int);
+}
+
+// What a loop, with its condition or bounds, may change.
+struct LoopInfo {
+  std::unordered_set<const VarDecl *> declared, assigned;
+  // Whether the loop calls functions of the program, which may assign
+  // variables of the functions they are nested in.
+  bool calls = false;
+  // Whether a break leaves the loop itself.
+  bool broken = false;
+  bool has_functions = false;
+
+  explicit LoopInfo(Loop &loop) {
+    walk(loop,
+         [&](Node &node) {
+           switch (node.kind) {
+           case k_var_decl:
+             declared.insert(&static_cast<VarDecl &>(node));
+             break;
+           case k_assign:
+             assigned.insert(
+                 &*static_cast<Assign &>(node).get_lhs().get_decl());
+             break;
+           case k_fun_call:
+             calls = calls ||
+                     !static_cast<FunCall &>(node).get_decl()->is_external;
+             break;
+           case k_break:
+             broken = broken ||
+                      &*static_cast<Break &>(node).get_loop() == &loop;
+             break;
+           case k_fun_decl:
+             has_functions = true;
+             break;
+           default:
+             break;
+           }
+         },
+         [](Node &) {});
+  }
+};
+
+// The optimization of a loop of function. Variables computed before the
+// loop are declared in decls.
+class LoopContext {
+  FunDecl &function;
+  const LoopInfo info;
+  // The variables assigned by functions nested in the one declaring them.
+  const std::unordered_set<const VarDecl *> &remote;
+  unsigned &counter;
+
+public:
+  std::vector<Decl *> decls;
+
+  LoopContext(FunDecl &_function, Loop &loop,
+              const std::unordered_set<const VarDecl *> &_remote,
+              unsigned &_counter)
+      : function(_function), info(loop), remote(_remote), counter(_counter) {}
+
+  const LoopInfo &get_info() const { return info; }
+
+  // Whether e has the same value, and no effect, whenever the loop
+  // evaluates it.
+  bool invariant(const Expr &e) const {
+    switch (e.kind) {
+    case k_integer_literal:
+    case k_string_literal:
+      return true;
+    case k_identifier: {
+      const VarDecl *decl = &*static_cast<const Identifier &>(e).get_decl();
+      return !info.declared.count(decl) && !info.assigned.count(decl) &&
+             !(info.calls && remote.count(decl));
+    }
+    case k_binary_operator: {
+      auto &binop = static_cast<const BinaryOperator &>(e);
+      return binop.op != o_divide && invariant(binop.get_left()) &&
+             invariant(binop.get_right());
+    }
+    default:
+      return false;
+    }
+  }
+
+  bool is_variable(const Expr &e, const VarDecl &decl) const {
+    return e.kind == k_identifier &&
+           &*static_cast<const Identifier &>(e).get_decl() == &decl &&
+           static_cast<const Identifier &>(e).get_depth() ==
+               function.get_depth();
+  }
+
+  Identifier *identifier(const SourceLoc &loc, VarDecl &decl) {
+    Identifier *id = new Identifier(loc, decl.name);
+    id->set_decl(&decl);
+    id->set_depth(function.get_depth());
+    return typed(id, decl.get_type());
+  }
+
+  // A copy of e, a literal or an identifier.
+  Expr *copy(Expr &e) {
+    if (e.kind == k_integer_literal)
+      return typed(
+          new IntegerLiteral(e.loc, static_cast<IntegerLiteral &>(e).value),
+          t_int);
+    return identifier(e.loc, *static_cast<Identifier &>(e).get_decl());
+  }
+
+  // A new variable of the frame of function, computed before the loop.
+  VarDecl *declare(const std::string &name, Expr *value) {
+    VarDecl *decl = new VarDecl(
+        value->loc, Symbol(name + "_" + std::to_string(++counter)),
+        boost::none, value);
+    decl->set_type(value->get_type());
+    decl->set_depth(function.get_depth());
+    decl->set_slot(function.get_frame_size()++);
+    decls.push_back(decl);
+    return decl;
+  }
+};
+
+// Replace the largest invariant operations by variables.
+class Hoister : public Rewriter {
+  LoopContext &loop;
+  // The operation entered last, if it is to be hoisted.
+  Node *invariant = nullptr;
+
+public:
+  size_t hoisted = 0;
+
+  explicit Hoister(LoopContext &_loop) : loop(_loop) {}
+
+  // Nested functions do not run when the loop evaluates them. The children
+  // of invariant operations are hoisted with them.
+  virtual bool enter(Node &node) {
+    if (node.kind == k_fun_decl)
+      return false;
+    if (node.kind == k_binary_operator &&
+        loop.invariant(static_cast<Expr &>(node))) {
+      invariant = &node;
+      return false;
+    }
+    return true;
+  }
+
+  virtual void visit(BinaryOperator &binop) {
+    if (&binop != invariant)
+      return;
+    result = loop.identifier(binop.loc, *loop.declare("hoisted", &binop));
+    hoisted++;
+  }
+};
+
+// Replace products of the loop variable by variables increased by the
+// factor at each iteration. The factors are literals or invariant
+// identifiers.
+class Reducer : public Rewriter {
+  LoopContext &loop;
+  VarDecl &variable;
+  // The variable standing for the lower bound, when it is not a literal.
+  VarDecl *low = nullptr;
+  // The product entered last, if it is to be reduced, and its factor.
+  BinaryOperator *reducible = nullptr;
+  Expr *factor = nullptr;
+
+  bool same(const Expr &a, const Expr &b) const {
+    if (a.kind != b.kind)
+      return false;
+    if (a.kind == k_integer_literal)
+      return static_cast<const IntegerLiteral &>(a).value ==
+             static_cast<const IntegerLiteral &>(b).value;
+    return &*static_cast<const Identifier &>(a).get_decl() ==
+           &*static_cast<const Identifier &>(b).get_decl();
+  }
+
+  // The variable holding the product of the loop variable by factor.
+  VarDecl *product(Expr &factor) {
+    for (auto &p : products)
+      if (same(*p.first, factor))
+        return p.second;
+    Expr &start = *variable.get_expr();
+    if (!low && start.kind != k_integer_literal) {
+      low = loop.declare("low", &start);
+      variable.set_expr(loop.identifier(start.loc, *low));
+    }
+    Expr *first = low ? loop.identifier(start.loc, *low) : loop.copy(start);
+    VarDecl *decl =
+        loop.declare("product", multiply(first, loop.copy(factor)));
+    products.push_back(std::make_pair(loop.copy(factor), decl));
+    return decl;
+  }
+
+public:
+  // Copies of the factors found, with their variable.
+  std::vector<std::pair<Expr *, VarDecl *>> products;
+  size_t reduced = 0;
+
+  Reducer(LoopContext &_loop, VarDecl &_variable)
+      : loop(_loop), variable(_variable) {}
+
+  virtual bool enter(Node &node) {
+    if (node.kind == k_fun_decl)
+      return false;
+    if (node.kind != k_binary_operator)
+      return true;
+    auto &binop = static_cast<BinaryOperator &>(node);
+    Expr &left = binop.get_left(), &right = binop.get_right();
+    factor = nullptr;
+    if (binop.op == o_times) {
+      if (loop.is_variable(left, variable))
+        factor = &right;
+      else if (loop.is_variable(right, variable))
+        factor = &left;
+    }
+    if (factor &&
+        (factor->kind == k_integer_literal || factor->kind == k_identifier) &&
+        loop.invariant(*factor)) {
+      reducible = &binop;
+      return false;
+    }
+    return true;
+  }
+
+  virtual void visit(BinaryOperator &binop) {
+    if (&binop != reducible)
+      return;
+    result = loop.identifier(binop.loc, *product(*factor));
+    Node::dispose(&binop);
+    reduced++;
+  }
+};
+
+class LoopOptimizer : public Rewriter {
+  std::unordered_set<const VarDecl *> remote;
+  // The functions entered, the innermost last.
+  std::vector<FunDecl *> functions;
+  unsigned counter = 0;
+
+  // Put the variables computed before loop in a let around it.
+  Expr *surround(Loop &loop, const std::vector<Decl *> &decls) {
+    if (decls.empty())
+      return &loop;
+    Sequence *seq = typed(
+        new Sequence(loop.loc, std::vector<Expr *>(1, &loop)), t_void);
+    return typed(new Let(loop.loc, decls, seq), t_void);
+  }
+
+  // The copies of the body of loop, or nullptr if it is not unrolled.
+  Expr *unroll(ForLoop &loop, const LoopInfo &info) {
+    VarDecl &variable = loop.get_variable();
+    const Expr &low = *variable.get_expr(), &high = loop.get_high();
+    if (low.kind != k_integer_literal || high.kind != k_integer_literal ||
+        info.broken || info.has_functions)
+      return nullptr;
+    const int32_t first = static_cast<const IntegerLiteral &>(low).value;
+    const int64_t trips =
+        int64_t(static_cast<const IntegerLiteral &>(high).value) - first + 1;
+    if (trips > max_trips ||
+        trips * count_nodes(loop.get_body()) > int64_t(max_nodes))
+      return nullptr;
+    std::vector<Expr *> copies;
+    Cloner cloner(*functions.back(), counter);
+    for (int64_t i = 0; i < trips; i++) {
+      Expr *value = typed(new IntegerLiteral(loop.loc, first + i), t_int);
+      std::vector<Decl *> decls(1, cloner.declare(variable, value));
+      Expr *body = cloner.clone(loop.get_body());
+      Sequence *seq = typed(
+          new Sequence(body->loc, std::vector<Expr *>(1, body)), t_void);
+      copies.push_back(typed(new Let(body->loc, decls, seq), t_void));
+    }
+    Sequence *seq = typed(new Sequence(loop.loc, copies), t_void);
+    Node::dispose(&loop);
+    stats.unrolled++;
+    return seq;
+  }
+
+public:
+  LoopStats stats{0, 0, 0};
+
+  void run(FunDecl &main) {
+    walk(main,
+         [&](Node &node) {
+           if (node.kind != k_assign)
+             return;
+           const Identifier &lhs = static_cast<Assign &>(node).get_lhs();
+           if (lhs.get_depth() != lhs.get_decl()->get_depth())
+             remote.insert(&*lhs.get_decl());
+         },
+         [](Node &) {});
+    rewrite(main);
+    if (stats.hoisted || stats.reduced || stats.unrolled)
+      binder::find_escapes(main);
+  }
+
+  virtual bool enter(Node &node) {
+    if (node.kind == k_fun_decl)
+      functions.push_back(static_cast<FunDecl *>(&node));
+    return true;
+  }
+
+  virtual void visit(FunDecl &) { functions.pop_back(); }
+
+  virtual void visit(WhileLoop &loop) {
+    LoopContext context(*functions.back(), loop, remote, counter);
+    Hoister hoister(context);
+    loop.set_condition(hoister.rewrite(loop.get_condition()));
+    loop.set_body(hoister.rewrite(loop.get_body()));
+    stats.hoisted += hoister.hoisted;
+    result = surround(loop, context.decls);
+  }
+
+  virtual void visit(ForLoop &loop) {
+    LoopContext context(*functions.back(), loop, remote, counter);
+    if (Expr *copies = unroll(loop, context.get_info())) {
+      result = copies;
+      return;
+    }
+    Hoister hoister(context);
+    loop.set_body(hoister.rewrite(loop.get_body()));
+    stats.hoisted += hoister.hoisted;
+
+    Reducer reducer(context, loop.get_variable());
+    loop.set_body(reducer.rewrite(loop.get_body()));
+    if (reducer.reduced) {
+      std::vector<Expr *> exprs(1, &loop.get_body());
+      for (auto &p : reducer.products) {
+        Identifier *id = context.identifier(loop.loc, *p.second);
+        Expr *sum =
+            typed(new BinaryOperator(loop.loc, id, p.first, o_plus), t_int);
+        exprs.push_back(typed(
+            new Assign(loop.loc, context.identifier(loop.loc, *p.second), sum),
+            t_void));
+      }
+      loop.set_body(typed(new Sequence(loop.loc, exprs), t_void));
+      stats.reduced += reducer.reduced;
+    }
+    result = surround(loop, context.decls);
+  }
+};
+
+} // namespace
+
+LoopStats optimize_loops(FunDecl &main) {
+  LoopOptimizer optimizer;
+  optimizer.run(main);
+  return optimizer.stats;
+}
+
+} // namespace optimizer
+} // namespace ast
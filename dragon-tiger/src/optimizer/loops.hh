@@ -0,0 +1,39 @@
+#ifndef LOOPS_HH
+#define LOOPS_HH
+
+#include <cstddef>
+
+#include "../ast/nodes.hh"
+
+namespace ast {
+namespace optimizer {
+
+// The loop optimizer works on each loop after the loops nested in it:
+//
+// - for loops whose bounds are literals, running at most a few times a
+//   small body without breaking out of it, are replaced by a copy of their
+//   body for each value of the loop variable;
+//
+// - operations whose operands do not change while the loop runs are
+//   computed once, into variables declared in a let around the loop. Only
+//   operations which cannot fail are moved, since the loop may run zero
+//   times; divisions stay in place;
+//
+// - in the body of a for loop, products of the loop variable by a literal
+//   or by a variable which does not change become variables, increased at
+//   the end of each iteration.
+//
+// The program must be bound and typed.
+
+struct LoopStats {
+  size_t hoisted;
+  size_t reduced;
+  size_t unrolled;
+};
+
+LoopStats optimize_loops(FunDecl &main);
+
+} // namespace optimizer
+} // namespace ast
+
+#endif // LOOPS_HH
@@ -0,0 +1,59 @@
+#include "pipeline.hh"
+#include "dead_code.hh"
+#include "inliner.hh"
+#include "lambda_lifter.hh"
+#include "loops.hh"
+#include "simplifier.hh"
+#include "tail_calls.hh"
+
+namespace ast {
+namespace optimizer {
+
+void optimize(FunDecl &main, const PipelineOptions &options,
+              std::ostream *stats) {
+  const int level = options.level;
+
+  if (level > 0) {
+    const SimplifierStats s = simplify(main);
+    if (stats)
+      *stats << "simplifier: " << s.rewrites << " rewrites, "
+             << s.nodes_before << " nodes before, " << s.nodes_after
+             << " after" << std::endl;
+  }
+
+  if (options.run || level > 0) {
+    const TailCallStats s = eliminate_tail_calls(main);
+    if (stats)
+      *stats << "tail calls: " << s.calls << " calls in " << s.functions
+             << " functions turned into jumps" << std::endl;
+  }
+
+  if (level > 1) {
+    const InlinerStats s = inline_functions(main, options.inline_limit);
+    if (stats)
+      *stats << "inliner: " << s.call_sites << " call sites inlined, from "
+             << s.functions << " functions" << std::endl;
+
+    const LoopStats l = optimize_loops(main);
+    if (stats)
+      *stats << "loops: " << l.hoisted << " operations hoisted, "
+             << l.reduced << " products reduced, " << l.unrolled
+             << " loops unrolled" << std::endl;
+
+    const LifterStats f = lift_functions(main);
+    if (stats)
+      *stats << "lambda lifter: " << f.lifted << " of " << f.nested
+             << " nested functions lifted" << std::endl;
+  }
+
+  if (level > 0) {
+    const DeadCodeStats s = eliminate_dead_code(main);
+    if (stats)
+      *stats << "dead code: " << s.nodes_removed << " nodes removed, "
+             << s.functions << " functions and " << s.variables
+             << " variables" << std::endl;
+  }
+}
+
+} // namespace optimizer
+} // namespace ast
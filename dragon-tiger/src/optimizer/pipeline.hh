@@ -0,0 +1,35 @@
+#ifndef PIPELINE_HH
+#define PIPELINE_HH
+
+#include <ostream>
+
+#include "../ast/nodes.hh"
+
+namespace ast {
+namespace optimizer {
+
+struct PipelineOptions {
+  // The optimization level, from 0 to 2.
+  int level;
+  // Whether the program is to be run, which requires tail calls to be
+  // eliminated even at level 0, so that recursion through tail calls does
+  // not depend on the stack size.
+  bool run;
+  unsigned inline_limit;
+};
+
+// Run the passes of the given level on main, which must be bound and typed,
+// in the order the driver uses:
+//
+//   -O1   simplifier, tail calls, dead code
+//   -O2   simplifier, tail calls, inliner, loops, lambda lifter, dead code
+//
+// A line of statistics for each pass is written to stats if it is not
+// null. Passes may replace the body of main.
+void optimize(FunDecl &main, const PipelineOptions &options,
+              std::ostream *stats);
+
+} // namespace optimizer
+} // namespace ast
+
+#endif // PIPELINE_HH
@@ -0,0 +1,36 @@
+#ifndef PURITY_HH
+#define PURITY_HH
+
+#include "../ast/nodes.hh"
+
+namespace ast {
+namespace optimizer {
+
+// Whether evaluating e can neither fail nor have effects, so that it may be
+// removed, duplicated or moved across other expressions: literals, variables
+// and arithmetic on them, except for divisions by anything but a non-zero
+// literal.
+inline bool is_pure(const Expr &e) {
+  switch (e.kind) {
+  case k_integer_literal:
+  case k_string_literal:
+  case k_identifier:
+    return true;
+  case k_binary_operator: {
+    auto &binop = static_cast<const BinaryOperator &>(e);
+    const Expr &right = binop.get_right();
+    if (binop.op == o_divide &&
+        (right.kind != k_integer_literal ||
+         !static_cast<const IntegerLiteral &>(right).value))
+      return false;
+    return is_pure(binop.get_left()) && is_pure(right);
+  }
+  default:
+    return false;
+  }
+}
+
+} // namespace optimizer
+} // namespace ast
+
+#endif // PURITY_HH
@@ -0,0 +1,213 @@
+#ifndef REWRITER_HH
+#define REWRITER_HH
+
+#include <vector>
+
+#include "../ast/nodes.hh"
+
+namespace ast {
+namespace optimizer {
+
+// Give e, a node built by a pass, the type it has in the typed tree.
+template <typename T> T *typed(T *e, Type type) {
+  e->set_type(type);
+  return e;
+}
+
+// A visitor replacing expressions of a tree from the bottom up: rewrite(e)
+// returns the expression replacing e. The tree is walked depth first with
+// an explicit stack rather than recursion, so that the native stack usage
+// of a pass does not depend on the depth of the tree.
+//
+// enter(node) is called before the children of node are rewritten, and may
+// return false to keep them as they are. A visit of node follows once its
+// children are replaced, and leaves in result the expression replacing it,
+// which is the node itself by default. Declarations are visited but never
+// replaced. The sequence of a let is not visited itself: its expressions
+// are children of the let.
+class Rewriter : public ASTVisitor {
+  struct Frame {
+    Node *node;
+    // Index of the next child to rewrite.
+    size_t next;
+  };
+
+  // The i-th child of node to rewrite, or nullptr after the last one.
+  static Node *child(Node &node, size_t i) {
+    switch (node.kind) {
+    case k_binary_operator: {
+      auto &binop = static_cast<BinaryOperator &>(node);
+      return i == 0   ? &binop.get_left()
+             : i == 1 ? &binop.get_right()
+                      : nullptr;
+    }
+    case k_sequence: {
+      auto &exprs = static_cast<Sequence &>(node).get_exprs();
+      return i < exprs.size() ? exprs[i] : nullptr;
+    }
+    case k_let: {
+      auto &let = static_cast<Let &>(node);
+      auto &decls = let.get_decls();
+      if (i < decls.size())
+        return decls[i];
+      auto &exprs = let.get_sequence().get_exprs();
+      return i - decls.size() < exprs.size() ? exprs[i - decls.size()]
+                                              : nullptr;
+    }
+    case k_if_then_else: {
+      auto &ite = static_cast<IfThenElse &>(node);
+      return i == 0   ? &ite.get_condition()
+             : i == 1 ? &ite.get_then_part()
+             : i == 2 ? &ite.get_else_part()
+                      : nullptr;
+    }
+    case k_var_decl: {
+      auto expr = static_cast<VarDecl &>(node).get_expr();
+      return i == 0 && expr ? &*expr : nullptr;
+    }
+    case k_fun_decl: {
+      auto expr = static_cast<FunDecl &>(node).get_expr();
+      return i == 0 && expr ? &*expr : nullptr;
+    }
+    case k_fun_call: {
+      auto &args = static_cast<FunCall &>(node).get_args();
+      return i < args.size() ? args[i] : nullptr;
+    }
+    case k_while_loop: {
+      auto &loop = static_cast<WhileLoop &>(node);
+      return i == 0   ? &loop.get_condition()
+             : i == 1 ? &loop.get_body()
+                      : nullptr;
+    }
+    case k_for_loop: {
+      auto &loop = static_cast<ForLoop &>(node);
+      return i == 0   ? static_cast<Node *>(&loop.get_variable())
+             : i == 1 ? &loop.get_high()
+             : i == 2 ? &loop.get_body()
+                      : nullptr;
+    }
+    case k_assign:
+      return i == 0 ? &static_cast<Assign &>(node).get_rhs() : nullptr;
+    default:
+      return nullptr;
+    }
+  }
+
+  // Replace the i-th child of node by e, unless it is a declaration.
+  static void set_child(Node &node, size_t i, Expr *e) {
+    switch (node.kind) {
+    case k_binary_operator: {
+      auto &binop = static_cast<BinaryOperator &>(node);
+      i == 0 ? binop.set_left(e) : binop.set_right(e);
+      return;
+    }
+    case k_sequence:
+      static_cast<Sequence &>(node).get_exprs()[i] = e;
+      return;
+    case k_let: {
+      auto &let = static_cast<Let &>(node);
+      const size_t decls = let.get_decls().size();
+      if (i >= decls)
+        let.get_sequence().get_exprs()[i - decls] = e;
+      return;
+    }
+    case k_if_then_else: {
+      auto &ite = static_cast<IfThenElse &>(node);
+      i == 0   ? ite.set_condition(e)
+      : i == 1 ? ite.set_then_part(e)
+               : ite.set_else_part(e);
+      return;
+    }
+    case k_var_decl:
+      static_cast<VarDecl &>(node).set_expr(e);
+      return;
+    case k_fun_decl:
+      static_cast<FunDecl &>(node).set_expr(e);
+      return;
+    case k_fun_call:
+      static_cast<FunCall &>(node).get_args()[i] = e;
+      return;
+    case k_while_loop: {
+      auto &loop = static_cast<WhileLoop &>(node);
+      i == 0 ? loop.set_condition(e) : loop.set_body(e);
+      return;
+    }
+    case k_for_loop: {
+      auto &loop = static_cast<ForLoop &>(node);
+      if (i == 1)
+        loop.set_high(e);
+      else if (i == 2)
+        loop.set_body(e);
+      return;
+    }
+    case k_assign:
+      static_cast<Assign &>(node).set_rhs(e);
+      return;
+    default:
+      return;
+    }
+  }
+
+  // Visit node, whose children are rewritten, and return what replaces it.
+  Expr *leave(Node &node) {
+    const bool decl = node.kind == k_var_decl || node.kind == k_fun_decl;
+    result = decl ? nullptr : static_cast<Expr *>(&node);
+    node.accept(*this);
+    return result;
+  }
+
+  Expr *run(Node &root) {
+    if (!enter(root))
+      return leave(root);
+    std::vector<Frame> stack(1, Frame{&root, 0});
+    for (;;) {
+      Frame &top = stack.back();
+      if (Node *c = child(*top.node, top.next)) {
+        if (enter(*c))
+          stack.push_back(Frame{c, 0});
+        else {
+          Node &parent = *top.node;
+          const size_t i = top.next++;
+          set_child(parent, i, leave(*c));
+        }
+        continue;
+      }
+      Node &node = *top.node;
+      stack.pop_back();
+      Expr *replacement = leave(node);
+      if (stack.empty())
+        return replacement;
+      Frame &parent = stack.back();
+      set_child(*parent.node, parent.next++, replacement);
+    }
+  }
+
+protected:
+  Expr *result = nullptr;
+
+  virtual bool enter(Node &) { return true; }
+
+public:
+  Expr *rewrite(Expr &e) { return run(e); }
+  void rewrite(Decl &decl) { run(decl); }
+
+  virtual void visit(IntegerLiteral &) {}
+  virtual void visit(StringLiteral &) {}
+  virtual void visit(BinaryOperator &) {}
+  virtual void visit(Sequence &) {}
+  virtual void visit(Let &) {}
+  virtual void visit(Identifier &) {}
+  virtual void visit(IfThenElse &) {}
+  virtual void visit(VarDecl &) {}
+  virtual void visit(FunDecl &) {}
+  virtual void visit(FunCall &) {}
+  virtual void visit(WhileLoop &) {}
+  virtual void visit(ForLoop &) {}
+  virtual void visit(Break &) {}
+  virtual void visit(Assign &) {}
+};
+
+} // namespace optimizer
+} // namespace ast
+
+#endif // REWRITER_HH
@@ -0,0 +1,239 @@
+#include "simplifier.hh"
+#include "purity.hh"
+#include "rewriter.hh"
+#include "../ast/traversal.hh"
+
+namespace ast {
+namespace optimizer {
+
+namespace {
+
+int32_t value_of(const Expr &e) {
+  return static_cast<const IntegerLiteral &>(e).value;
+}
+
+bool compare(Operator op, int32_t l, int32_t r) {
+  switch (op) {
+  case o_eq:
+    return l == r;
+  case o_neq:
+    return l != r;
+  case o_lt:
+    return l < r;
+  case o_le:
+    return l <= r;
+  case o_gt:
+    return l > r;
+  default:
+    return l >= r;
+  }
+}
+
+// Each visit leaves in result the expression replacing the node visited,
+// which may be the node itself, once its children are simplified.
+class Simplifier : public Rewriter {
+  // Replace e, which is disposed of, by a literal of the given value.
+  Expr *literal(Expr &e, int32_t value) {
+    auto lit = new IntegerLiteral(e.loc, value);
+    if (e.get_type() != t_undef)
+      lit->set_type(e.get_type());
+    return replace(e, lit);
+  }
+
+  // Replace e, which is disposed of, by keep, which must have been
+  // detached from it.
+  Expr *replace(Expr &e, Expr *keep) {
+    Node::dispose(&e);
+    rewrites++;
+    return keep;
+  }
+
+  // Replace e, whose operands are x and a literal, by x + k.
+  Expr *add_constant(BinaryOperator &e, Expr *x, uint32_t k) {
+    if (!k)
+      return replace(e, x);
+    Operator op = o_plus;
+    if (int32_t(k) < 0) {
+      op = o_minus;
+      k = -k;
+    }
+    auto constant = new IntegerLiteral(e.get_right().loc, k);
+    auto sum = new BinaryOperator(e.loc, x, constant, op);
+    if (e.get_type() != t_undef) {
+      constant->set_type(t_int);
+      sum->set_type(e.get_type());
+    }
+    return replace(e, sum);
+  }
+
+  // Splice the sequences of seq into it.
+  void flatten(Sequence &seq) {
+    auto &exprs = seq.get_exprs();
+    std::vector<Expr *> flat;
+    for (size_t i = 0; i < exprs.size(); i++) {
+      Expr *e = exprs[i];
+      // The value of an empty sequence is not that of what precedes it.
+      if (e->kind == k_sequence &&
+          (i + 1 < exprs.size() ||
+           !static_cast<Sequence *>(e)->get_exprs().empty())) {
+        auto &inner = static_cast<Sequence *>(e)->get_exprs();
+        flat.insert(flat.end(), inner.begin(), inner.end());
+        inner.clear();
+        Node::dispose(e);
+        rewrites++;
+      } else
+        flat.push_back(e);
+    }
+    exprs.assign(flat.begin(), flat.end());
+  }
+
+public:
+  size_t rewrites = 0;
+
+  virtual void visit(BinaryOperator &binop) {
+    Expr &left = binop.get_left(), &right = binop.get_right();
+    const bool l_literal = left.kind == k_integer_literal,
+               r_literal = right.kind == k_integer_literal;
+
+    if (l_literal && r_literal) {
+      const int32_t l = value_of(left), r = value_of(right);
+      switch (binop.op) {
+      case o_plus:
+        result = literal(binop, uint32_t(l) + uint32_t(r));
+        return;
+      case o_minus:
+        result = literal(binop, uint32_t(l) - uint32_t(r));
+        return;
+      case o_times:
+        result = literal(binop, uint32_t(l) * uint32_t(r));
+        return;
+      case o_divide:
+        if (r)
+          result =
+              literal(binop, l == INT32_MIN && r == -1 ? INT32_MIN : l / r);
+        return;
+      default:
+        result = literal(binop, compare(binop.op, l, r));
+        return;
+      }
+    }
+    if (left.kind == k_string_literal && right.kind == k_string_literal &&
+        (binop.op == o_eq || binop.op == o_neq)) {
+      const bool equal = static_cast<StringLiteral &>(left).value ==
+                         static_cast<StringLiteral &>(right).value;
+      result = literal(binop, equal == (binop.op == o_eq));
+      return;
+    }
+
+    switch (binop.op) {
+    case o_plus:
+    case o_minus:
+      if (r_literal) {
+        uint32_t k = value_of(right);
+        if (binop.op == o_minus)
+          k = -k;
+        // (x + k1) + k2 is x + (k1 + k2).
+        if (left.kind == k_binary_operator) {
+          auto &inner = static_cast<BinaryOperator &>(left);
+          if ((inner.op == o_plus || inner.op == o_minus) &&
+              inner.get_right().kind == k_integer_literal) {
+            const uint32_t k1 = value_of(inner.get_right());
+            Expr *x = &inner.get_left();
+            inner.set_left(nullptr);
+            result = add_constant(binop, x,
+                                  (inner.op == o_plus ? k1 : -k1) + k);
+            return;
+          }
+        }
+        if (!k) {
+          binop.set_left(nullptr);
+          result = replace(binop, &left);
+        }
+        return;
+      }
+      if (binop.op == o_plus && is_literal(left, 0)) {
+        binop.set_right(nullptr);
+        result = replace(binop, &right);
+        return;
+      }
+      // 0 - (0 - x) is x.
+      if (is_literal(left, 0) && right.kind == k_binary_operator) {
+        auto &inner = static_cast<BinaryOperator &>(right);
+        if (inner.op == o_minus && is_literal(inner.get_left(), 0)) {
+          Expr *x = &inner.get_right();
+          inner.set_right(nullptr);
+          result = replace(binop, x);
+        }
+      }
+      return;
+    case o_times:
+      if (is_literal(right, 1) || is_literal(left, 1)) {
+        Expr *x = is_literal(right, 1) ? &left : &right;
+        (x == &left ? binop.set_left(nullptr) : binop.set_right(nullptr));
+        result = replace(binop, x);
+      } else if ((is_literal(right, 0) && is_pure(left)) ||
+                 (is_literal(left, 0) && is_pure(right)))
+        result = literal(binop, 0);
+      return;
+    case o_divide:
+      if (is_literal(right, 1)) {
+        binop.set_left(nullptr);
+        result = replace(binop, &left);
+      }
+      return;
+    default:
+      return;
+    }
+  }
+
+  virtual void visit(Sequence &seq) {
+    flatten(seq);
+    auto &exprs = seq.get_exprs();
+    if (exprs.size() == 1) {
+      Expr *e = exprs[0];
+      exprs.clear();
+      result = replace(seq, e);
+    }
+  }
+
+  // The sequence of a let stays one.
+  virtual void visit(Let &let) { flatten(let.get_sequence()); }
+
+  virtual void visit(IfThenElse &ite) {
+    Expr &condition = ite.get_condition();
+    if (condition.kind == k_integer_literal) {
+      Expr *chosen;
+      if (value_of(condition)) {
+        chosen = &ite.get_then_part();
+        ite.set_then_part(nullptr);
+      } else {
+        chosen = &ite.get_else_part();
+        ite.set_else_part(nullptr);
+      }
+      result = replace(ite, chosen);
+      return;
+    }
+    if (condition.kind == k_binary_operator &&
+        static_cast<BinaryOperator &>(condition).op >= o_eq &&
+        is_literal(ite.get_then_part(), 1) &&
+        is_literal(ite.get_else_part(), 0)) {
+      ite.set_condition(nullptr);
+      result = replace(ite, &condition);
+    }
+  }
+};
+
+} // namespace
+
+SimplifierStats simplify(FunDecl &main) {
+  SimplifierStats stats;
+  stats.nodes_before = count_nodes(main);
+  Simplifier simplifier;
+  simplifier.rewrite(main);
+  stats.nodes_after = count_nodes(main);
+  stats.rewrites = simplifier.rewrites;
+  return stats;
+}
+
+} // namespace optimizer
+} // namespace ast
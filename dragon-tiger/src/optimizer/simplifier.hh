@@ -0,0 +1,42 @@
+#ifndef SIMPLIFIER_HH
+#define SIMPLIFIER_HH
+
+#include <cstddef>
+
+#include "../ast/nodes.hh"
+
+namespace ast {
+namespace optimizer {
+
+// The simplifier rewrites a bound program in place, bottom up:
+//
+//   - arithmetic and comparisons of integer literals are folded with the
+//     semantics of the runtime: operations wrap around on overflow, and
+//     INT_MIN / -1 is INT_MIN, but divisions by zero are left for the
+//     program to fail at runtime;
+//   - equality of string literals is folded;
+//   - x + 0, 0 + x, x - 0, x * 1, 1 * x, x / 1 and 0 - (0 - x) become x,
+//     x * 0 and 0 * x become 0 when x has no effect, and constants added to
+//     or subtracted from x are combined;
+//   - `if' with a literal condition becomes the chosen branch, and
+//     `if c then 1 else 0' becomes c when c is a comparison;
+//   - sequences nested in sequences are flattened, and a sequence of one
+//     expression becomes that expression.
+//
+// Removed nodes are disposed of. The binder must have run: the rewrite
+// keeps its results valid, and semantic errors in code found dead are
+// still reported.
+
+struct SimplifierStats {
+  size_t nodes_before;
+  size_t nodes_after;
+  // The number of rewrites applied.
+  size_t rewrites;
+};
+
+SimplifierStats simplify(FunDecl &main);
+
+} // namespace optimizer
+} // namespace ast
+
+#endif // SIMPLIFIER_HH
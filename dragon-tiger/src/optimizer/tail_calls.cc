@@ -0,0 +1,372 @@
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "tail_calls.hh"
+#include "components.hh"
+#include "rewriter.hh"
+#include "../ast/traversal.hh"
+#include "../binder/escapes.hh"
+
+namespace ast {
+namespace optimizer {
+
+namespace {
+
+// An expression in tail position: the body of a function, a branch of an
+// if, or the last expression of a sequence.
+struct Position {
+  Node *parent;
+  bool else_part;
+
+  Expr &get() const {
+    switch (parent->kind) {
+    case k_fun_decl:
+      return *static_cast<FunDecl *>(parent)->get_expr();
+    case k_if_then_else: {
+      auto ite = static_cast<IfThenElse *>(parent);
+      return else_part ? ite->get_else_part() : ite->get_then_part();
+    }
+    default:
+      return *static_cast<Sequence *>(parent)->get_exprs().back();
+    }
+  }
+
+  void set(Expr *e) const {
+    switch (parent->kind) {
+    case k_fun_decl:
+      static_cast<FunDecl *>(parent)->set_expr(e);
+      break;
+    case k_if_then_else: {
+      auto ite = static_cast<IfThenElse *>(parent);
+      (else_part ? ite->set_else_part(e) : ite->set_then_part(e));
+      break;
+    }
+    default:
+      static_cast<Sequence *>(parent)->get_exprs().back() = e;
+      break;
+    }
+  }
+};
+
+// The positions of the calls made in tail position by f.
+std::vector<Position> tail_calls(FunDecl &f) {
+  std::vector<Position> calls, todo(1, Position{&f, false});
+  while (!todo.empty()) {
+    const Position p = todo.back();
+    todo.pop_back();
+    Expr &e = p.get();
+    switch (e.kind) {
+    case k_fun_call:
+      calls.push_back(p);
+      break;
+    case k_if_then_else:
+      todo.push_back(Position{&e, true});
+      todo.push_back(Position{&e, false});
+      break;
+    case k_let:
+      if (!static_cast<Let &>(e).get_sequence().get_exprs().empty())
+        todo.push_back(Position{&static_cast<Let &>(e).get_sequence(), false});
+      break;
+    case k_sequence:
+      if (!static_cast<Sequence &>(e).get_exprs().empty())
+        todo.push_back(Position{&e, false});
+      break;
+    default:
+      break;
+    }
+  }
+  return calls;
+}
+
+FunDecl &callee(const Position &p) {
+  return *static_cast<FunCall &>(p.get()).get_decl();
+}
+
+// A group of functions of the same let calling each other in tail position,
+// and the function running their bodies in a loop.
+class Group {
+  std::vector<FunDecl *> members;
+  // The parameters assigned by jumps to each member: its own, or those of
+  // f standing for them.
+  std::vector<std::vector<VarDecl *>> params;
+  FunDecl *f;
+  const int depth;
+  const Type type;
+  VarDecl *tag = nullptr, *again = nullptr, *result = nullptr;
+  unsigned &counter;
+
+  VarDecl *local(const SourceLoc &loc, const std::string &name, Type t,
+                 Expr *init) {
+    VarDecl *decl = new VarDecl(loc, Symbol(name), boost::none, init);
+    decl->set_type(t);
+    decl->set_depth(depth);
+    decl->set_slot(f->get_frame_size()++);
+    return decl;
+  }
+
+  Identifier *identifier(const SourceLoc &loc, VarDecl &decl) {
+    Identifier *id = new Identifier(loc, decl.name);
+    id->set_decl(&decl);
+    id->set_depth(depth);
+    return typed(id, decl.get_type());
+  }
+
+  Assign *assign(const SourceLoc &loc, VarDecl &decl, Expr *rhs) {
+    return typed(new Assign(loc, identifier(loc, decl), rhs), t_void);
+  }
+
+  Expr *integer(const SourceLoc &loc, int32_t value) {
+    return typed(new IntegerLiteral(loc, value), t_int);
+  }
+
+  // The value given to a variable of type t before it is assigned.
+  Expr *default_value(const SourceLoc &loc, Type t) {
+    if (t == t_string)
+      return typed(new StringLiteral(loc, Symbol("")), t_string);
+    return integer(loc, 0);
+  }
+
+  // Replace the call at p, to the member of index target, by assignments
+  // of its arguments to the parameters of the member. The arguments are
+  // all evaluated first, since they may use the parameters.
+  void jump(const Position &p, size_t target) {
+    FunCall &call = static_cast<FunCall &>(p.get());
+    const SourceLoc &loc = call.loc;
+    auto &args = call.get_args();
+    const auto &to = params[target];
+    std::vector<Decl *> temps;
+    std::vector<Expr *> exprs;
+    if (args.size() == 1)
+      exprs.push_back(assign(loc, *to[0], args[0]));
+    else
+      for (size_t i = 0; i < args.size(); i++) {
+        VarDecl *temp =
+            local(loc, to[i]->name.get().to_string() + "_" +
+                           std::to_string(++counter),
+                  to[i]->get_type(), args[i]);
+        temps.push_back(temp);
+        exprs.push_back(assign(loc, *to[i], identifier(loc, *temp)));
+      }
+    args.clear();
+    if (tag)
+      exprs.push_back(assign(loc, *tag, integer(loc, target)));
+    exprs.push_back(assign(loc, *again, integer(loc, 1)));
+    if (type != t_void)
+      exprs.push_back(default_value(loc, type));
+    Expr *replacement = typed(new Sequence(loc, exprs), type);
+    if (!temps.empty())
+      replacement = typed(
+          new Let(loc, temps, static_cast<Sequence *>(replacement)), type);
+    Node::dispose(&call);
+    p.set(replacement);
+  }
+
+  // Give f a tag, then a parameter for each parameter of the members,
+  // named after both, and move into its frame the variables of the
+  // members and the functions nested in them.
+  void merge() {
+    std::string name, external_name;
+    for (auto m : members) {
+      name += (name.empty() ? "" : "_") + m->name.get().to_string();
+      external_name += (external_name.empty() ? "" : "_") +
+                       m->get_external_name().get().to_string();
+    }
+    FunDecl &first = *members[0];
+    f = new FunDecl(first.loc, Symbol(name), first.type_name,
+                    std::vector<VarDecl *>(), nullptr);
+    f->set_parent(&*first.get_parent());
+    f->set_depth(depth);
+    f->set_external_name(Symbol(external_name));
+    f->set_type(type);
+    f->set_frame_size(0);
+    tag = parameter(first.loc, "tag", Symbol("int"), t_int);
+    std::unordered_map<VarDecl *, VarDecl *> renamed;
+    for (size_t i = 0; i < members.size(); i++)
+      for (auto &param : params[i]) {
+        VarDecl *copy = parameter(param->loc,
+                                  members[i]->name.get().to_string() + "_" +
+                                      param->name.get().to_string(),
+                                  param->type_name, param->get_type());
+        renamed[param] = copy;
+        param = copy;
+      }
+    for (auto m : members) {
+      const int offset = f->get_frame_size() - m->get_params().size();
+      walk(*m->get_expr(),
+           [&](Node &node) {
+             switch (node.kind) {
+             case k_var_decl: {
+               auto &decl = static_cast<VarDecl &>(node);
+               if (decl.get_depth() == depth)
+                 decl.get_slot() += offset;
+               break;
+             }
+             case k_fun_decl: {
+               auto &decl = static_cast<FunDecl &>(node);
+               if (&*decl.get_parent() == m)
+                 decl.reparent(f);
+               break;
+             }
+             case k_identifier: {
+               auto &id = static_cast<Identifier &>(node);
+               auto param = renamed.find(&*id.get_decl());
+               if (param != renamed.end())
+                 id.rebind(param->second);
+               break;
+             }
+             default:
+               break;
+             }
+           },
+           [](Node &) {});
+      f->get_frame_size() += m->get_frame_size() - m->get_params().size();
+    }
+  }
+
+  VarDecl *parameter(const SourceLoc &loc, const std::string &name,
+                     const optional<Symbol> &type_name, Type t) {
+    VarDecl *param = new VarDecl(loc, Symbol(name), type_name, nullptr);
+    param->set_type(t);
+    param->set_depth(depth);
+    param->set_slot(f->get_frame_size()++);
+    f->get_params().push_back(param);
+    return param;
+  }
+
+  // Make member m of index i a call to f.
+  void forward(FunDecl &m, size_t i) {
+    const SourceLoc &loc = m.loc;
+    std::vector<Expr *> args(1, integer(loc, i));
+    for (size_t j = 0; j < members.size(); j++)
+      for (size_t k = 0; k < params[j].size(); k++)
+        args.push_back(j == i ? identifier(loc, *m.get_params()[k])
+                              : default_value(loc, params[j][k]->get_type()));
+    m.get_frame_size() = m.get_params().size();
+    FunCall *call = new FunCall(loc, args, f->name);
+    call->set_decl(f);
+    call->set_depth(depth);
+    m.set_expr(typed(call, type));
+  }
+
+public:
+  size_t jumps = 0;
+
+  Group(const std::vector<FunDecl *> &_members, unsigned &_counter)
+      : members(_members), f(_members[0]), depth(f->get_depth()),
+        type(f->get_type()), counter(_counter) {
+    for (auto m : members)
+      params.emplace_back(m->get_params().begin(), m->get_params().end());
+  }
+
+  void run(Let &let) {
+    if (members.size() > 1)
+      merge();
+    const SourceLoc &loc = f->loc;
+    again = local(loc, "again", t_int, integer(loc, 1));
+    if (type != t_void)
+      result = local(loc, "result", type, default_value(loc, type));
+    for (auto m : members)
+      for (auto &p : tail_calls(*m)) {
+        auto target = std::find(members.begin(), members.end(), &callee(p));
+        if (target == members.end())
+          continue;
+        jump(p, target - members.begin());
+        jumps++;
+      }
+
+    // The bodies of the members, chosen by the tag.
+    Expr *body = &*members.back()->get_expr();
+    for (size_t i = members.size() - 1; i-- > 0;) {
+      Expr *test = typed(new BinaryOperator(loc, identifier(loc, *tag),
+                                            integer(loc, i), o_eq),
+                         t_int);
+      body = typed(
+          new IfThenElse(loc, test, &*members[i]->get_expr(), body), type);
+    }
+    for (auto m : members)
+      m->set_expr(nullptr);
+
+    std::vector<Expr *> iteration;
+    iteration.push_back(assign(loc, *again, integer(loc, 0)));
+    iteration.push_back(result ? assign(loc, *result, body) : body);
+    Expr *loop = typed(
+        new WhileLoop(loc, identifier(loc, *again),
+                      typed(new Sequence(loc, iteration), t_void)),
+        t_void);
+    std::vector<Expr *> exprs(1, loop);
+    std::vector<Decl *> decls(1, again);
+    if (result) {
+      exprs.push_back(identifier(loc, *result));
+      decls.push_back(result);
+    }
+    f->set_expr(typed(
+        new Let(loc, decls, typed(new Sequence(loc, exprs), type)), type));
+
+    if (members.size() > 1) {
+      for (size_t i = 0; i < members.size(); i++)
+        forward(*members[i], i);
+      auto &decls = let.get_decls();
+      decls.insert(std::find(decls.begin(), decls.end(), members[0]), f);
+    }
+  }
+};
+
+} // namespace
+
+TailCallStats eliminate_tail_calls(FunDecl &main) {
+  std::vector<Let *> lets;
+  walk(main,
+       [&](Node &node) {
+         if (node.kind == k_let)
+           lets.push_back(&static_cast<Let &>(node));
+       },
+       [](Node &) {});
+
+  TailCallStats stats{0, 0};
+  unsigned counter = 0;
+  for (auto let : lets) {
+    std::vector<FunDecl *> functions;
+    for (auto decl : let->get_decls())
+      if (decl->kind == k_fun_decl)
+        functions.push_back(static_cast<FunDecl *>(decl));
+    if (functions.empty())
+      continue;
+    // The functions of the let called in tail position by each of them.
+    std::unordered_map<FunDecl *, std::vector<FunDecl *>> callees;
+    for (auto f : functions)
+      for (auto &p : tail_calls(*f)) {
+        FunDecl *g = &callee(p);
+        auto &to = callees[f];
+        if (std::find(functions.begin(), functions.end(), g) !=
+                functions.end() &&
+            std::find(to.begin(), to.end(), g) == to.end())
+          to.push_back(g);
+      }
+    auto components = strong_components(
+        functions, [&](FunDecl *f) { return callees[f]; });
+    for (auto &component : components) {
+      FunDecl *f = component[0];
+      if (component.size() == 1 &&
+          std::find(callees[f].begin(), callees[f].end(), f) ==
+              callees[f].end())
+        continue;
+      // Members are kept in the order of the program.
+      std::sort(component.begin(), component.end(),
+                [&](FunDecl *a, FunDecl *b) {
+                  return std::find(functions.begin(), functions.end(), a) <
+                         std::find(functions.begin(), functions.end(), b);
+                });
+      Group group(component, counter);
+      group.run(*let);
+      stats.functions += component.size();
+      stats.calls += group.jumps;
+    }
+  }
+  if (stats.calls)
+    binder::find_escapes(main);
+  return stats;
+}
+
+} // namespace optimizer
+} // namespace ast
@@ -0,0 +1,39 @@
+#ifndef TAIL_CALLS_HH
+#define TAIL_CALLS_HH
+
+#include <cstddef>
+
+#include "../ast/nodes.hh"
+
+namespace ast {
+namespace optimizer {
+
+// Calls in tail position, whose value is that of the function making them
+// (the body itself, the branches of an if, the last expression of a
+// sequence or of a let), are turned into jumps when they call the function
+// itself or another function of the same let calling it back through tail
+// calls. The body of such a function runs in a loop:
+//
+//   let var again := 1 var result := 0
+//   in while again do (again := 0; result := <body>); result end
+//
+// where a jump assigns the arguments to the parameters and sets again.
+// Functions of a let calling each other are merged into one function,
+// whose first parameter tells which body to run; the functions themselves
+// become calls to it.
+//
+// Recursion through tail calls then runs in constant stack, whatever the
+// backend. The program must be bound and typed.
+
+struct TailCallStats {
+  // Functions whose tail calls became jumps, and those calls.
+  size_t functions;
+  size_t calls;
+};
+
+TailCallStats eliminate_tail_calls(FunDecl &main);
+
+} // namespace optimizer
+} // namespace ast
+
+#endif // TAIL_CALLS_HH
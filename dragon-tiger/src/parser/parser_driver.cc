@@ -1,13 +1,120 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "parser_driver.hh"
 #include "../utils/errors.hh"
+#include "../utils/source_map.hh"
 #include "tiger_parser.hh"
 
+namespace {
+
+// Read everything from fd into storage, followed by two NUL bytes.
+bool read_all(int fd, std::vector<char> &storage, size_t size_hint) {
+  storage.resize((size_hint ? size_hint + 1 : 64 * 1024) + 2);
+  size_t size = 0;
+  for (;;) {
+    if (storage.size() - size < 2 + 1)
+      storage.resize(storage.size() * 2);
+    ssize_t n = read(fd, storage.data() + size, storage.size() - size - 2);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return false;
+    if (n == 0)
+      break;
+    size += n;
+  }
+  storage.resize(size + 2);
+  storage[size] = storage[size + 1] = '\0';
+  return true;
+}
+
+} // namespace
+
+void ParserDriver::load(const std::string &f) {
+  const bool is_stdin = f.empty() || f == "-";
+  const int fd = is_stdin ? STDIN_FILENO : open(f.c_str(), O_RDONLY);
+  if (fd < 0)
+    utils::error("cannot open " + f + ": " + strerror(errno));
+
+  struct stat st;
+  const bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+  const size_t size = regular ? st.st_size : 0;
+
+  // The scanner needs two NUL bytes after the text and writes into its
+  // buffer. A private mapping provides both for free as long as they fit
+  // in the zero-filled tail of the last page.
+  const size_t page = sysconf(_SC_PAGESIZE);
+  if (regular && size % page != 0 && size % page <= page - 2) {
+    void *p = mmap(nullptr, size + 2, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      source = static_cast<char *>(p);
+      source_size = size + 2;
+      source_mapped = true;
+      close(fd);
+      return;
+    }
+  }
+
+  const bool ok = read_all(fd, storage, size);
+  const int saved_errno = errno;
+  if (!is_stdin)
+    close(fd);
+  if (!ok)
+    utils::error("cannot read " + f + ": " + strerror(saved_errno));
+  source = storage.data();
+  source_size = storage.size();
+}
+
+void ParserDriver::unload() {
+  if (source_mapped)
+    munmap(source, source_size);
+  source = nullptr;
+  source_size = 0;
+  source_mapped = false;
+  storage = std::vector<char>();
+}
+
 bool ParserDriver::parse(const std::string &f) {
   file = f;
+  load(f);
+  bool ok = run_parser();
+  unload();
+  return ok;
+}
+
+bool ParserDriver::parse(const std::string &name, const char *text, size_t size) {
+  file = name;
+  storage.reserve(size + 2);
+  storage.assign(text, text + size);
+  storage.push_back('\0');
+  storage.push_back('\0');
+  source = storage.data();
+  source_size = storage.size();
+  bool ok = run_parser();
+  unload();
+  return ok;
+}
+
+bool ParserDriver::run_parser() {
+  // Nodes record their location relative to this source map.
+  const utils::SourceMap &source_map =
+      utils::SourceMap::add(file, source, source_size - 2);
+  utils::SourceMap::Scope source_map_scope(&source_map);
   lex_begin();
   yy::tiger_parser parser(*this);
   parser.set_debug_level(trace_parser);
-  int res = parser.parse();
+  int res;
+  try {
+    res = parser.parse();
+  } catch (...) {
+    lex_end();
+    throw;
+  }
   lex_end();
   return res == 0;
 }
@@ -1,9 +1,15 @@
 #include "../ast/nodes.hh"
 #include "tiger_parser.hh"
 #include <string>
+#include <vector>
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
 
 // Tell Flex the lexer's prototype ...
-#define YY_DECL yy::tiger_parser::symbol_type yylex(ParserDriver &driver)
+#define YY_DECL yy::tiger_parser::symbol_type yylex(ParserDriver &driver, yyscan_t yyscanner)
 // ... and declare it for the parser's sake.
 YY_DECL;
 
@@ -11,7 +17,10 @@ class ParserDriver {
 public:
   ParserDriver(bool _trace_lexer, bool _trace_parser) :
     trace_lexer(_trace_lexer), trace_parser(_trace_parser) {}
-  virtual ~ParserDriver() {};
+  virtual ~ParserDriver() { unload(); };
+
+  ParserDriver &operator=(const ParserDriver &) = delete;
+  ParserDriver(const ParserDriver &) = delete;
 
   // Handling the lexer.
   void lex_begin();
@@ -21,14 +30,43 @@ public:
   bool trace_lexer;
   bool trace_parser;
 
+  // The scanner state. Each driver has its own, so that several parsers
+  // can run at the same time.
+  yyscan_t scanner = nullptr;
+  yy::location loc;
+  int comment_depth = 0;
+  std::string string_buffer;
+
   // The parser produced AST
   Expr *result_ast;
 
-  // Run the parser on file f.
+  // Run the parser on file f ("-" is the standard input).
   // Returns true on success.
   bool parse(const std::string &f);
 
+  // Run the parser on the size bytes at text, which are reported as coming
+  // from file name.
+  // Returns true on success.
+  bool parse(const std::string &name, const char *text, size_t size);
+
   // The name of the file being parsed.
   // Used later to pass the file name to the location tracker.
   std::string file;
+
+private:
+  // The source being scanned, followed by the two NUL bytes the scanner
+  // expects. It is either mapped from the input file or held in storage.
+  char *source = nullptr;
+  size_t source_size = 0;
+  bool source_mapped = false;
+  std::vector<char> storage;
+
+  void load(const std::string &f);
+  void unload();
+  bool run_parser();
 };
+
+// The parser only knows about the driver, which holds the scanner.
+inline yy::tiger_parser::symbol_type yylex(ParserDriver &driver) {
+  return yylex(driver, driver.scanner);
+}
@@ -10,16 +10,11 @@
 
 #define TIGER_INT_MAX  2147483647  /*  2^31 - 1 */
 
-# undef yywrap
-# define yywrap() 1
-
-// The location of the current token
-static yy::location loc;
-static int comment_depth = 0;
-static std::string string_buffer;
+// The scanner state (location of the current token, comment depth and
+// string being built) lives in the driver, so that scanners are reentrant.
 %}
 
-%option noyywrap nounput batch debug noinput
+%option reentrant noyywrap nounput batch debug noinput
 
 lineterminator  \r|\n|\r\n
 blank           [ \t\f]
@@ -33,137 +28,140 @@ int             [0-9]+
 
 %{
   /* Each time a pattern is found, set the end cursor to the matched width */
-  # define YY_USER_ACTION loc.columns (yyleng);
+  # define YY_USER_ACTION driver.loc.columns (yyleng);
 %}
 
 %%
 %{
   /* Before running the lexer, set the initial cursor position */
-  loc.step ();
+  driver.loc.step ();
 %}
 
   /* Each time a line ends, increase the cursor line position and reset the
      begin column position */
-{lineterminator}+   loc.lines (yyleng); loc.step ();
+{lineterminator}+   driver.loc.lines (yyleng); driver.loc.step ();
   /* When a blank is found skip it by updating the begin cursor column position */
-{blank}+   loc.step();
+{blank}+   driver.loc.step();
 
  /* Symbols */
 
-":"      return yy::tiger_parser::make_COLON(loc);
-","      return yy::tiger_parser::make_COMMA(loc);
-";"      return yy::tiger_parser::make_SEMICOLON(loc);
-"("      return yy::tiger_parser::make_LPAREN(loc);
-")"      return yy::tiger_parser::make_RPAREN(loc);
-"{"      return yy::tiger_parser::make_LBRACE(loc);
-"}"      return yy::tiger_parser::make_RBRACE(loc);
-"+"      return yy::tiger_parser::make_PLUS(loc);
-"-"      return yy::tiger_parser::make_MINUS(loc);
-"*"      return yy::tiger_parser::make_TIMES(loc);
-"/"      return yy::tiger_parser::make_DIVIDE(loc);
-"="      return yy::tiger_parser::make_EQ(loc);
-"<>"     return yy::tiger_parser::make_NEQ(loc);
-"<"      return yy::tiger_parser::make_LT(loc);
-"<="     return yy::tiger_parser::make_LE(loc);
-">"      return yy::tiger_parser::make_GT(loc);
-">="     return yy::tiger_parser::make_GE(loc);
-"&"      return yy::tiger_parser::make_AND(loc);
-"|"      return yy::tiger_parser::make_OR(loc);
-":="     return yy::tiger_parser::make_ASSIGN(loc);
+":"      return yy::tiger_parser::make_COLON(driver.loc);
+","      return yy::tiger_parser::make_COMMA(driver.loc);
+";"      return yy::tiger_parser::make_SEMICOLON(driver.loc);
+"("      return yy::tiger_parser::make_LPAREN(driver.loc);
+")"      return yy::tiger_parser::make_RPAREN(driver.loc);
+"{"      return yy::tiger_parser::make_LBRACE(driver.loc);
+"}"      return yy::tiger_parser::make_RBRACE(driver.loc);
+"+"      return yy::tiger_parser::make_PLUS(driver.loc);
+"-"      return yy::tiger_parser::make_MINUS(driver.loc);
+"*"      return yy::tiger_parser::make_TIMES(driver.loc);
+"/"      return yy::tiger_parser::make_DIVIDE(driver.loc);
+"="      return yy::tiger_parser::make_EQ(driver.loc);
+"<>"     return yy::tiger_parser::make_NEQ(driver.loc);
+"<"      return yy::tiger_parser::make_LT(driver.loc);
+"<="     return yy::tiger_parser::make_LE(driver.loc);
+">"      return yy::tiger_parser::make_GT(driver.loc);
+">="     return yy::tiger_parser::make_GE(driver.loc);
+"&"      return yy::tiger_parser::make_AND(driver.loc);
+"|"      return yy::tiger_parser::make_OR(driver.loc);
+":="     return yy::tiger_parser::make_ASSIGN(driver.loc);
 
  /* Keywords */
 
-else     return yy::tiger_parser::make_ELSE(loc);
-while    return yy::tiger_parser::make_WHILE(loc);
-for      return yy::tiger_parser::make_FOR(loc);
-to       return yy::tiger_parser::make_TO (loc);
-do       return yy::tiger_parser::make_DO(loc);
-let      return yy::tiger_parser::make_LET(loc);
-in       return yy::tiger_parser::make_IN(loc);
-end      return yy::tiger_parser::make_END(loc);
-break    return yy::tiger_parser::make_BREAK(loc);
-function return yy::tiger_parser::make_FUNCTION(loc);
-var      return yy::tiger_parser::make_VAR(loc);
-if       return yy::tiger_parser::make_IF(loc);
-then     return yy::tiger_parser::make_THEN(loc);
-else     return yy::tiger_parser::make_ELSE(loc);
+else     return yy::tiger_parser::make_ELSE(driver.loc);
+while    return yy::tiger_parser::make_WHILE(driver.loc);
+for      return yy::tiger_parser::make_FOR(driver.loc);
+to       return yy::tiger_parser::make_TO (driver.loc);
+do       return yy::tiger_parser::make_DO(driver.loc);
+let      return yy::tiger_parser::make_LET(driver.loc);
+in       return yy::tiger_parser::make_IN(driver.loc);
+end      return yy::tiger_parser::make_END(driver.loc);
+break    return yy::tiger_parser::make_BREAK(driver.loc);
+function return yy::tiger_parser::make_FUNCTION(driver.loc);
+var      return yy::tiger_parser::make_VAR(driver.loc);
+if       return yy::tiger_parser::make_IF(driver.loc);
+then     return yy::tiger_parser::make_THEN(driver.loc);
+else     return yy::tiger_parser::make_ELSE(driver.loc);
 
  /* Identifiers */
-{id}       return yy::tiger_parser::make_ID(Symbol(yytext), loc);
+{id}       return yy::tiger_parser::make_ID(Symbol(yytext), driver.loc);
 
  /* Integers */
 {int} {
     errno = 0;
     long val = strtol(yytext, NULL, 10);
     if (errno != 0 || val > TIGER_INT_MAX) {
-        utils::error(loc, "integer literal out of range");
+        utils::error(driver.loc, "integer literal out of range");
     } else {
-        return yy::tiger_parser::make_INT(val, loc);
+        return yy::tiger_parser::make_INT(val, driver.loc);
     }
 }
 
  /* Strings */
-\" {BEGIN(STRING); string_buffer.clear();}
+\" {BEGIN(STRING); driver.string_buffer.clear();}
 
 <STRING>{
     /* \" and \\ */
-    "\\\""           {string_buffer.push_back('"');}
-    "\\\\"           {string_buffer.push_back('\\');}
+    "\\\""           {driver.string_buffer.push_back('"');}
+    "\\\\"           {driver.string_buffer.push_back('\\');}
 
     /* C escape characters */
-    \\[aA]           {string_buffer.push_back('\a');}
-    \\[bB]           {string_buffer.push_back('\b');}
-    \\[tT]           {string_buffer.push_back('\t');}
-    \\[nN]           {string_buffer.push_back('\n');}
-    \\[vV]           {string_buffer.push_back('\v');}
-    \\[fF]           {string_buffer.push_back('\f');}
-    \\[rR]           {string_buffer.push_back('\r');}
+    \\[aA]           {driver.string_buffer.push_back('\a');}
+    \\[bB]           {driver.string_buffer.push_back('\b');}
+    \\[tT]           {driver.string_buffer.push_back('\t');}
+    \\[nN]           {driver.string_buffer.push_back('\n');}
+    \\[vV]           {driver.string_buffer.push_back('\v');}
+    \\[fF]           {driver.string_buffer.push_back('\f');}
+    \\[rR]           {driver.string_buffer.push_back('\r');}
 
-    <<EOF>> | {lineterminator} utils::error (loc, "unterminated string");
+    <<EOF>> | {lineterminator} utils::error (driver.loc, "unterminated string");
 
     /* end of string */
     "\"" {
         BEGIN(INITIAL);
-        return yy::tiger_parser::make_STRING(Symbol(string_buffer), loc);
+        return yy::tiger_parser::make_STRING(Symbol(driver.string_buffer), driver.loc);
     }
 
-    "\\" utils::error (loc, "unescaping backslash");
+    "\\" utils::error (driver.loc, "unescaping backslash");
 
     /* All other characters are accepted */
-    . {string_buffer.push_back(yytext[0]);}
+    . {driver.string_buffer.push_back(yytext[0]);}
 }
 
  /* Comments */
 
-"/*"     {comment_depth = 1; BEGIN(COMMENT);}
+"/*"     {driver.comment_depth = 1; BEGIN(COMMENT);}
 <COMMENT>{
    /* Increase cursor line position for each new line */
-   {lineterminator}+   loc.lines (yyleng); loc.step ();
+   {lineterminator}+   driver.loc.lines (yyleng); driver.loc.step ();
 
-    "/*" {comment_depth++;}
-    "*/" {comment_depth--; if (comment_depth == 0) BEGIN(INITIAL);}
-    <<EOF>> utils::error (loc, "unterminated comment");
+    "/*" {driver.comment_depth++;}
+    "*/" {driver.comment_depth--; if (driver.comment_depth == 0) BEGIN(INITIAL);}
+    <<EOF>> utils::error (driver.loc, "unterminated comment");
     . {}
 }
 
  /* End-of-file marker */
-<<EOF>>    return yy::tiger_parser::make_EOF(loc);
+<<EOF>>    return yy::tiger_parser::make_EOF(driver.loc);
 
  /* Catch-all rule that triggers an error */
-.          utils::error (loc, "invalid character");
+.          utils::error (driver.loc, "invalid character");
 
 %%
 
+// Scan the source held by the driver in place.
 void ParserDriver::lex_begin ()
 {
-  yy_flex_debug = trace_lexer;
-  if (file.empty () || file == "-")
-    yyin = stdin;
-  else if (!(yyin = fopen (file.c_str (), "r")))
-    utils::error("cannot open " + file + ": " + strerror(errno));
+  yylex_init (&scanner);
+  yyset_debug (trace_lexer, scanner);
+  loc = yy::location ();
+  comment_depth = 0;
+  if (!yy_scan_buffer (source, source_size, scanner))
+    utils::error ("internal error: cannot scan " + file);
 }
 
 void ParserDriver::lex_end ()
 {
-  fclose (yyin);
+  yylex_destroy (scanner);
+  scanner = nullptr;
 }
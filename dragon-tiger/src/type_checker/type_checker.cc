@@ -0,0 +1,175 @@
+#include "type_checker.hh"
+#include "../ast/static_visitor.hh"
+#include "../ast/traversal.hh"
+
+namespace ast {
+namespace type_checker {
+
+namespace {
+
+const char *type_name(Type t) {
+  switch (t) {
+  case t_int:
+    return "int";
+  case t_string:
+    return "string";
+  case t_void:
+    return "void";
+  default:
+    return "undefined";
+  }
+}
+
+class TypeChecker : public StaticVisitor<TypeChecker> {
+  const Symbol s_int = Symbol("int"), s_string = Symbol("string");
+
+  void report(const SourceLoc &loc, const std::string &message) {
+    errors.push_back(TypeError{loc, message});
+  }
+
+  // Report e, described by what, unless it has the expected type.
+  void expect(const Expr &e, Type expected, const std::string &what) {
+    if (e.get_type() != expected)
+      report(e.loc, what + " must be " + type_name(expected) + ", not " +
+                        type_name(e.get_type()));
+  }
+
+  // The type of a declaration annotated with name, void if there is no
+  // annotation. Unknown names are reported when the declaration itself is
+  // checked.
+  Type declared(const optional<Symbol> &name) const {
+    if (!name)
+      return t_void;
+    return *name == s_string ? t_string : t_int;
+  }
+
+  Type annotation(const Decl &decl) {
+    if (decl.type_name && *decl.type_name != s_int &&
+        *decl.type_name != s_string)
+      report(decl.loc, "unknown type " + decl.type_name->get().to_string());
+    return declared(decl.type_name);
+  }
+
+public:
+  std::vector<TypeError> errors;
+
+  void visit(IntegerLiteral &literal) { literal.set_type(t_int); }
+
+  void visit(StringLiteral &literal) { literal.set_type(t_string); }
+
+  void visit(BinaryOperator &binop) {
+    const Expr &left = binop.get_left(), &right = binop.get_right();
+    const std::string op = "operand of " + operator_name[binop.op];
+    binop.set_type(t_int);
+    if (binop.op < o_eq) {
+      expect(left, t_int, "left " + op);
+      expect(right, t_int, "right " + op);
+    } else if (left.get_type() != right.get_type())
+      report(binop.loc, std::string("cannot compare ") +
+                            type_name(left.get_type()) + " and " +
+                            type_name(right.get_type()));
+    else if (left.get_type() == t_void)
+      report(binop.loc, "cannot compare values of type void");
+  }
+
+  void visit(Sequence &seq) {
+    const auto &exprs = seq.get_exprs();
+    seq.set_type(exprs.empty() ? t_void : exprs.back()->get_type());
+  }
+
+  void visit(Let &let) { let.set_type(let.get_sequence().get_type()); }
+
+  void visit(Identifier &id) { id.set_type(id.get_decl()->get_type()); }
+
+  void visit(IfThenElse &ite) {
+    const Expr &then_part = ite.get_then_part(),
+               &else_part = ite.get_else_part();
+    expect(ite.get_condition(), t_int, "condition of if");
+    if (then_part.get_type() != else_part.get_type())
+      report(ite.loc, std::string("branches of if have different types: ") +
+                          type_name(then_part.get_type()) + " and " +
+                          type_name(else_part.get_type()));
+    ite.set_type(then_part.get_type());
+  }
+
+  void visit(VarDecl &decl) {
+    // The lower bound of a loop variable is checked with its loop.
+    if (decl.read_only) {
+      decl.set_type(t_int);
+      return;
+    }
+    const Type type = annotation(decl);
+    auto expr = decl.get_expr();
+    if (!expr)
+      decl.set_type(type);
+    else if (decl.type_name) {
+      expect(*expr, type, "value of " + decl.name.get().to_string());
+      decl.set_type(type);
+    } else {
+      if (expr->get_type() == t_void)
+        report(decl.loc, "variable " + decl.name.get().to_string() +
+                             " is given no value");
+      decl.set_type(expr->get_type());
+    }
+  }
+
+  void visit(FunDecl &decl) {
+    const Expr &body = *decl.get_expr();
+    // main has the type of the program.
+    if (!decl.get_parent()) {
+      decl.set_type(body.get_type());
+      return;
+    }
+    const Type result = annotation(decl);
+    if (body.get_type() != result)
+      report(decl.loc, "function " + decl.name.get().to_string() +
+                           " must return " + type_name(result) +
+                           ", not " + type_name(body.get_type()));
+    decl.set_type(result);
+  }
+
+  void visit(FunCall &call) {
+    const FunDecl &decl = *call.get_decl();
+    const auto &params = decl.get_params();
+    const auto &args = call.get_args();
+    for (size_t i = 0; i < args.size(); i++)
+      expect(*args[i], declared(params[i]->type_name),
+             "argument " + std::to_string(i + 1) + " of " +
+                 call.func_name.get().to_string());
+    call.set_type(declared(decl.type_name));
+  }
+
+  void visit(WhileLoop &loop) {
+    expect(loop.get_condition(), t_int, "condition of while");
+    expect(loop.get_body(), t_void, "body of while");
+    loop.set_type(t_void);
+  }
+
+  void visit(ForLoop &loop) {
+    if (auto low = loop.get_variable().get_expr())
+      expect(*low, t_int, "lower bound of for");
+    expect(loop.get_high(), t_int, "upper bound of for");
+    expect(loop.get_body(), t_void, "body of for");
+    loop.set_type(t_void);
+  }
+
+  void visit(Break &b) { b.set_type(t_void); }
+
+  void visit(Assign &assign) {
+    const Identifier &lhs = assign.get_lhs();
+    expect(assign.get_rhs(), lhs.get_type(),
+           "value assigned to " + lhs.name.get().to_string());
+    assign.set_type(t_void);
+  }
+};
+
+} // namespace
+
+std::vector<TypeError> check_types(FunDecl &main) {
+  TypeChecker checker;
+  walk(main, [](Node &) {}, [&](Node &node) { checker.dispatch(node); });
+  return std::move(checker.errors);
+}
+
+} // namespace type_checker
+} // namespace ast
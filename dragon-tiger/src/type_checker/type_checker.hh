@@ -0,0 +1,35 @@
+#ifndef TYPE_CHECKER_HH
+#define TYPE_CHECKER_HH
+
+#include <string>
+#include <vector>
+
+#include "../ast/nodes.hh"
+
+namespace ast {
+namespace type_checker {
+
+struct TypeError {
+  SourceLoc loc;
+  std::string message;
+};
+
+// Check the types of a program bound by the binder, and set the type of
+// every node: that of its value for an expression, that of the variable
+// for a VarDecl, and the result type for a FunDecl (t_void for procedures;
+// main gets the type of the program).
+//
+// The tree is walked once, and every node is checked after its children.
+// The types of functions and of their parameters are read from their
+// declarations, so calls are checked without looking at the body of the
+// function called, even inside mutually recursive functions.
+//
+// Errors do not stop the check: they are returned in the order they were
+// found, and nodes in error get the type they would have had otherwise so
+// that one error is not reported many times.
+std::vector<TypeError> check_types(FunDecl &main);
+
+} // namespace type_checker
+} // namespace ast
+
+#endif // TYPE_CHECKER_HH
@@ -0,0 +1,79 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "arena.hh"
+
+namespace {
+
+thread_local utils::Arena *current_arena = nullptr;
+// Heap traffic may come from several threads at once.
+std::atomic<size_t> heap_allocations(0);
+std::atomic<size_t> heap_bytes(0);
+std::atomic<size_t> heap_releases(0);
+
+} // namespace
+
+namespace utils {
+
+Arena::~Arena() {
+  while (chunks) {
+    Chunk *next = chunks->next;
+    free(chunks);
+    chunks = next;
+  }
+}
+
+void *Arena::allocate_slow(size_t size, size_t align) {
+  // Oversized requests get a chunk of their own.
+  size_t needed = sizeof(Chunk) + size + align;
+  size_t size_to_reserve = needed > chunk_size ? needed : chunk_size;
+  Chunk *chunk = static_cast<Chunk *>(malloc(size_to_reserve));
+  if (!chunk)
+    throw std::bad_alloc();
+  chunk->next = chunks;
+  chunk->size = size_to_reserve;
+  chunks = chunk;
+  chunk_count++;
+  reserved += size_to_reserve;
+
+  uintptr_t p = (reinterpret_cast<uintptr_t>(chunk + 1) + align - 1) & ~(align - 1);
+  char *const chunk_end = reinterpret_cast<char *>(chunk) + size_to_reserve;
+  // Keep bumping into the most roomy chunk.
+  if (!cur || chunk_end - reinterpret_cast<char *>(p + size) > end - cur) {
+    cur = reinterpret_cast<char *>(p + size);
+    end = chunk_end;
+  }
+  return reinterpret_cast<void *>(p);
+}
+
+Arena *Arena::current() { return current_arena; }
+
+Arena::Scope::Scope(Arena *arena) : previous(current_arena) {
+  current_arena = arena;
+}
+
+Arena::Scope::~Scope() { current_arena = previous; }
+
+void *heap_allocate(size_t size) {
+  heap_allocations.fetch_add(1, std::memory_order_relaxed);
+  heap_bytes.fetch_add(size, std::memory_order_relaxed);
+  return ::operator new(size);
+}
+
+void heap_release(void *p) {
+  if (!p)
+    return;
+  heap_releases.fetch_add(1, std::memory_order_relaxed);
+  ::operator delete(p);
+}
+
+AllocationStats heap_stats() {
+  AllocationStats stats;
+  stats.allocations = heap_allocations.load(std::memory_order_relaxed);
+  stats.bytes = heap_bytes.load(std::memory_order_relaxed);
+  stats.releases = heap_releases.load(std::memory_order_relaxed);
+  return stats;
+}
+
+} // namespace utils
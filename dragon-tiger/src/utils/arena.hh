@@ -0,0 +1,117 @@
+#ifndef ARENA_HH
+#define ARENA_HH
+
+#include <cstddef>
+#include <cstdint>
+
+namespace utils {
+
+// Counters describing the traffic seen by an allocator.
+struct AllocationStats {
+  size_t allocations = 0; // Number of allocation requests
+  size_t bytes = 0;       // Number of bytes requested
+  size_t releases = 0;    // Number of blocks given back
+};
+
+// Arena is a bump allocator. Memory is carved out of large chunks obtained
+// from the system, so that an allocation costs a pointer increment. Nothing
+// is ever released individually: all the chunks are given back at once when
+// the arena is destroyed. Objects living in an arena must therefore not need
+// their destructor to run in order to release memory.
+//
+// An arena can be made current for the running thread using Arena::Scope.
+// AST nodes (see ast/nodes.hh) and ArenaAllocator use the current arena if
+// there is one, and the global heap otherwise.
+
+class Arena {
+  struct Chunk {
+    Chunk *next;
+    size_t size;
+  };
+
+  char *cur = nullptr;
+  char *end = nullptr;
+  Chunk *chunks = nullptr;
+  const size_t chunk_size;
+  AllocationStats counters;
+  size_t chunk_count = 0;
+  size_t reserved = 0;
+
+  void *allocate_slow(size_t size, size_t align);
+
+public:
+  explicit Arena(size_t _chunk_size = 64 * 1024) : chunk_size(_chunk_size) {}
+  ~Arena();
+
+  Arena &operator=(const Arena &) = delete;
+  Arena(const Arena &) = delete;
+
+  void *allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+    counters.allocations++;
+    counters.bytes += size;
+    uintptr_t p = (reinterpret_cast<uintptr_t>(cur) + align - 1) & ~(align - 1);
+    if (!cur || p + size > reinterpret_cast<uintptr_t>(end))
+      return allocate_slow(size, align);
+    cur = reinterpret_cast<char *>(p + size);
+    return reinterpret_cast<void *>(p);
+  }
+
+  const AllocationStats &stats() const { return counters; }
+  size_t chunks_count() const { return chunk_count; }
+  size_t reserved_bytes() const { return reserved; }
+
+  // The arena used by the running thread, or nullptr.
+  static Arena *current();
+
+  // Make an arena current for the lifetime of the scope object.
+  class Scope {
+    Arena *previous;
+
+  public:
+    explicit Scope(Arena *arena);
+    ~Scope();
+    Scope &operator=(const Scope &) = delete;
+    Scope(const Scope &) = delete;
+  };
+};
+
+// Heap allocation functions used when no arena is current. Their traffic
+// is accounted in heap_stats().
+void *heap_allocate(size_t size);
+void heap_release(void *p);
+AllocationStats heap_stats();
+
+// A standard allocator drawing from the arena which is current when it is
+// constructed, or from the heap if there is none.
+template <typename T> class ArenaAllocator {
+  template <typename U> friend class ArenaAllocator;
+  Arena *arena;
+
+public:
+  typedef T value_type;
+
+  ArenaAllocator() : arena(Arena::current()) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+  T *allocate(size_t n) {
+    if (arena)
+      return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+    return static_cast<T *>(heap_allocate(n * sizeof(T)));
+  }
+  void deallocate(T *p, size_t) {
+    if (!arena)
+      heap_release(p);
+  }
+
+  template <typename U> bool operator==(const ArenaAllocator<U> &other) const {
+    return arena == other.arena;
+  }
+  template <typename U> bool operator!=(const ArenaAllocator<U> &other) const {
+    return arena != other.arena;
+  }
+};
+
+} // namespace utils
+
+#endif // ARENA_HH
@@ -3,22 +3,46 @@
 
 #include "errors.hh"
 
+namespace {
+
+thread_local std::ostream *diagnostics = nullptr;
+
+[[noreturn]] void fail() {
+  if (diagnostics)
+    throw utils::FatalError();
+  exit(EXIT_FAILURE);
+}
+
+} // namespace
+
 namespace utils {
 
+DiagnosticScope::DiagnosticScope(std::ostream &o) : previous(diagnostics) {
+  diagnostics = &o;
+}
+
+DiagnosticScope::~DiagnosticScope() { diagnostics = previous; }
+
+std::ostream &diagnostics_stream() {
+  return diagnostics ? *diagnostics : std::cerr;
+}
+
 void non_fatal_error(const yy::location &l, const std::string &m) {
-  std::cerr << l << ": " << m << std::endl;
+  diagnostics_stream() << l << ": " << m << std::endl;
 }
 
-void non_fatal_error(const std::string &m) { std::cerr << m << std::endl; }
+void non_fatal_error(const std::string &m) {
+  diagnostics_stream() << m << std::endl;
+}
 
 void error(const yy::location &l, const std::string &m) {
   non_fatal_error(l, m);
-  exit(EXIT_FAILURE);
+  fail();
 }
 
 void error(const std::string &m) {
   non_fatal_error(m);
-  exit(EXIT_FAILURE);
+  fail();
 }
 
 } // namespace utils
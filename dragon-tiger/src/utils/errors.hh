@@ -1,10 +1,37 @@
 #ifndef ERRORS_HH
 #define ERRORS_HH
 
+#include <exception>
+#include <ostream>
+
 #include "../parser/tiger_parser.hh"
 
 namespace utils {
 
+// By default, diagnostics are written to std::cerr and a fatal error
+// terminates the program. While a DiagnosticScope is active, the diagnostics
+// of the running thread are written to the given stream instead, and a fatal
+// error throws FatalError so that the caller can carry on with other work.
+
+class FatalError : public std::exception {
+public:
+  const char *what() const noexcept { return "fatal error"; }
+};
+
+class DiagnosticScope {
+  std::ostream *previous;
+
+public:
+  explicit DiagnosticScope(std::ostream &o);
+  ~DiagnosticScope();
+  DiagnosticScope &operator=(const DiagnosticScope &) = delete;
+  DiagnosticScope(const DiagnosticScope &) = delete;
+};
+
+// The stream diagnostics of the running thread go to, for statistics and
+// other reports which are not errors.
+std::ostream &diagnostics_stream();
+
 [[noreturn]] void error(const yy::location &l, const std::string &m);
 [[noreturn]] void error(const std::string &m);
 
@@ -0,0 +1,50 @@
+#include <sstream>
+
+#include "output_buffer.hh"
+
+namespace utils {
+
+OutputBuffer::OutputBuffer(std::ostream &_ostream, size_t capacity)
+    : ostream(_ostream), buffer(capacity) {
+  cur = buffer.data();
+  end = cur + buffer.size();
+}
+
+void OutputBuffer::flush() {
+  ostream.write(buffer.data(), cur - buffer.data());
+  cur = buffer.data();
+}
+
+void OutputBuffer::write_slow(const char *s, size_t n) {
+  flush();
+  // Large blocks go straight to the stream.
+  if (n > buffer.size()) {
+    ostream.write(s, n);
+    return;
+  }
+  memcpy(cur, s, n);
+  cur += n;
+}
+
+OutputBuffer &OutputBuffer::operator<<(int64_t n) {
+  char digits[24];
+  char *p = digits + sizeof(digits);
+  uint64_t u = n < 0 ? -uint64_t(n) : uint64_t(n);
+  do {
+    *--p = '0' + u % 10;
+    u /= 10;
+  } while (u);
+  if (n < 0)
+    *--p = '-';
+  write(p, digits + sizeof(digits) - p);
+  return *this;
+}
+
+OutputBuffer &OutputBuffer::operator<<(const SourceLoc &loc) {
+  // Locations are rare enough in outputs to go through their operator<<.
+  std::ostringstream text;
+  text << loc;
+  return *this << text.str();
+}
+
+} // namespace utils
@@ -0,0 +1,76 @@
+#ifndef OUTPUT_BUFFER_HH
+#define OUTPUT_BUFFER_HH
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/utility/string_view.hpp>
+
+#include "source_map.hh"
+#include "symbols.hh"
+
+namespace utils {
+
+// OutputBuffer accumulates text in a buffer of its own and writes it to the
+// underlying stream only when the buffer is full or flush() is called, so
+// that large outputs cost a few large writes. The buffer is flushed when
+// the OutputBuffer is destroyed.
+
+class OutputBuffer {
+  std::ostream &ostream;
+  std::vector<char> buffer;
+  char *cur;
+  char *end;
+
+  void write_slow(const char *s, size_t n);
+
+public:
+  explicit OutputBuffer(std::ostream &_ostream, size_t capacity = 64 * 1024);
+  ~OutputBuffer() { flush(); }
+
+  OutputBuffer &operator=(const OutputBuffer &) = delete;
+  OutputBuffer(const OutputBuffer &) = delete;
+
+  void write(const char *s, size_t n) {
+    if (n > size_t(end - cur))
+      return write_slow(s, n);
+    memcpy(cur, s, n);
+    cur += n;
+  }
+
+  void flush();
+
+  OutputBuffer &operator<<(char c) {
+    if (cur == end)
+      flush();
+    *cur++ = c;
+    return *this;
+  }
+  OutputBuffer &operator<<(const char *s) {
+    write(s, strlen(s));
+    return *this;
+  }
+  OutputBuffer &operator<<(boost::string_view s) {
+    write(s.data(), s.size());
+    return *this;
+  }
+  OutputBuffer &operator<<(const std::string &s) {
+    write(s.data(), s.size());
+    return *this;
+  }
+  OutputBuffer &operator<<(const Symbol &s) {
+    if (!s.get_id())
+      return *this << "<null>";
+    return *this << s.get();
+  }
+  OutputBuffer &operator<<(int64_t n);
+  OutputBuffer &operator<<(int32_t n) { return *this << int64_t(n); }
+  OutputBuffer &operator<<(const SourceLoc &loc);
+};
+
+} // namespace utils
+
+#endif // OUTPUT_BUFFER_HH
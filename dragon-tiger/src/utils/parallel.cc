@@ -0,0 +1,52 @@
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "parallel.hh"
+
+namespace utils {
+
+void parallel_for_ordered(size_t count, unsigned jobs,
+                          const std::function<void(size_t)> &task,
+                          const std::function<void(size_t)> &done) {
+  if (jobs <= 1 || count <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      task(i);
+      done(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next(0);
+  std::mutex mutex;
+  std::condition_variable completed;
+  std::vector<bool> finished(count, false);
+
+  auto worker = [&]() {
+    for (size_t i; (i = next.fetch_add(1)) < count;) {
+      task(i);
+      std::lock_guard<std::mutex> lock(mutex);
+      finished[i] = true;
+      completed.notify_one();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned j = 0; j < jobs && j < count; j++)
+    pool.emplace_back(worker);
+
+  for (size_t i = 0; i < count; i++) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      completed.wait(lock, [&]() { return finished[i]; });
+    }
+    done(i);
+  }
+
+  for (auto &thread : pool)
+    thread.join();
+}
+
+} // namespace utils
@@ -0,0 +1,19 @@
+#ifndef PARALLEL_HH
+#define PARALLEL_HH
+
+#include <cstddef>
+#include <functional>
+
+namespace utils {
+
+// Run task(i) for every i in [0, count) on a pool of `jobs' threads. Tasks
+// are started in order. done(i) is called from the calling thread, in
+// order, as soon as task(i) has completed, so that results can be consumed
+// while later tasks are still running.
+void parallel_for_ordered(size_t count, unsigned jobs,
+                          const std::function<void(size_t)> &task,
+                          const std::function<void(size_t)> &done);
+
+} // namespace utils
+
+#endif // PARALLEL_HH
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+#include "errors.hh"
+#include "nolocation.hh"
+#include "source_map.hh"
+
+namespace {
+
+thread_local const utils::SourceMap *current_map = nullptr;
+
+std::mutex maps_mutex;
+// Registered source maps, by increasing base offset.
+std::vector<std::unique_ptr<utils::SourceMap>> maps;
+std::vector<uint32_t> bases;
+// Offset 0 is reserved for the absence of location.
+uint32_t next_base = 1;
+
+} // namespace
+
+namespace utils {
+
+SourceLoc::SourceLoc(const yy::location &loc) {
+  if (loc.begin.line == 0 || !current_map)
+    return;
+  begin = current_map->encode(loc.begin);
+  length = current_map->encode(loc.end) - begin;
+}
+
+SourceLoc::operator yy::location() const {
+  const SourceMap *map = begin ? SourceMap::find(begin) : nullptr;
+  if (!map)
+    return nl;
+  return yy::location(map->decode(begin), map->decode(begin + length));
+}
+
+SourceMap::SourceMap(const std::string &_name, uint32_t _base,
+                     const char *text, size_t _size)
+    : name(_name), base(_base), size(_size) {
+  // The scanner starts a new line after each carriage return or line feed
+  // character, even when they come in pairs.
+  line_starts.push_back(0);
+  for (size_t i = 0; i < size; i++)
+    if (text[i] == '\n' || text[i] == '\r')
+      line_starts.push_back(i + 1);
+}
+
+const SourceMap &SourceMap::add(const std::string &name, const char *text,
+                                size_t size) {
+  std::lock_guard<std::mutex> lock(maps_mutex);
+  // Keep one past the end addressable, for end of file locations.
+  if (size + 1 > UINT32_MAX - next_base)
+    utils::error("too much source text to track locations");
+  maps.emplace_back(new SourceMap(name, next_base, text, size));
+  bases.push_back(next_base);
+  next_base += size + 1;
+  return *maps.back();
+}
+
+const SourceMap &SourceMap::add(const std::string &name, size_t size,
+                                const std::vector<uint32_t> &line_starts,
+                                bool named) {
+  std::lock_guard<std::mutex> lock(maps_mutex);
+  if (size + 1 > UINT32_MAX - next_base)
+    utils::error("too much source text to track locations");
+  maps.emplace_back(new SourceMap(name, next_base, size, line_starts, named));
+  bases.push_back(next_base);
+  next_base += size + 1;
+  return *maps.back();
+}
+
+const SourceMap *SourceMap::find(uint32_t offset) {
+  std::lock_guard<std::mutex> lock(maps_mutex);
+  auto it = std::upper_bound(bases.begin(), bases.end(), offset);
+  if (it == bases.begin())
+    return nullptr;
+  return maps[it - bases.begin() - 1].get();
+}
+
+const SourceMap *SourceMap::current() { return current_map; }
+
+uint32_t SourceMap::encode(const yy::position &pos) const {
+  if (pos.filename)
+    named = true;
+  const size_t line =
+      std::min<size_t>(std::max(pos.line, 1), line_starts.size()) - 1;
+  return base + std::min<size_t>(line_starts[line] + std::max(pos.column, 1) - 1, size);
+}
+
+yy::position SourceMap::decode(uint32_t offset) const {
+  const uint32_t relative = offset - base;
+  const size_t line =
+      std::upper_bound(line_starts.begin(), line_starts.end(), relative) -
+      line_starts.begin();
+  return yy::position(named ? &name : nullptr, line,
+                      relative - line_starts[line - 1] + 1);
+}
+
+SourceMap::Scope::Scope(const SourceMap *map) : previous(current_map) {
+  current_map = map;
+}
+
+SourceMap::Scope::~Scope() { current_map = previous; }
+
+} // namespace utils
@@ -0,0 +1,96 @@
+#ifndef SOURCE_MAP_HH
+#define SOURCE_MAP_HH
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../parser/location.hh"
+
+namespace utils {
+
+// SourceLoc is the compact form of a yy::location kept in AST nodes. It
+// holds a byte offset and a length in a space shared by all the source
+// files of the process, where each file gets its own interval (offset 0
+// stands for the absence of location). Lines and columns are only
+// recomputed, through the file SourceMap, when the location is printed or
+// converted back to a yy::location.
+//
+// Converting a yy::location to a SourceLoc uses the SourceMap current for
+// the running thread (see SourceMap::Scope), that is the one of the file
+// being parsed.
+
+class SourceLoc {
+  uint32_t begin = 0;
+  uint32_t length = 0;
+
+public:
+  SourceLoc() {}
+  SourceLoc(uint32_t _begin, uint32_t _length)
+      : begin(_begin), length(_length) {}
+  SourceLoc(const yy::location &loc);
+  operator yy::location() const;
+  uint32_t get_begin() const { return begin; }
+  uint32_t get_length() const { return length; }
+  friend std::ostream &operator<<(std::ostream &o, const SourceLoc &loc) {
+    return o << yy::location(loc);
+  }
+};
+
+// The line structure of one source file. Source maps are registered once
+// and live as long as the process.
+class SourceMap {
+  std::string name;
+  // Whether the locations of this file carried its name.
+  mutable bool named = false;
+  uint32_t base;
+  uint32_t size;
+  // Offsets (relative to base) of the start of each line.
+  std::vector<uint32_t> line_starts;
+
+  SourceMap(const std::string &_name, uint32_t _base, const char *text,
+            size_t _size);
+  SourceMap(const std::string &_name, uint32_t _base, size_t _size,
+            const std::vector<uint32_t> &_line_starts, bool _named)
+      : name(_name), named(_named), base(_base), size(_size),
+        line_starts(_line_starts) {}
+
+public:
+  // Register the size bytes at text as a new source file.
+  static const SourceMap &add(const std::string &name, const char *text,
+                              size_t size);
+  // Register a source file of size bytes whose line structure is already
+  // known (see get_line_starts()), for instance from a saved AST.
+  static const SourceMap &add(const std::string &name, size_t size,
+                              const std::vector<uint32_t> &line_starts,
+                              bool named);
+  // The source map containing offset, if any.
+  static const SourceMap *find(uint32_t offset);
+  // The source map used by SourceLoc conversions in the running thread.
+  static const SourceMap *current();
+
+  const std::string &get_name() const { return name; }
+  bool is_named() const { return named; }
+  uint32_t get_base() const { return base; }
+  uint32_t get_size() const { return size; }
+  const std::vector<uint32_t> &get_line_starts() const { return line_starts; }
+
+  uint32_t encode(const yy::position &pos) const;
+  yy::position decode(uint32_t offset) const;
+
+  // Make a source map current for the lifetime of the scope object.
+  class Scope {
+    const SourceMap *previous;
+
+  public:
+    explicit Scope(const SourceMap *map);
+    ~Scope();
+    Scope &operator=(const Scope &) = delete;
+    Scope(const Scope &) = delete;
+  };
+};
+
+} // namespace utils
+
+#endif // SOURCE_MAP_HH
@@ -1,35 +1,180 @@
-#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
 
 #include "symbols.hh"
 
 namespace {
 
-struct Hash {
-  size_t operator()(std::string const *s) const noexcept {
-    return std::hash<std::string>()(*s);
-  }
+// What an identifier designates.
+struct Entry {
+  const char *data;
+  uint32_t length;
 };
 
-struct Cmp {
-  bool operator()(std::string const *a, std::string const *b) const noexcept {
-    return *a == *b;
+// Entries are stored in segments which are never moved once allocated, so
+// that they can be read without holding any lock. Segment k holds 2^(k+10)
+// entries, starting with identifier 2^(k+10) - 2^10.
+const unsigned first_segment_bits = 10;
+const unsigned max_segments = 32 - first_segment_bits + 1;
+
+std::atomic<Entry *> segments[max_segments];
+std::mutex segments_mutex;
+// Identifier 0 is the null symbol.
+std::atomic<uint32_t> next_id(1);
+std::atomic<size_t> allocated_entries(0);
+
+Entry &entry(uint32_t id) {
+  const uint64_t n = uint64_t(id) + (1u << first_segment_bits);
+  const unsigned bits = 63 - __builtin_clzll(n);
+  return segments[bits - first_segment_bits].load(std::memory_order_acquire)
+      [n - (uint64_t(1) << bits)];
+}
+
+uint32_t new_entry(const char *data, uint32_t length) {
+  const uint32_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+  if (id == 0)
+    throw std::bad_alloc();
+  const uint64_t n = uint64_t(id) + (1u << first_segment_bits);
+  const unsigned bits = 63 - __builtin_clzll(n);
+  std::atomic<Entry *> &segment = segments[bits - first_segment_bits];
+  if (!segment.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> lock(segments_mutex);
+    if (!segment.load(std::memory_order_relaxed)) {
+      segment.store(new Entry[size_t(1) << bits], std::memory_order_release);
+      allocated_entries += size_t(1) << bits;
+    }
+  }
+  entry(id) = Entry{data, length};
+  return id;
+}
+
+const size_t max_chunk = 64 * 1024;
+
+// FNV-1a, followed by a final mix so that high bits are usable too.
+uint64_t hash_string(boost::string_view s) {
+  uint64_t h = 14695981039346656037ull;
+  for (unsigned char c : s)
+    h = (h ^ c) * 1099511628211ull;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  return h;
+}
+
+// One shard of the symbol table: an open-addressing hash set of symbol
+// identifiers with linear probing, and the characters of those symbols.
+// Slots compare the low bits of the stored hash before the string itself.
+class Shard {
+  struct Slot {
+    uint32_t id;
+    uint32_t hash;
+  };
+
+  std::mutex mutex;
+  std::vector<Slot> slots = std::vector<Slot>(16);
+  size_t count = 0;
+
+  // Characters are appended to the current chunk, and chunks double in
+  // size up to max_chunk.
+  char *chunk = nullptr;
+  size_t chunk_used = 0;
+  size_t chunk_size = 0;
+
+  void grow() {
+    std::vector<Slot> old(slots.size() * 2);
+    old.swap(slots);
+    const size_t mask = slots.size() - 1;
+    for (auto &slot : old)
+      if (slot.id) {
+        size_t i = slot.hash & mask;
+        while (slots[i].id)
+          i = (i + 1) & mask;
+        slots[i] = slot;
+      }
+  }
+
+  const char *store(boost::string_view s) {
+    if (chunk_used + s.size() > chunk_size) {
+      const size_t wanted = chunk_size ? std::min(chunk_size * 2, max_chunk) : 1024;
+      const size_t size = std::max(wanted, s.size());
+      chunk = new char[size];
+      chunk_used = 0;
+      chunk_size = size;
+      reserved += size;
+    }
+    char *p = chunk + chunk_used;
+    memcpy(p, s.data(), s.size());
+    chunk_used += s.size();
+    string_bytes += s.size();
+    return p;
+  }
+
+public:
+  size_t reserved = 0;
+  size_t string_bytes = 0;
+
+  uint32_t intern(boost::string_view s, uint32_t hash) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const size_t mask = slots.size() - 1;
+    size_t i = hash & mask;
+    for (; slots[i].id; i = (i + 1) & mask)
+      if (slots[i].hash == hash) {
+        const Entry &e = entry(slots[i].id);
+        if (e.length == s.size() && !memcmp(e.data, s.data(), s.size()))
+          return slots[i].id;
+      }
+    const uint32_t id = new_entry(store(s), s.size());
+    slots[i] = Slot{id, hash};
+    if (++count * 2 > slots.size())
+      grow();
+    return id;
+  }
+
+  void add_stats(utils::SymbolStats &stats) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.symbols += count;
+    stats.string_bytes += string_bytes;
+    stats.total_bytes += reserved + slots.size() * sizeof(Slot);
   }
 };
 
-std::unordered_set<const std::string *, Hash, Cmp> *symbols;
+// The shard is selected from the high bits of the hash, while slots
+// within a shard use the low bits.
+const unsigned shard_bits = 6;
+
+// Built on first use, so that symbols can be created during static
+// initialization.
+Shard *all_shards() {
+  static Shard shards[1 << shard_bits];
+  return shards;
+}
 
 } // namespace
 
 namespace utils {
 
-Symbol::Symbol(std::string const &s) {
-  if (symbols == nullptr)
-    symbols = new std::unordered_set<const std::string *, Hash, Cmp>();
-  auto f = symbols->find(&s);
-  if (f == symbols->end())
-    str = *symbols->insert(new std::string(s)).first;
-  else
-    str = *f;
+void Symbol::intern(boost::string_view s) {
+  const uint64_t hash = hash_string(s);
+  id = all_shards()[hash >> (64 - shard_bits)].intern(s, hash);
+}
+
+boost::string_view Symbol::get() const {
+  if (!id)
+    return boost::string_view();
+  const Entry &e = entry(id);
+  return boost::string_view(e.data, e.length);
+}
+
+SymbolStats symbol_stats() {
+  SymbolStats stats;
+  for (size_t i = 0; i < (1 << shard_bits); i++)
+    all_shards()[i].add_stats(stats);
+  stats.total_bytes += allocated_entries * sizeof(Entry);
+  return stats;
 }
 
 } // namespace utils
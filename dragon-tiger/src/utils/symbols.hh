@@ -1,36 +1,67 @@
 #ifndef SYMBOLS_HH
 #define SYMBOLS_HH
 
+#include <cstdint>
 #include <ostream>
 #include <string>
 
+#include <boost/utility/string_view.hpp>
+
 namespace utils {
 
-// Symbol is a small implementation of the flyweight pattern. Strings are
-// stored through a pointer. Similar strings will use the same instance in
-// memory, and comparaison is fast since it boils down to comparing two
-// pointers.
+// Symbol is a small implementation of the flyweight pattern. Each distinct
+// string is interned once and gets a 32-bit identifier, so comparaison is
+// fast since it boils down to comparing two integers. The characters of
+// all the symbols are stored back to back in append-only memory and are
+// never released.
 //
-// This implementation is not thread-safe, but the dragon-tiger compiler
-// is single-threaded.
+// Interning is thread-safe: the table is split into shards, each with its
+// own lock, so that several parsers can share the same symbols.
 
 class Symbol {
-  const std::string *str;
+  // 0 is the null symbol.
+  uint32_t id;
+
+  void intern(boost::string_view s);
 
 public:
-  Symbol() : str(nullptr) {}
-  Symbol(std::string const &);
-  Symbol(Symbol const &s) : str(s.str) {}
-  size_t hash() const noexcept { return std::hash<std::string>()(*str); }
-  std::string const &get() const { return *str; }
-  operator std::string() const { return *str; }
-  bool operator==(Symbol const &other) const { return str == other.str; }
-  bool operator!=(Symbol const &other) const { return str != other.str; }
+  Symbol() : id(0) {}
+  Symbol(std::string const &s) { intern(s); }
+  Symbol(boost::string_view s) { intern(s); }
+  Symbol(const char *s) { intern(s); }
+  // Trivially copyable, so that structures holding symbols can be copied
+  // as raw memory.
+  Symbol(Symbol const &s) = default;
+  Symbol &operator=(Symbol const &s) = default;
+  // Identifiers are dense and unique, which makes them perfect hashes.
+  size_t hash() const noexcept { return id; }
+  uint32_t get_id() const { return id; }
+  // The symbol identified by id, which must come from get_id().
+  static Symbol from_id(uint32_t id) {
+    Symbol s;
+    s.id = id;
+    return s;
+  }
+  boost::string_view get() const;
+  operator std::string() const { return get().to_string(); }
+  bool operator==(Symbol const &other) const { return id == other.id; }
+  bool operator!=(Symbol const &other) const { return id != other.id; }
   friend std::ostream &operator<<(std::ostream &o, Symbol const &s) {
-    return o << (s.str ? *s.str : "<null>");
+    if (!s.id)
+      return o << "<null>";
+    return o << s.get();
   }
 };
 
+// Memory used by the symbol table.
+struct SymbolStats {
+  size_t symbols = 0;      // Number of interned strings
+  size_t string_bytes = 0; // Characters of those strings
+  size_t total_bytes = 0;  // Memory reserved for strings and tables
+};
+
+SymbolStats symbol_stats();
+
 } // namespace utils
 
 namespace std {